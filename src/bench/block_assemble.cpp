@@ -6,6 +6,8 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <node/miner.h>
+#include <random.h>
 #include <test/util/mining.h>
 #include <test/util/script.h>
 #include <test/util/setup_common.h>
@@ -16,6 +18,8 @@
 
 #include <vector>
 
+using node::BlockAssembler;
+
 static void AssembleBlock(benchmark::Bench& bench)
 {
     const auto test_setup = MakeNoLogFileContext<const TestingSetup>();
@@ -49,4 +53,50 @@ static void AssembleBlock(benchmark::Bench& bench)
     });
 }
 
+static void AssembleBlockLargeMempool(benchmark::Bench& bench)
+{
+    const auto test_setup = MakeNoLogFileContext<TestingSetup>();
+    FastRandomContext det_rand{true};
+    const size_t num_txs = bench.complexityN() > 1 ? static_cast<size_t>(bench.complexityN()) : 20000;
+
+    // Fill the mempool with transactions paying random fees, each spending
+    // outputs of earlier ones or of made up ones, so that the packages
+    // overlap and more than a block is available.
+    CTxMemPool& pool = *test_setup->m_node.mempool;
+    {
+        LOCK2(cs_main, pool.cs);
+        TestMemPoolEntryHelper entry;
+        std::vector<COutPoint> outpoints;
+        for (size_t i{0}; i < num_txs; ++i) {
+            CMutableTransaction tx;
+            const size_t num_inputs = 1 + det_rand.randrange(3);
+            for (size_t j{0}; j < num_inputs; ++j) {
+                if (outpoints.empty() || det_rand.randrange(4) == 0) {
+                    tx.vin.emplace_back(COutPoint{det_rand.rand256(), 0});
+                } else {
+                    const size_t k = det_rand.randrange(outpoints.size());
+                    tx.vin.emplace_back(outpoints[k]);
+                    outpoints[k] = outpoints.back();
+                    outpoints.pop_back();
+                }
+            }
+            tx.vout.resize(2);
+            for (auto& out : tx.vout) {
+                out.scriptPubKey = P2WSH_OP_TRUE;
+                out.nValue = COIN;
+            }
+            const CTransactionRef ref = MakeTransactionRef(tx);
+            pool.addUnchecked(entry.Fee(1000 + det_rand.randrange(100000)).FromTx(ref));
+            outpoints.emplace_back(ref->GetHash(), 0);
+            outpoints.emplace_back(ref->GetHash(), 1);
+        }
+    }
+
+    bench.run([&] {
+        BlockAssembler{test_setup->m_node.chainman->ActiveChainstate(), pool, Params()}
+            .CreateNewBlock(P2WSH_OP_TRUE, nullptr, nullptr, &test_setup->m_node);
+    });
+}
+
 BENCHMARK(AssembleBlock);
+BENCHMARK(AssembleBlockLargeMempool);
@@ -0,0 +1,88 @@
+// Copyright (c) 2023 The Peercoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+
+#include <vector>
+
+// Same workload for every storage engine: a txindex-like table of random
+// 32-byte keys, then random point lookups and a full scan.
+static constexpr uint32_t NUM_ENTRIES{200000};
+
+static std::unique_ptr<CDBWrapper> FillDB(const fs::path& path, DBEngine engine, std::vector<uint256>& keys)
+{
+    auto db = std::make_unique<CDBWrapper>(path, 8 << 20, false, true, false, engine);
+    FastRandomContext rng{/*fDeterministic=*/true};
+    keys.clear();
+    CDBBatch batch(*db);
+    for (uint32_t i = 0; i < NUM_ENTRIES; ++i) {
+        keys.push_back(rng.rand256());
+        batch.Write(keys.back(), i);
+        if (batch.SizeEstimate() > (1 << 20)) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db->WriteBatch(batch);
+    db->CompactRange(uint256::ZERO, uint256{std::vector<unsigned char>(32, 0xff)});
+    return db;
+}
+
+static void DBRead(benchmark::Bench& bench, DBEngine engine)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    std::vector<uint256> keys;
+    const auto db = FillDB(testing_setup->m_path_root / "bench_db", engine, keys);
+    FastRandomContext rng{/*fDeterministic=*/true};
+    uint32_t value;
+    bench.run([&] {
+        const bool found = db->Read(keys[rng.randrange(keys.size())], value);
+        assert(found);
+    });
+}
+
+static void DBScan(benchmark::Bench& bench, DBEngine engine)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    std::vector<uint256> keys;
+    const auto db = FillDB(testing_setup->m_path_root / "bench_db", engine, keys);
+    bench.batch(NUM_ENTRIES).unit("entry").run([&] {
+        std::unique_ptr<CDBIterator> it{db->NewIterator()};
+        uint32_t value, sum{0};
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            if (it->GetValue(value)) sum += value;
+        }
+        ankerl::nanobench::doNotOptimizeAway(sum);
+    });
+}
+
+static void DBWrite(benchmark::Bench& bench, DBEngine engine)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    CDBWrapper db{testing_setup->m_path_root / "bench_db", 8 << 20, false, true, false, engine};
+    FastRandomContext rng{/*fDeterministic=*/true};
+    bench.run([&] {
+        CDBBatch batch(db);
+        for (int i = 0; i < 100; ++i) batch.Write(rng.rand256(), uint32_t(i));
+        db.WriteBatch(batch);
+    });
+}
+
+static void DBReadLevelDB(benchmark::Bench& bench) { DBRead(bench, DBEngine::LEVELDB); }
+static void DBReadMmap(benchmark::Bench& bench) { DBRead(bench, DBEngine::MMAP); }
+static void DBScanLevelDB(benchmark::Bench& bench) { DBScan(bench, DBEngine::LEVELDB); }
+static void DBScanMmap(benchmark::Bench& bench) { DBScan(bench, DBEngine::MMAP); }
+static void DBWriteLevelDB(benchmark::Bench& bench) { DBWrite(bench, DBEngine::LEVELDB); }
+static void DBWriteMmap(benchmark::Bench& bench) { DBWrite(bench, DBEngine::MMAP); }
+
+BENCHMARK(DBReadLevelDB);
+BENCHMARK(DBReadMmap);
+BENCHMARK(DBScanLevelDB);
+BENCHMARK(DBScanMmap);
+BENCHMARK(DBWriteLevelDB);
+BENCHMARK(DBWriteMmap);
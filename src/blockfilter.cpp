@@ -2,6 +2,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
+#include <array>
 #include <mutex>
 #include <sstream>
 #include <set>
@@ -32,14 +34,52 @@ uint64_t GCSFilter::HashToRange(const Element& element) const
     return FastRange64(hash, m_F);
 }
 
+/// Below this many values, std::sort beats the fixed cost of the radix passes.
+static constexpr size_t RADIX_SORT_THRESHOLD = 256;
+
+/** Sort values with an LSD radix sort on 8-bit digits. Passes over digits
+ *  that are the same for all values are skipped, so values mapped to a range
+ *  of N * M only take as many passes as that range has bytes. */
+static void RadixSort(std::vector<uint64_t>& values)
+{
+    if (values.size() < RADIX_SORT_THRESHOLD) {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+
+    std::array<std::array<size_t, 256>, 8> counts{};
+    for (uint64_t value : values) {
+        for (int digit = 0; digit < 8; ++digit) {
+            ++counts[digit][(value >> (8 * digit)) & 0xFF];
+        }
+    }
+
+    std::vector<uint64_t> buffer(values.size());
+    for (int digit = 0; digit < 8; ++digit) {
+        auto& count = counts[digit];
+        if (count[(values[0] >> (8 * digit)) & 0xFF] == values.size()) continue;
+        size_t offset = 0;
+        for (size_t& c : count) {
+            const size_t n = c;
+            c = offset;
+            offset += n;
+        }
+        for (uint64_t value : values) {
+            buffer[count[(value >> (8 * digit)) & 0xFF]++] = value;
+        }
+        values.swap(buffer);
+    }
+}
+
 std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
 {
-    std::vector<uint64_t> hashed_elements;
-    hashed_elements.reserve(elements.size());
-    for (const Element& element : elements) {
-        hashed_elements.push_back(HashToRange(element));
+    std::vector<Span<const unsigned char>> inputs(elements.begin(), elements.end());
+    std::vector<uint64_t> hashed_elements(inputs.size());
+    SipHashMany(m_params.m_siphash_k0, m_params.m_siphash_k1, inputs, hashed_elements.data());
+    for (uint64_t& hash : hashed_elements) {
+        hash = FastRange64(hash, m_F);
     }
-    std::sort(hashed_elements.begin(), hashed_elements.end());
+    RadixSort(hashed_elements);
     return hashed_elements;
 }
 
@@ -61,11 +101,11 @@ GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_fi
 
     // Verify that the encoded filter contains exactly N elements. If it has too much or too little
     // data, a std::ios_base::failure exception will be raised.
-    BitStreamReader<SpanReader> bitreader{stream};
+    GolombRiceReader reader{Span{m_encoded}.last(stream.size())};
     for (uint64_t i = 0; i < m_N; ++i) {
-        GolombRiceDecode(bitreader, m_params.m_P);
+        reader.Decode(m_params.m_P);
     }
-    if (!stream.empty()) {
+    if (reader.BytesConsumed() != stream.size()) {
         throw std::ios_base::failure("encoded_filter contains excess data");
     }
 }
@@ -88,44 +128,51 @@ GCSFilter::GCSFilter(const Params& params, const ElementSet& elements)
         return;
     }
 
-    BitStreamWriter<CVectorWriter> bitwriter(stream);
+    GolombRiceWriter writer(m_encoded);
 
     uint64_t last_value = 0;
     for (uint64_t value : BuildHashedSet(elements)) {
         uint64_t delta = value - last_value;
-        GolombRiceEncode(bitwriter, m_params.m_P, delta);
+        writer.Encode(m_params.m_P, delta);
         last_value = value;
     }
 
-    bitwriter.Flush();
+    writer.Flush();
 }
 
 bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
 {
+    if (size == 0 || m_N == 0) return false;
+
     SpanReader stream{GCS_SER_TYPE, GCS_SER_VERSION, m_encoded};
 
     // Seek forward by size of N
     uint64_t N = ReadCompactSize(stream);
     assert(N == m_N);
 
-    BitStreamReader<SpanReader> bitreader{stream};
+    GolombRiceReader reader{Span{m_encoded}.last(stream.size())};
 
     uint64_t value = 0;
     size_t hashes_index = 0;
     for (uint32_t i = 0; i < m_N; ++i) {
-        uint64_t delta = GolombRiceDecode(bitreader, m_params.m_P);
+        uint64_t delta = reader.Decode(m_params.m_P);
         value += delta;
 
-        while (true) {
+        // Skip the queries below value. Gallop ahead, so that the large
+        // query sets of light clients are passed over in logarithmic steps.
+        if (element_hashes[hashes_index] < value) {
+            size_t step = 1;
+            while (hashes_index + step < size && element_hashes[hashes_index + step] < value) {
+                step <<= 1;
+            }
+            const uint64_t* end = element_hashes + std::min(hashes_index + step, size);
+            hashes_index = std::lower_bound(element_hashes + hashes_index + step / 2, end, value) - element_hashes;
             if (hashes_index == size) {
                 return false;
-            } else if (element_hashes[hashes_index] == value) {
-                return true;
-            } else if (element_hashes[hashes_index] > value) {
-                break;
             }
-
-            hashes_index++;
+        }
+        if (element_hashes[hashes_index] == value) {
+            return true;
         }
     }
 
@@ -140,6 +187,7 @@ bool GCSFilter::Match(const Element& element) const
 
 bool GCSFilter::MatchAny(const ElementSet& elements) const
 {
+    if (elements.empty() || m_N == 0) return false;
     const std::vector<uint64_t> queries = BuildHashedSet(elements);
     return MatchInternal(queries.data(), queries.size());
 }
@@ -4,6 +4,10 @@
 
 #include <crypto/siphash.h>
 
+#include <crypto/common.h>
+
+#include <algorithm>
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
@@ -171,3 +175,80 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace {
+/** Number of inputs hashed side by side by SipHashMany. */
+constexpr size_t SIPHASH_LANES{4};
+
+/** Compress the remaining data of an input of total_size bytes and finalize. */
+uint64_t SipHashFinish(uint64_t v0, uint64_t v1, uint64_t v2, uint64_t v3, Span<const unsigned char> rest, size_t total_size)
+{
+    while (rest.size() >= 8) {
+        const uint64_t m = ReadLE64(rest.data());
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+        rest = rest.subspan(8);
+    }
+
+    uint64_t t = ((uint64_t)total_size) << 56;
+    for (size_t i = 0; i < rest.size(); ++i) {
+        t |= ((uint64_t)rest[i]) << (8 * i);
+    }
+    v3 ^= t;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= t;
+    v2 ^= 0xFF;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+} // namespace
+
+void SipHashMany(uint64_t k0, uint64_t k1, Span<const Span<const unsigned char>> inputs, uint64_t* out)
+{
+    const uint64_t init0 = 0x736f6d6570736575ULL ^ k0;
+    const uint64_t init1 = 0x646f72616e646f6dULL ^ k1;
+    const uint64_t init2 = 0x6c7967656e657261ULL ^ k0;
+    const uint64_t init3 = 0x7465646279746573ULL ^ k1;
+
+    size_t i = 0;
+    for (; i + SIPHASH_LANES <= inputs.size(); i += SIPHASH_LANES) {
+        uint64_t s0[SIPHASH_LANES], s1[SIPHASH_LANES], s2[SIPHASH_LANES], s3[SIPHASH_LANES];
+        size_t blocks = inputs[i].size() / 8;
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            s0[l] = init0;
+            s1[l] = init1;
+            s2[l] = init2;
+            s3[l] = init3;
+            blocks = std::min(blocks, inputs[i + l].size() / 8);
+        }
+
+        // Compress the blocks that all lanes have side by side. The lanes
+        // don't depend on each other, so their rounds overlap.
+        for (size_t b = 0; b < blocks; ++b) {
+            for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+                const uint64_t m = ReadLE64(inputs[i + l].data() + 8 * b);
+                uint64_t v0 = s0[l], v1 = s1[l], v2 = s2[l], v3 = s3[l] ^ m;
+                SIPROUND;
+                SIPROUND;
+                s0[l] = v0 ^ m;
+                s1[l] = v1;
+                s2[l] = v2;
+                s3[l] = v3;
+            }
+        }
+
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            const Span<const unsigned char> input{inputs[i + l]};
+            out[i + l] = SipHashFinish(s0[l], s1[l], s2[l], s3[l], input.subspan(8 * blocks), input.size());
+        }
+    }
+    for (; i < inputs.size(); ++i) {
+        out[i] = SipHashFinish(init0, init1, init2, init3, inputs[i], inputs[i].size());
+    }
+}
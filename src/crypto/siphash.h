@@ -5,6 +5,7 @@
 #ifndef BITCOIN_CRYPTO_SIPHASH_H
 #define BITCOIN_CRYPTO_SIPHASH_H
 
+#include <span.h>
 #include <stdint.h>
 
 #include <uint256.h>
@@ -44,4 +45,12 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** SipHash-2-4 of many byte strings under the same key.
+ *
+ *  out[i] is identical to CSipHasher(k0, k1).Write(inputs[i]).Finalize(). The
+ *  inputs are hashed four at a time with their rounds interleaved, which keeps
+ *  the CPU busy while each round waits on the previous one.
+ */
+void SipHashMany(uint64_t k0, uint64_t k1, Span<const Span<const unsigned char>> inputs, uint64_t* out);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
@@ -5,14 +5,23 @@
 #include <dbwrapper.h>
 
 #include <memory>
+#include <mmapdb.h>
 #include <random.h>
+#include <sync.h>
+#include <util/thread.h>
 
 #include <leveldb/cache.h>
+#include <leveldb/db.h>
 #include <leveldb/env.h>
 #include <leveldb/filter_policy.h>
+#include <leveldb/write_batch.h>
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <deque>
+#include <exception>
+#include <set>
+#include <thread>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +106,13 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(const DBOptions& db_options)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_cache = leveldb::NewLRUCache(db_options.block_cache_size);
+    options.write_buffer_size = db_options.write_buffer_size;
+    options.filter_policy = db_options.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(db_options.bloom_bits) : nullptr;
+    options.compression = db_options.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -114,39 +123,371 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name{fs::PathToString(path.stem())}
-{
-    penv = nullptr;
-    readoptions.verify_checksums = true;
-    iteroptions.verify_checksums = true;
-    iteroptions.fill_cache = false;
-    syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
-    options.create_if_missing = true;
-    if (fMemory) {
-        penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        options.env = penv;
-    } else {
-        if (fWipe) {
-            LogPrintf("Wiping LevelDB in %s\n", fs::PathToString(path));
-            leveldb::Status result = leveldb::DestroyDB(fs::PathToString(path), options);
-            dbwrapper_private::HandleError(result);
+/** Handle database error by throwing dbwrapper_error exception.
+ */
+static void HandleError(const leveldb::Status& status)
+{
+    if (status.ok())
+        return;
+    const std::string errmsg = "Fatal LevelDB error: " + status.ToString();
+    LogPrintf("%s\n", errmsg);
+    LogPrintf("You can use -debug=leveldb to get more complete diagnostic messages\n");
+    throw dbwrapper_error(errmsg);
+}
+
+static leveldb::Slice ToSlice(Span<const std::byte> s)
+{
+    return {reinterpret_cast<const char*>(s.data()), s.size()};
+}
+
+static Span<const std::byte> FromSlice(const leveldb::Slice& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+namespace {
+
+class LevelDBBatch final : public DBBackend::Batch
+{
+public:
+    leveldb::WriteBatch batch;
+
+    void Put(Span<const std::byte> key, Span<const std::byte> value) override { batch.Put(ToSlice(key), ToSlice(value)); }
+    void Delete(Span<const std::byte> key) override { batch.Delete(ToSlice(key)); }
+    void Clear() override { batch.Clear(); }
+};
+
+class LevelDBSnapshot final : public DBBackend::Snapshot
+{
+public:
+    leveldb::DB* const pdb;
+    const leveldb::Snapshot* const snapshot;
+
+    LevelDBSnapshot(leveldb::DB* db) : pdb(db), snapshot(db->GetSnapshot()) {}
+    ~LevelDBSnapshot() { pdb->ReleaseSnapshot(snapshot); }
+};
+
+class LevelDBIterator final : public DBBackend::Iterator
+{
+    std::unique_ptr<leveldb::Iterator> piter;
+
+public:
+    explicit LevelDBIterator(leveldb::Iterator* it) : piter(it) {}
+
+    bool Valid() const override { return piter->Valid(); }
+    void SeekToFirst() override { piter->SeekToFirst(); }
+    void Seek(Span<const std::byte> key) override { piter->Seek(ToSlice(key)); }
+    void Next() override { piter->Next(); }
+    Span<const std::byte> Key() const override { return FromSlice(piter->key()); }
+    Span<const std::byte> Value() const override { return FromSlice(piter->value()); }
+};
+
+class LevelDBBackend final : public DBBackend
+{
+    //! custom environment this database is using (may be nullptr in case of default environment)
+    leveldb::Env* penv{nullptr};
+
+    //! database options used
+    leveldb::Options options;
+
+    //! options used when reading from the database
+    leveldb::ReadOptions readoptions;
+
+    //! options used when iterating over values of the database
+    leveldb::ReadOptions iteroptions;
+
+    //! options used when writing to the database
+    leveldb::WriteOptions writeoptions;
+
+    //! options used when sync writing to the database
+    leveldb::WriteOptions syncoptions;
+
+    //! the database itself
+    leveldb::DB* pdb{nullptr};
+
+public:
+    LevelDBBackend(const fs::path& path, const DBOptions& db_options, bool fMemory, bool fWipe)
+    {
+        readoptions.verify_checksums = true;
+        iteroptions.verify_checksums = true;
+        iteroptions.fill_cache = false;
+        syncoptions.sync = true;
+        options = GetOptions(db_options);
+        options.create_if_missing = true;
+        if (fMemory) {
+            penv = leveldb::NewMemEnv(leveldb::Env::Default());
+            options.env = penv;
+        } else {
+            if (fWipe) {
+                LogPrintf("Wiping LevelDB in %s\n", fs::PathToString(path));
+                leveldb::Status result = leveldb::DestroyDB(fs::PathToString(path), options);
+                HandleError(result);
+            }
+            TryCreateDirectories(path);
+            LogPrintf("Opening LevelDB in %s\n", fs::PathToString(path));
+        }
+        // PathToString() return value is safe to pass to leveldb open function,
+        // because on POSIX leveldb passes the byte string directly to ::open(), and
+        // on Windows it converts from UTF-8 to UTF-16 before calling ::CreateFileW
+        // (see env_posix.cc and env_windows.cc).
+        leveldb::Status status = leveldb::DB::Open(options, fs::PathToString(path), &pdb);
+        HandleError(status);
+        LogPrintf("Opened LevelDB successfully\n");
+    }
+
+    ~LevelDBBackend()
+    {
+        delete pdb;
+        pdb = nullptr;
+        delete options.filter_policy;
+        options.filter_policy = nullptr;
+        delete options.info_log;
+        options.info_log = nullptr;
+        delete options.block_cache;
+        options.block_cache = nullptr;
+        delete penv;
+        options.env = nullptr;
+    }
+
+    bool Read(Span<const std::byte> key, std::string& value, const Snapshot* snapshot) const override
+    {
+        leveldb::ReadOptions opts = readoptions;
+        if (snapshot) opts.snapshot = static_cast<const LevelDBSnapshot*>(snapshot)->snapshot;
+        leveldb::Status status = pdb->Get(opts, ToSlice(key), &value);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            HandleError(status);
+        }
+        return true;
+    }
+
+    std::unique_ptr<Batch> NewBatch() const override
+    {
+        return std::make_unique<LevelDBBatch>();
+    }
+
+    void Write(Batch& batch, bool sync) override
+    {
+        leveldb::Status status = pdb->Write(sync ? syncoptions : writeoptions, &static_cast<LevelDBBatch&>(batch).batch);
+        HandleError(status);
+    }
+
+    std::unique_ptr<Iterator> NewIterator(const Snapshot* snapshot) const override
+    {
+        leveldb::ReadOptions opts = iteroptions;
+        if (snapshot) opts.snapshot = static_cast<const LevelDBSnapshot*>(snapshot)->snapshot;
+        return std::make_unique<LevelDBIterator>(pdb->NewIterator(opts));
+    }
+
+    std::unique_ptr<Snapshot> NewSnapshot() const override
+    {
+        return std::make_unique<LevelDBSnapshot>(pdb);
+    }
+
+    size_t EstimateSize(Span<const std::byte> begin, Span<const std::byte> end) const override
+    {
+        uint64_t size = 0;
+        leveldb::Range range(ToSlice(begin), ToSlice(end));
+        pdb->GetApproximateSizes(&range, 1, &size);
+        return size;
+    }
+
+    void CompactRange(const Span<const std::byte>* begin, const Span<const std::byte>* end) override
+    {
+        const leveldb::Slice slBegin{begin ? ToSlice(*begin) : leveldb::Slice{}};
+        const leveldb::Slice slEnd{end ? ToSlice(*end) : leveldb::Slice{}};
+        pdb->CompactRange(begin ? &slBegin : nullptr, end ? &slEnd : nullptr);
+    }
+
+    size_t DynamicMemoryUsage() const override
+    {
+        std::string memory;
+        std::optional<size_t> parsed;
+        if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory) || !(parsed = ToIntegral<size_t>(memory))) {
+            LogPrint(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
+            return 0;
         }
-        TryCreateDirectories(path);
-        LogPrintf("Opening LevelDB in %s\n", fs::PathToString(path));
+        return parsed.value();
+    }
+
+    bool GetProperty(const std::string& name, std::string& value) const override
+    {
+        return pdb->GetProperty(name, &value);
     }
-    // PathToString() return value is safe to pass to leveldb open function,
-    // because on POSIX leveldb passes the byte string directly to ::open(), and
-    // on Windows it converts from UTF-8 to UTF-16 before calling ::CreateFileW
-    // (see env_posix.cc and env_windows.cc).
-    leveldb::Status status = leveldb::DB::Open(options, fs::PathToString(path), &pdb);
-    dbwrapper_private::HandleError(status);
-    LogPrintf("Opened LevelDB successfully\n");
+};
+
+} // namespace
+
+std::optional<DBEngine> DBEngineFromString(const std::string& name)
+{
+    if (name == "leveldb") return DBEngine::LEVELDB;
+    if (name == "mmap") return DBEngine::MMAP;
+    return std::nullopt;
+}
+
+std::string DBEngineToString(DBEngine engine)
+{
+    switch (engine) {
+    case DBEngine::LEVELDB: return "leveldb";
+    case DBEngine::MMAP: return "mmap";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+const std::vector<std::string>& SelectableDBNames()
+{
+    static const std::vector<std::string> names{"chainstate", "blockindex", "txindex", "blockfilterindex", "coinstatsindex", "addressindex"};
+    return names;
+}
+
+DBEngine GetDBEngine(const ArgsManager& args, const std::string& db_name)
+{
+    DBEngine engine{DBEngine::LEVELDB};
+    for (const std::string& arg : args.GetArgs("-dbengine")) {
+        const auto sep = arg.find(':');
+        if (sep == std::string::npos || arg.substr(0, sep) != db_name) continue;
+        // The last matching value wins, like for any other argument.
+        if (const auto parsed{DBEngineFromString(arg.substr(sep + 1))}) engine = *parsed;
+    }
+    return engine;
+}
+
+DBOptions DBOptions::FromCacheSize(size_t cache_size, DBEngine engine)
+{
+    DBOptions options;
+    options.engine = engine;
+    options.cache_size = cache_size;
+    options.block_cache_size = cache_size / 2;
+    options.write_buffer_size = cache_size / 4; // up to two write buffers may be held in memory simultaneously
+    return options;
+}
+
+static void SyncBackend(DBBackend& backend)
+{
+    // An empty synchronous write flushes everything written before it.
+    backend.Write(*backend.NewBatch(), /*sync=*/true);
+}
+
+DBWriter::DBWriter()
+{
+    m_thread = std::thread(&util::TraceThread, "dbwriter", [this] { ThreadWrite(); });
+}
+
+DBWriter::~DBWriter()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_work_cv.notify_all();
+    m_thread.join();
+}
+
+void DBWriter::ThreadWrite()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (true) {
+        while (!m_stop && m_queue.empty()) {
+            m_work_cv.wait(lock);
+        }
+        if (m_queue.empty()) return;
+
+        std::deque<Job> jobs;
+        jobs.swap(m_queue);
+        {
+            REVERSE_LOCK(lock);
+            for (const Job& job : jobs) {
+                // Once a write failed, later batches for the same database are
+                // dropped; the failure is reported to its next caller.
+                if (job.db->m_async_failed) continue;
+                try {
+                    job.db->m_backend->Write(*job.batch, /*sync=*/false);
+                } catch (const std::exception& e) {
+                    LogPrintf("Failed to write to %s database: %s\n", job.db->m_name, e.what());
+                    job.db->m_async_failed = true;
+                }
+            }
+        }
+        for (const Job& job : jobs) {
+            m_queued_bytes -= job.size;
+            m_unsynced.insert(job.db);
+            job.db->m_async_pending.fetch_sub(1, std::memory_order_release);
+        }
+        jobs.clear();
+        m_done_cv.notify_all();
+    }
+}
+
+void DBWriter::Enqueue(CDBWrapper& db, std::unique_ptr<DBBackend::Batch> batch, size_t size)
+{
+    WAIT_LOCK(m_mutex, lock);
+    // Bound the memory held by the queue if the writer falls behind.
+    while (m_queued_bytes > DBWRAPPER_MAX_ASYNC_BYTES) {
+        m_done_cv.wait(lock);
+    }
+    db.m_async_pending.fetch_add(1, std::memory_order_relaxed);
+    m_queued_bytes += size;
+    m_queue.push_back({&db, std::move(batch), size});
+    m_work_cv.notify_one();
+}
+
+void DBWriter::WaitForJobs(const CDBWrapper& db)
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (db.m_async_pending.load(std::memory_order_acquire) > 0) {
+        m_done_cv.wait(lock);
+    }
+}
+
+bool DBWriter::Sync(CDBWrapper& db)
+{
+    WaitForJobs(db);
+    bool unsynced;
+    {
+        LOCK(m_mutex);
+        unsynced = m_unsynced.erase(&db) > 0;
+    }
+    if (unsynced && !db.m_async_failed) {
+        try {
+            SyncBackend(*db.m_backend);
+        } catch (const std::exception& e) {
+            LogPrintf("Failed to sync %s database: %s\n", db.m_name, e.what());
+            db.m_async_failed = true;
+        }
+    }
+    return !db.m_async_failed;
+}
+
+static std::atomic<DBWriter*> g_db_writer{nullptr};
+
+void SetDBWriter(DBWriter* writer)
+{
+    g_db_writer = writer;
+}
+
+CDBBatch::CDBBatch(const CDBWrapper &_parent) :
+    parent(_parent), batch(_parent.m_backend->NewBatch()), ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0) { }
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, DBEngine engine)
+    : CDBWrapper(path, DBOptions::FromCacheSize(nCacheSize, engine), fMemory, fWipe, obfuscate) {}
+
+CDBWrapper::CDBWrapper(const fs::path& path, const DBOptions& options, bool fMemory, bool fWipe, bool obfuscate)
+    : m_options{options}, m_name{fs::PathToString(path.stem())}, m_writer{g_db_writer}
+{
+    switch (m_options.engine) {
+    case DBEngine::LEVELDB:
+        m_backend = std::make_unique<LevelDBBackend>(path, m_options, fMemory, fWipe);
+        break;
+    case DBEngine::MMAP:
+        m_backend = MakeMmapDBBackend(path, m_options.cache_size, fMemory, fWipe);
+        break;
+    } // no default case, so the compiler can warn about missing cases
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
         LogPrintf("Starting database compaction of %s\n", fs::PathToString(path));
-        pdb->CompactRange(nullptr, nullptr);
+        m_backend->CompactRange(nullptr, nullptr);
         LogPrintf("Finished database compaction of %s\n", fs::PathToString(path));
     }
 
@@ -172,27 +513,26 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
 
 CDBWrapper::~CDBWrapper()
 {
-    delete pdb;
-    pdb = nullptr;
-    delete options.filter_policy;
-    options.filter_policy = nullptr;
-    delete options.info_log;
-    options.info_log = nullptr;
-    delete options.block_cache;
-    options.block_cache = nullptr;
-    delete penv;
-    options.env = nullptr;
+    if (m_writer && !SyncAsyncWrites()) {
+        LogPrintf("Closing %s database after a failed write\n", m_name);
+    }
+}
+
+void CDBWrapper::WaitForAsyncWrites() const
+{
+    if (m_writer) m_writer->WaitForJobs(*this);
 }
 
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
+    // Keep the order of writes if asynchronous batches are still queued.
+    AwaitAsyncWrites();
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
     double mem_before = 0;
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
-    dbwrapper_private::HandleError(status);
+    m_backend->Write(*batch.batch, fSync);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogPrint(BCLog::LEVELDB, "WriteBatch memory usage: db=%s, before=%.1fMiB, after=%.1fMiB\n",
@@ -201,15 +541,39 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
     return true;
 }
 
-size_t CDBWrapper::DynamicMemoryUsage() const
+bool CDBWrapper::WriteBatchAsync(CDBBatch& batch)
+{
+    if (m_async_failed) return false;
+    if (!m_writer) {
+        WriteBatch(batch);
+        batch.Clear();
+        return true;
+    }
+    m_writer->Enqueue(*this, std::exchange(batch.batch, m_backend->NewBatch()), batch.size_estimate);
+    batch.size_estimate = 0;
+    return true;
+}
+
+bool CDBWrapper::SyncAsyncWrites()
 {
-    std::string memory;
-    std::optional<size_t> parsed;
-    if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory) || !(parsed = ToIntegral<size_t>(memory))) {
-        LogPrint(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
-        return 0;
+    LOCK(m_sync_mutex);
+    if (!m_writer) {
+        SyncBackend(*m_backend);
+        return true;
     }
-    return parsed.value();
+    return m_writer->Sync(*this);
+}
+
+size_t CDBWrapper::DynamicMemoryUsage() const
+{
+    return m_backend->DynamicMemoryUsage();
+}
+
+std::string CDBWrapper::GetStats() const
+{
+    std::string stats;
+    m_backend->GetProperty(m_options.engine == DBEngine::LEVELDB ? "leveldb.stats" : "mmapdb.stats", stats);
+    return stats;
 }
 
 // Prefixed with null character to avoid collisions with other keys
@@ -238,23 +602,13 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
-CDBIterator::~CDBIterator() { delete piter; }
+CDBIterator::~CDBIterator() = default;
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
 void CDBIterator::Next() { piter->Next(); }
 
 namespace dbwrapper_private {
 
-void HandleError(const leveldb::Status& status)
-{
-    if (status.ok())
-        return;
-    const std::string errmsg = "Fatal LevelDB error: " + status.ToString();
-    LogPrintf("%s\n", errmsg);
-    LogPrintf("You can use -debug=leveldb to get more complete diagnostic messages\n");
-    throw dbwrapper_error(errmsg);
-}
-
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
 {
     return w.obfuscate_key;
@@ -10,14 +10,24 @@
 #include <serialize.h>
 #include <span.h>
 #include <streams.h>
+#include <sync.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! Queued bytes above which CDBWrapper::WriteBatchAsync blocks until the writer thread catches up
+static const size_t DBWRAPPER_MAX_ASYNC_BYTES = 64 << 20;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -25,15 +35,157 @@ public:
     explicit dbwrapper_error(const std::string& msg) : std::runtime_error(msg) {}
 };
 
+/** Storage engines a CDBWrapper can be backed by. */
+enum class DBEngine {
+    LEVELDB, //!< LevelDB, suited to any workload
+    MMAP,    //!< memory-mapped sorted table plus write log, suited to read-mostly stores
+};
+
+std::optional<DBEngine> DBEngineFromString(const std::string& name);
+std::string DBEngineToString(DBEngine engine);
+
+/** Names of the databases whose engine can be selected with -dbengine. */
+const std::vector<std::string>& SelectableDBNames();
+
+/**
+ * Engine configured for a database through -dbengine=<db>:<engine>, or
+ * LevelDB when none was given. Invalid values are rejected during init.
+ */
+DBEngine GetDBEngine(const ArgsManager& args, const std::string& db_name);
+
+/** Storage engine configuration of one database, see node::GetDBOptions(). */
+struct DBOptions {
+    DBEngine engine{DBEngine::LEVELDB};
+    //! total memory budget of the database; the mmap engine buffers this much of writes
+    size_t cache_size{0};
+    //! size of the LevelDB block cache
+    size_t block_cache_size{0};
+    //! size of a LevelDB write buffer; up to two may be held in memory simultaneously
+    size_t write_buffer_size{0};
+    //! bloom filter bits per key, 0 to disable the filter
+    int bloom_bits{10};
+    //! compress table blocks (only effective if LevelDB is built with Snappy)
+    bool compression{false};
+
+    //! Half of the budget for the block cache and a quarter per write buffer.
+    static DBOptions FromCacheSize(size_t cache_size, DBEngine engine = DBEngine::LEVELDB);
+};
+
+/**
+ * Key/value storage engine behind a CDBWrapper. Keys and values are opaque
+ * byte strings; keys are ordered bytewise. Errors are reported by throwing
+ * dbwrapper_error. Implementations must be safe to use from multiple threads.
+ */
+class DBBackend
+{
+public:
+    /** Set of puts and deletes applied atomically by Write(). */
+    class Batch
+    {
+    public:
+        virtual ~Batch() = default;
+        virtual void Put(Span<const std::byte> key, Span<const std::byte> value) = 0;
+        virtual void Delete(Span<const std::byte> key) = 0;
+        virtual void Clear() = 0;
+    };
+
+    /** Consistent read-only view of the database at the time it was taken. */
+    class Snapshot
+    {
+    public:
+        virtual ~Snapshot() = default;
+    };
+
+    /** Ordered cursor; the returned spans stay valid until the next move. */
+    class Iterator
+    {
+    public:
+        virtual ~Iterator() = default;
+        virtual bool Valid() const = 0;
+        virtual void SeekToFirst() = 0;
+        virtual void Seek(Span<const std::byte> key) = 0;
+        virtual void Next() = 0;
+        virtual Span<const std::byte> Key() const = 0;
+        virtual Span<const std::byte> Value() const = 0;
+    };
+
+    virtual ~DBBackend() = default;
+
+    //! Return false if the key is absent.
+    virtual bool Read(Span<const std::byte> key, std::string& value, const Snapshot* snapshot = nullptr) const = 0;
+    virtual std::unique_ptr<Batch> NewBatch() const = 0;
+    virtual void Write(Batch& batch, bool sync) = 0;
+    //! Iterators created without a snapshot see the state at their creation.
+    virtual std::unique_ptr<Iterator> NewIterator(const Snapshot* snapshot = nullptr) const = 0;
+    virtual std::unique_ptr<Snapshot> NewSnapshot() const = 0;
+
+    //! Approximate on-disk size of the keys in [begin, end).
+    virtual size_t EstimateSize(Span<const std::byte> begin, Span<const std::byte> end) const = 0;
+    //! Compact the keys in [begin, end]; nullptr means an open end.
+    virtual void CompactRange(const Span<const std::byte>* begin, const Span<const std::byte>* end) = 0;
+    //! Approximate memory used by caches and write buffers, in bytes.
+    virtual size_t DynamicMemoryUsage() const = 0;
+    //! Engine specific statistics, see CDBWrapper::GetProperty().
+    virtual bool GetProperty(const std::string& name, std::string& value) const = 0;
+};
+
 class CDBWrapper;
 
-/** These should be considered an implementation detail of the specific database.
+/**
+ * The thread behind CDBWrapper::WriteBatchAsync, owned by the node context and
+ * shared by the databases opened while it is set with SetDBWriter().
+ *
+ * Queued batches are written in submission order without syncing, so the
+ * callers never wait for the storage engine. CDBWrapper::SyncAsyncWrites()
+ * then syncs a database once for all the batches it received since the
+ * previous call. A failed write is logged and reported to the database's
+ * next WriteBatchAsync and SyncAsyncWrites calls.
  */
-namespace dbwrapper_private {
+class DBWriter
+{
+public:
+    DBWriter();
+    //! Writes what is still queued before stopping the thread.
+    ~DBWriter();
+
+    void Enqueue(CDBWrapper& db, std::unique_ptr<DBBackend::Batch> batch, size_t size) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    //! Block until every batch queued for db has been written.
+    void WaitForJobs(const CDBWrapper& db) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    //! Wait for db's queued batches and sync db if it received any since the last sync.
+    bool Sync(CDBWrapper& db) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Job {
+        CDBWrapper* db;
+        std::unique_ptr<DBBackend::Batch> batch;
+        size_t size;
+    };
+
+    Mutex m_mutex;
+    //! wakes the writer thread
+    std::condition_variable m_work_cv;
+    //! wakes threads waiting for jobs to complete
+    std::condition_variable m_done_cv;
+    std::deque<Job> m_queue GUARDED_BY(m_mutex);
+    size_t m_queued_bytes GUARDED_BY(m_mutex){0};
+    //! databases written to since they were last synced
+    std::set<CDBWrapper*> m_unsynced GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+
+    void ThreadWrite() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+};
 
-/** Handle database error by throwing dbwrapper_error exception.
+/**
+ * Hand the asynchronous writes of databases opened from now on to writer.
+ * With nullptr, CDBWrapper::WriteBatchAsync writes synchronously. The writer
+ * must outlive the databases opened while it is set.
  */
-void HandleError(const leveldb::Status& status);
+void SetDBWriter(DBWriter* writer);
+
+/** These should be considered an implementation detail of the specific database.
+ */
+namespace dbwrapper_private {
 
 /** Work around circular dependency, as well as for testing in dbwrapper_tests.
  * Database obfuscation should be considered an implementation detail of the
@@ -50,7 +202,7 @@ class CDBBatch
 
 private:
     const CDBWrapper &parent;
-    leveldb::WriteBatch batch;
+    std::unique_ptr<DBBackend::Batch> batch;
 
     CDataStream ssKey;
     CDataStream ssValue;
@@ -61,11 +213,11 @@ public:
     /**
      * @param[in] _parent   CDBWrapper that this batch is to be submitted to
      */
-    explicit CDBBatch(const CDBWrapper &_parent) : parent(_parent), ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0) { };
+    explicit CDBBatch(const CDBWrapper &_parent);
 
     void Clear()
     {
-        batch.Clear();
+        batch->Clear();
         size_estimate = 0;
     }
 
@@ -74,14 +226,14 @@ public:
     {
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
+        Span<const std::byte> slKey{ssKey};
 
         ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
         ssValue << value;
         ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-        leveldb::Slice slValue((const char*)ssValue.data(), ssValue.size());
+        Span<const std::byte> slValue{ssValue};
 
-        batch.Put(slKey, slValue);
+        batch->Put(slKey, slValue);
         // LevelDB serializes writes as:
         // - byte: header
         // - varint: key length (1 byte up to 127B, 2 bytes up to 16383B, ...)
@@ -99,9 +251,9 @@ public:
     {
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
+        Span<const std::byte> slKey{ssKey};
 
-        batch.Delete(slKey);
+        batch->Delete(slKey);
         // LevelDB serializes erases as:
         // - byte: header
         // - varint: key length
@@ -118,16 +270,16 @@ class CDBIterator
 {
 private:
     const CDBWrapper &parent;
-    leveldb::Iterator *piter;
+    std::unique_ptr<DBBackend::Iterator> piter;
 
 public:
 
     /**
      * @param[in] _parent          Parent CDBWrapper instance.
-     * @param[in] _piter           The original leveldb iterator.
+     * @param[in] _piter           The storage engine's iterator.
      */
-    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
-        parent(_parent), piter(_piter) { };
+    CDBIterator(const CDBWrapper &_parent, std::unique_ptr<DBBackend::Iterator> _piter) :
+        parent(_parent), piter(std::move(_piter)) { };
     ~CDBIterator();
 
     bool Valid() const;
@@ -138,16 +290,14 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
-        piter->Seek(slKey);
+        piter->Seek(ssKey);
     }
 
     void Next();
 
     template<typename K> bool GetKey(K& key) {
-        leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey{MakeByteSpan(slKey), SER_DISK, CLIENT_VERSION};
+            CDataStream ssKey{piter->Key(), SER_DISK, CLIENT_VERSION};
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -156,9 +306,8 @@ public:
     }
 
     template<typename V> bool GetValue(V& value) {
-        leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue{MakeByteSpan(slValue), SER_DISK, CLIENT_VERSION};
+            CDataStream ssValue{piter->Value(), SER_DISK, CLIENT_VERSION};
             ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
             ssValue >> value;
         } catch (const std::exception&) {
@@ -168,7 +317,7 @@ public:
     }
 
     unsigned int GetValueSize() {
-        return piter->value().size();
+        return piter->Value().size();
     }
 
 };
@@ -176,27 +325,14 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend class CDBBatch;
+    friend class DBWriter;
 private:
-    //! custom environment this database is using (may be nullptr in case of default environment)
-    leveldb::Env* penv;
-
-    //! database options used
-    leveldb::Options options;
-
-    //! options used when reading from the database
-    leveldb::ReadOptions readoptions;
-
-    //! options used when iterating over values of the database
-    leveldb::ReadOptions iteroptions;
+    //! the storage engine holding the data
+    std::unique_ptr<DBBackend> m_backend;
 
-    //! options used when writing to the database
-    leveldb::WriteOptions writeoptions;
-
-    //! options used when sync writing to the database
-    leveldb::WriteOptions syncoptions;
-
-    //! the database itself
-    leveldb::DB* pdb;
+    //! the configuration m_backend was opened with
+    const DBOptions m_options;
 
     //! the name of this database
     std::string m_name;
@@ -212,16 +348,40 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! the writer taking WriteBatchAsync batches, if any
+    DBWriter* const m_writer;
+
+    //! batches handed to the writer thread that it has not written yet
+    std::atomic<size_t> m_async_pending{0};
+
+    //! set when an asynchronous write to this database failed
+    std::atomic<bool> m_async_failed{false};
+
+    //! serializes SyncAsyncWrites calls
+    Mutex m_sync_mutex;
+
+    //! block until m_async_pending drops to zero
+    void WaitForAsyncWrites() const;
+
+    //! make earlier WriteBatchAsync calls visible before reading or writing synchronously
+    void AwaitAsyncWrites() const
+    {
+        if (m_async_pending.load(std::memory_order_acquire) > 0) WaitForAsyncWrites();
+    }
+
 public:
     /**
-     * @param[in] path        Location in the filesystem where leveldb data will be stored.
-     * @param[in] nCacheSize  Configures various leveldb cache settings.
-     * @param[in] fMemory     If true, use leveldb's memory environment.
+     * @param[in] path        Location in the filesystem where the data will be stored.
+     * @param[in] nCacheSize  Configures the engine's cache and write buffer sizes.
+     * @param[in] fMemory     If true, keep the data in memory only.
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] engine      Storage engine to back this database with.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, DBEngine engine = DBEngine::LEVELDB);
+    /** @param[in] options  Per-database engine configuration, other parameters as above. */
+    CDBWrapper(const fs::path& path, const DBOptions& options, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -233,15 +393,11 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
 
+        AwaitAsyncWrites();
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        if (!m_backend->Read(ssKey, strValue)) {
+            return false;
         }
         try {
             CDataStream ssValue{MakeByteSpan(strValue), SER_DISK, CLIENT_VERSION};
@@ -267,17 +423,10 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
-        leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
 
+        AwaitAsyncWrites();
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        return true;
+        return m_backend->Read(ssKey, strValue);
     }
 
     template <typename K>
@@ -290,12 +439,43 @@ public:
 
     bool WriteBatch(CDBBatch& batch, bool fSync = false);
 
-    // Get an estimate of LevelDB memory usage (in bytes).
+    /**
+     * Hand the contents of batch to the database writer thread and return
+     * without waiting for the storage engine; batch is left empty. Batches
+     * are applied in submission order, reads from this database wait for
+     * them, and they are only synced to disk by SyncAsyncWrites(). Without a
+     * writer, the batch is written right away. Returns false, without
+     * queueing anything, if an earlier asynchronous write failed.
+     */
+    [[nodiscard]] bool WriteBatchAsync(CDBBatch& batch);
+
+    /**
+     * Durability barrier for WriteBatchAsync: wait until the batches queued
+     * for this database have been written, then sync it to disk. Returns
+     * false if any asynchronous write to this database failed.
+     */
+    [[nodiscard]] bool SyncAsyncWrites() EXCLUSIVE_LOCKS_REQUIRED(!m_sync_mutex);
+
+    // Get an estimate of the storage engine's memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
     CDBIterator *NewIterator()
     {
-        return new CDBIterator(*this, pdb->NewIterator(iteroptions));
+        AwaitAsyncWrites();
+        return new CDBIterator(*this, m_backend->NewIterator());
+    }
+
+    /** Iterate over the state captured by snapshot, which must outlive the iterator. */
+    CDBIterator *NewIterator(const DBBackend::Snapshot& snapshot)
+    {
+        return new CDBIterator(*this, m_backend->NewIterator(&snapshot));
+    }
+
+    /** Capture the current state of the database for consistent iteration. */
+    std::unique_ptr<DBBackend::Snapshot> NewSnapshot() const
+    {
+        AwaitAsyncWrites();
+        return m_backend->NewSnapshot();
     }
 
     /**
@@ -303,6 +483,19 @@ public:
      */
     bool IsEmpty();
 
+    /** Query an engine specific property such as "leveldb.stats". */
+    bool GetProperty(const std::string& name, std::string& value) const
+    {
+        return m_backend->GetProperty(name, value);
+    }
+
+    DBEngine GetEngine() const { return m_options.engine; }
+    const DBOptions& GetOptions() const { return m_options; }
+    const std::string& GetName() const { return m_name; }
+
+    /** Human readable engine statistics ("leveldb.stats" or "mmapdb.stats"). */
+    std::string GetStats() const;
+
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
@@ -311,12 +504,7 @@ public:
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
         ssKey2 << key_end;
-        leveldb::Slice slKey1((const char*)ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2((const char*)ssKey2.data(), ssKey2.size());
-        uint64_t size = 0;
-        leveldb::Range range(slKey1, slKey2);
-        pdb->GetApproximateSizes(&range, 1, &size);
-        return size;
+        return m_backend->EstimateSize(ssKey1, ssKey2);
     }
 
     /**
@@ -330,9 +518,8 @@ public:
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
         ssKey2 << key_end;
-        leveldb::Slice slKey1((const char*)ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2((const char*)ssKey2.data(), ssKey2.size());
-        pdb->CompactRange(&slKey1, &slKey2);
+        const Span<const std::byte> slKey1{ssKey1}, slKey2{ssKey2};
+        m_backend->CompactRange(&slKey1, &slKey2);
     }
 };
 
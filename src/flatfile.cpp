@@ -3,13 +3,135 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <logging.h>
 #include <tinyformat.h>
 #include <util/system.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * Compressed file layout, all integers little endian:
+ * - frame data, in file order
+ * - index: u32 original size and u32 stored size of every frame
+ * - footer: u64 offset of the index, u64 number of frames, u64 original file size, u64 magic
+ */
+constexpr uint64_t COMPRESSED_MAGIC{0x3166636c66747066}; // "fptflcf1"
+constexpr size_t COMPRESSED_INDEX_ENTRY_SIZE{8};
+constexpr size_t COMPRESSED_FOOTER_SIZE{32};
+
+constexpr size_t LZ_MIN_MATCH{4};
+constexpr size_t LZ_MAX_OFFSET{0xffff};
+constexpr int LZ_HASH_BITS{14};
+
+void LZWriteLength(std::vector<unsigned char>& out, size_t len)
+{
+    for (len -= 15; len >= 255; len -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(len);
+}
+
+bool LZReadLength(Span<const unsigned char> in, size_t& i, size_t& len)
+{
+    unsigned char b;
+    do {
+        if (i == in.size()) return false;
+        b = in[i++];
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+void LZWriteSequence(std::vector<unsigned char>& out, Span<const unsigned char> literals, size_t offset, size_t match_len)
+{
+    const size_t match_code{match_len ? match_len - LZ_MIN_MATCH : 0};
+    out.push_back((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(match_code, 15));
+    if (literals.size() >= 15) LZWriteLength(out, literals.size());
+    out.insert(out.end(), literals.begin(), literals.end());
+    if (match_len == 0) return;
+    out.push_back(offset & 0xff);
+    out.push_back(offset >> 8);
+    if (match_code >= 15) LZWriteLength(out, match_code);
+}
+
+/**
+ * Greedy LZ77 with an LZ4-like sequence layout: a token holding the literal
+ * count and the match length in its two nibbles (15 meaning that length bytes
+ * follow), the literals, a 2 byte match offset and the extra length bytes. The
+ * last sequence has literals only.
+ */
+void LZCompress(Span<const unsigned char> in, std::vector<unsigned char>& out)
+{
+    out.clear();
+    std::vector<uint32_t> table(size_t{1} << LZ_HASH_BITS, 0); // position + 1 of the last occurrence
+    size_t anchor{0};
+    size_t i{0};
+    while (in.size() - i >= LZ_MIN_MATCH) {
+        const uint32_t seq{ReadLE32(in.data() + i)};
+        uint32_t& slot{table[(seq * 2654435761U) >> (32 - LZ_HASH_BITS)]};
+        const size_t candidate{slot};
+        slot = i + 1;
+        if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET || ReadLE32(in.data() + candidate - 1) != seq) {
+            ++i;
+            continue;
+        }
+        const size_t match{candidate - 1};
+        size_t len{LZ_MIN_MATCH};
+        while (i + len < in.size() && in[match + len] == in[i + len]) {
+            ++len;
+        }
+        LZWriteSequence(out, in.subspan(anchor, i - anchor), i - match, len);
+        i += len;
+        anchor = i;
+    }
+    LZWriteSequence(out, in.subspan(anchor), 0, 0);
+}
+
+bool LZDecompress(Span<const unsigned char> in, std::vector<unsigned char>& out, size_t out_size)
+{
+    out.resize(out_size);
+    size_t o{0};
+    size_t i{0};
+    while (i < in.size()) {
+        const unsigned char token{in[i++]};
+        size_t literals = token >> 4;
+        if (literals == 15 && !LZReadLength(in, i, literals)) return false;
+        if (literals > in.size() - i || literals > out_size - o) return false;
+        std::copy_n(in.begin() + i, literals, out.begin() + o);
+        i += literals;
+        o += literals;
+        if (i == in.size()) break;
+
+        if (in.size() - i < 2) return false;
+        const size_t offset{ReadLE16(in.data() + i)};
+        i += 2;
+        size_t len = token & 15;
+        if (len == 15 && !LZReadLength(in, i, len)) return false;
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || len > out_size - o) return false;
+        // Matches may overlap their own output, so copy byte by byte.
+        for (size_t from = o - offset; len > 0; --len) {
+            out[o++] = out[from++];
+        }
+    }
+    return o == out_size;
+}
+
+} // namespace
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char* prefix, size_t chunk_size) :
     m_dir(std::move(dir)),
     m_prefix(prefix),
@@ -52,6 +174,161 @@ FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
     return file;
 }
 
+std::shared_ptr<const FlatFileMapping> FlatFileSeq::Map(const FlatFilePos& pos) const
+{
+    if (pos.IsNull()) {
+        return nullptr;
+    }
+    return FlatFileMapping::Open(FileName(pos));
+}
+
+std::shared_ptr<const FlatFileMapping> FlatFileMapping::Open(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(fs::PathToString(path).c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        LogPrintf("Unable to map file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    auto result = std::make_shared<FlatFileMapping>();
+    result->m_mapping = mapping;
+    result->m_size = st.st_size;
+    return result;
+#else
+    // Mapping is not implemented here; callers fall back to reading through a FILE*.
+    return nullptr;
+#endif
+}
+
+FlatFileMapping::~FlatFileMapping()
+{
+#ifndef WIN32
+    if (m_mapping) munmap(m_mapping, m_size);
+#endif
+}
+
+std::shared_ptr<const CompressedFlatFile> CompressedFlatFile::Open(const fs::path& path)
+{
+    auto mapping = FlatFileMapping::Open(path);
+    if (!mapping) {
+        return nullptr;
+    }
+    const Span<const unsigned char> data{mapping->Data()};
+    if (data.size() < COMPRESSED_FOOTER_SIZE) {
+        LogPrintf("Malformed compressed file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    const unsigned char* footer = data.data() + data.size() - COMPRESSED_FOOTER_SIZE;
+    const uint64_t index_pos{ReadLE64(footer)};
+    const uint64_t count{ReadLE64(footer + 8)};
+    const uint64_t size{ReadLE64(footer + 16)};
+    if (ReadLE64(footer + 24) != COMPRESSED_MAGIC || index_pos > data.size() - COMPRESSED_FOOTER_SIZE ||
+        (data.size() - COMPRESSED_FOOTER_SIZE - index_pos) / COMPRESSED_INDEX_ENTRY_SIZE != count ||
+        (data.size() - COMPRESSED_FOOTER_SIZE - index_pos) % COMPRESSED_INDEX_ENTRY_SIZE != 0) {
+        LogPrintf("Malformed compressed file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+
+    auto result = std::make_shared<CompressedFlatFile>();
+    result->m_frames.reserve(count);
+    uint64_t pos{0};
+    uint64_t data_pos{0};
+    for (uint64_t i = 0; i < count; ++i) {
+        const unsigned char* entry = data.data() + index_pos + i * COMPRESSED_INDEX_ENTRY_SIZE;
+        const Frame frame{pos, ReadLE32(entry), data_pos, ReadLE32(entry + 4)};
+        if (frame.size == 0 || frame.data_size > frame.size) {
+            LogPrintf("Malformed compressed file %s\n", fs::PathToString(path));
+            return nullptr;
+        }
+        result->m_frames.push_back(frame);
+        pos += frame.size;
+        data_pos += frame.data_size;
+    }
+    if (pos != size || data_pos != index_pos) {
+        LogPrintf("Malformed compressed file %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    result->m_mapping = std::move(mapping);
+    result->m_size = size;
+    return result;
+}
+
+bool CompressedFlatFile::Write(const fs::path& path, Span<const unsigned char> data, const std::vector<size_t>& frame_ends)
+{
+    FILE* file = fsbridge::fopen(path, "wb");
+    if (!file) {
+        return error("%s: failed to open file %s", __func__, fs::PathToString(path));
+    }
+
+    std::vector<unsigned char> index;
+    std::vector<unsigned char> compressed;
+    uint64_t data_pos{0};
+    size_t start{0};
+    for (const size_t end : frame_ends) {
+        if (end <= start || end > data.size() || end - start > std::numeric_limits<uint32_t>::max()) {
+            fclose(file);
+            return error("%s: invalid frame boundaries for %s", __func__, fs::PathToString(path));
+        }
+        const Span<const unsigned char> frame{data.subspan(start, end - start)};
+        LZCompress(frame, compressed);
+        const Span<const unsigned char> stored{compressed.size() < frame.size() ? Span<const unsigned char>{compressed} : frame};
+        if (fwrite(stored.data(), 1, stored.size(), file) != stored.size()) {
+            fclose(file);
+            return error("%s: failed to write %s", __func__, fs::PathToString(path));
+        }
+        unsigned char entry[COMPRESSED_INDEX_ENTRY_SIZE];
+        WriteLE32(entry, frame.size());
+        WriteLE32(entry + 4, stored.size());
+        index.insert(index.end(), entry, entry + sizeof(entry));
+        data_pos += stored.size();
+        start = end;
+    }
+    if (start != data.size()) {
+        fclose(file);
+        return error("%s: frames do not cover %s", __func__, fs::PathToString(path));
+    }
+
+    unsigned char footer[COMPRESSED_FOOTER_SIZE];
+    WriteLE64(footer, data_pos);
+    WriteLE64(footer + 8, frame_ends.size());
+    WriteLE64(footer + 16, data.size());
+    WriteLE64(footer + 24, COMPRESSED_MAGIC);
+    index.insert(index.end(), footer, footer + sizeof(footer));
+    if (fwrite(index.data(), 1, index.size(), file) != index.size() || !FileCommit(file)) {
+        fclose(file);
+        return error("%s: failed to write %s", __func__, fs::PathToString(path));
+    }
+    fclose(file);
+    return true;
+}
+
+bool CompressedFlatFile::ReadFrame(uint64_t pos, std::vector<unsigned char>& frame, uint64_t& frame_pos) const
+{
+    if (pos >= m_size) {
+        return false;
+    }
+    // Last frame starting at or before pos
+    const auto it = std::prev(std::upper_bound(m_frames.begin(), m_frames.end(), pos,
+        [](uint64_t p, const Frame& f) { return p < f.pos; }));
+    const Span<const unsigned char> stored{m_mapping->Data().subspan(it->data_pos, it->data_size)};
+    frame_pos = it->pos;
+    if (it->data_size == it->size) {
+        frame.assign(stored.begin(), stored.end());
+        return true;
+    }
+    return LZDecompress(stored, frame, it->size);
+}
+
 size_t FlatFileSeq::Allocate(const FlatFilePos& pos, size_t add_size, bool& out_of_space)
 {
     out_of_space = false;
@@ -6,10 +6,14 @@
 #ifndef BITCOIN_FLATFILE_H
 #define BITCOIN_FLATFILE_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
 
 struct FlatFilePos
 {
@@ -39,6 +43,76 @@ struct FlatFilePos
     std::string ToString() const;
 };
 
+/**
+ * A read-only memory mapping of a whole flat file. The file must not shrink
+ * while it is mapped, so only files that are no longer written to should be
+ * mapped.
+ */
+class FlatFileMapping
+{
+private:
+    void* m_mapping{nullptr};
+    size_t m_size{0};
+
+public:
+    /** Map the file at path. Returns nullptr if the file is empty or cannot be mapped. */
+    static std::shared_ptr<const FlatFileMapping> Open(const fs::path& path);
+
+    FlatFileMapping() = default;
+    ~FlatFileMapping();
+    FlatFileMapping(const FlatFileMapping&) = delete;
+    FlatFileMapping& operator=(const FlatFileMapping&) = delete;
+
+    Span<const unsigned char> Data() const { return {static_cast<const unsigned char*>(m_mapping), m_size}; }
+};
+
+/**
+ * A read-only flat file stored as independently compressed frames followed by
+ * an index of the frames. Callers choose the frame boundaries when writing, so
+ * that a record which lies within one frame is read back with a single frame
+ * decode. Frames that do not shrink are stored as is.
+ */
+class CompressedFlatFile
+{
+private:
+    struct Frame {
+        uint64_t pos;       //!< offset of the frame in the original file
+        uint32_t size;      //!< size of the frame in the original file
+        uint64_t data_pos;  //!< offset of the frame data in the compressed file
+        uint32_t data_size; //!< size of the frame data; equal to size if stored uncompressed
+    };
+
+    std::shared_ptr<const FlatFileMapping> m_mapping;
+    std::vector<Frame> m_frames;
+    uint64_t m_size{0};
+
+public:
+    /** Open the compressed file at path. Returns nullptr if it is missing or malformed. */
+    static std::shared_ptr<const CompressedFlatFile> Open(const fs::path& path);
+
+    /**
+     * Compress data into a new file at path.
+     *
+     * @param[in] frame_ends Increasing end offsets of the frames; the last one must be data.size().
+     * @return true on success, false on failure.
+     */
+    static bool Write(const fs::path& path, Span<const unsigned char> data, const std::vector<size_t>& frame_ends);
+
+    /** Size of the original file. */
+    uint64_t Size() const { return m_size; }
+    /** Size of the compressed file. */
+    uint64_t DataSize() const { return m_mapping->Data().size(); }
+
+    /**
+     * Decode the frame that contains position pos of the original file.
+     *
+     * @param[out] frame The decoded frame.
+     * @param[out] frame_pos Offset of the frame in the original file.
+     * @return true on success, false if pos is out of range or the frame is corrupt.
+     */
+    bool ReadFrame(uint64_t pos, std::vector<unsigned char>& frame, uint64_t& frame_pos) const;
+};
+
 /**
  * FlatFileSeq represents a sequence of numbered files storing raw data. This class facilitates
  * access to and efficient management of these files.
@@ -66,6 +140,9 @@ public:
     /** Open a handle to the file at the given position. */
     FILE* Open(const FlatFilePos& pos, bool read_only = false);
 
+    /** Map the whole file at the given position read-only. Returns nullptr on failure. */
+    std::shared_ptr<const FlatFileMapping> Map(const FlatFilePos& pos) const;
+
     /**
      * Allocate additional space in a file after the given starting position. The amount allocated
      * will be the minimum multiple of the sequence chunk size greater than add_size.
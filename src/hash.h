@@ -188,6 +188,31 @@ public:
     }
 };
 
+/** Writes data to an underlying stream, while hashing the written data. */
+template<typename Dest>
+class CHashedWriter : public CHashWriter
+{
+private:
+    Dest* dest;
+
+public:
+    explicit CHashedWriter(Dest* dest_) : CHashWriter(dest_->GetType(), dest_->GetVersion()), dest(dest_) {}
+
+    void write(Span<const std::byte> src)
+    {
+        dest->write(src);
+        CHashWriter::write(src);
+    }
+
+    template<typename T>
+    CHashedWriter<Dest>& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
 /** Compute the 256-bit hash of an object's serialization. */
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
@@ -0,0 +1,244 @@
+// Copyright (c) 2017-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <node/blockstorage.h>
+#include <node/caches.h>
+#include <script/script.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+using node::ReadBlockFromDisk;
+using node::UndoReadFromDisk;
+
+constexpr uint8_t DB_OUTPUT{'o'};
+constexpr uint8_t DB_SPENT{'s'};
+
+std::unique_ptr<AddressIndex> g_address_index;
+
+namespace {
+/**
+ * Key of the records of an output. Scripts are identified by the first 8
+ * bytes of their SHA256 hash; the next 8 bytes are stored in the output
+ * record to tell apart scripts whose truncated hashes collide. The output
+ * itself is identified by its full outpoint.
+ */
+struct DBOutputKey {
+    uint8_t prefix;
+    uint64_t script_key;
+    int height;
+    uint256 txid;
+    uint32_t vout;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, prefix);
+        ser_writedata64(s, script_key);
+        ser_writedata32be(s, height);
+        s << txid;
+        ser_writedata32be(s, vout);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        prefix = ser_readdata8(s);
+        script_key = ser_readdata64(s);
+        height = ser_readdata32be(s);
+        s >> txid;
+        vout = ser_readdata32be(s);
+    }
+};
+
+struct DBOutputValue {
+    uint64_t script_check;
+    CAmount value;
+
+    SERIALIZE_METHODS(DBOutputValue, obj) { READWRITE(obj.script_check, VARINT_MODE(obj.value, VarIntMode::NONNEGATIVE_SIGNED)); }
+};
+
+struct DBSpentValue {
+    uint256 txid;
+    uint32_t vin;
+    int height;
+
+    SERIALIZE_METHODS(DBSpentValue, obj) { READWRITE(obj.txid, VARINT(obj.vin), VARINT_MODE(obj.height, VarIntMode::NONNEGATIVE_SIGNED)); }
+};
+
+uint256 HashScript(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+DBOutputKey MakeOutputKey(uint8_t prefix, const uint256& script_hash, int height, const uint256& txid, uint32_t vout)
+{
+    return {prefix, ReadLE64(script_hash.begin()), height, txid, vout};
+}
+} // namespace
+
+/** Access to the addressindex database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "addressindex", node::GetDBOptions(gArgs, "addressindex", n_cache_size), f_memory, f_wipe)
+{}
+
+/** The records of a block, computed ahead of writing them */
+struct AddressIndex::AddressData : public BaseIndex::BlockData {
+    std::vector<std::pair<DBOutputKey, DBOutputValue>> outputs;
+    std::vector<std::pair<DBOutputKey, DBSpentValue>> spends;
+};
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(std::make_unique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+std::unique_ptr<BaseIndex::BlockData> AddressIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
+{
+    auto data{std::make_unique<AddressData>()};
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight == 0) return data;
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+        for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable()) continue;
+            const uint256 script_hash{HashScript(out.scriptPubKey)};
+            data->outputs.emplace_back(MakeOutputKey(DB_OUTPUT, script_hash, pindex->nHeight, txid, j),
+                                       DBOutputValue{ReadLE64(script_hash.begin() + 8), out.nValue});
+        }
+
+        // The coinbase tx has no undo data since no former output is spent
+        if (tx.IsCoinBase()) continue;
+        const CTxUndo& tx_undo = block_undo.vtxundo.at(i - 1);
+        for (uint32_t j = 0; j < tx.vin.size(); ++j) {
+            const Coin& coin = tx_undo.vprevout.at(j);
+            const COutPoint& prevout = tx.vin[j].prevout;
+            data->spends.emplace_back(MakeOutputKey(DB_SPENT, HashScript(coin.out.scriptPubKey), coin.nHeight, prevout.hash, prevout.n),
+                                      DBSpentValue{txid, j, pindex->nHeight});
+        }
+    }
+    return data;
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return WritePreparedBlock(block, pindex, PrepareBlock(block, pindex));
+}
+
+bool AddressIndex::WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data)
+{
+    if (!data) {
+        return false;
+    }
+    const AddressData& records = static_cast<const AddressData&>(*data);
+    CDBBatch batch(*m_db);
+    for (const auto& [key, value] : records.outputs) {
+        batch.Write(key, value);
+    }
+    for (const auto& [key, value] : records.spends) {
+        batch.Write(key, value);
+    }
+    return m_db->WriteBatchAsync(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Erase the records of the disconnected blocks, so that their outputs and
+    // spends don't show up in the history of their scripts. Only the blocks
+    // to disconnect are collected under cs_main; they are read without it.
+    std::vector<const CBlockIndex*> disconnected;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+            disconnected.push_back(pindex);
+        }
+    }
+    CDBBatch batch(*m_db);
+    const auto& consensus_params{Params().GetConsensus()};
+    for (const CBlockIndex* pindex : disconnected) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        const auto data{PrepareBlock(block, pindex)};
+        if (!data) {
+            return error("%s: Failed to read undo data of block %s",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        const AddressData& records = static_cast<const AddressData&>(*data);
+        for (const auto& output : records.outputs) {
+            batch.Erase(output.first);
+        }
+        for (const auto& spend : records.spends) {
+            batch.Erase(spend.first);
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::FindScriptHistory(const CScript& script, size_t skip, size_t count, bool unspent_only,
+                                     std::vector<AddressHistoryEntry>& entries) const
+{
+    const uint256 script_hash{HashScript(script)};
+    const uint64_t script_key{ReadLE64(script_hash.begin())};
+    const uint64_t script_check{ReadLE64(script_hash.begin() + 8)};
+
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBOutputKey{DB_OUTPUT, script_key, 0, uint256(), 0});
+    for (; db_it->Valid() && entries.size() < count; db_it->Next()) {
+        DBOutputKey key;
+        if (!db_it->GetKey(key) || key.prefix != DB_OUTPUT || key.script_key != script_key) break;
+        DBOutputValue value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: Cannot read output record of script %s", __func__, script_hash.ToString());
+        }
+        if (value.script_check != script_check) continue;
+
+        AddressHistoryEntry entry;
+        entry.height = key.height;
+        entry.txid = key.txid;
+        entry.vout = key.vout;
+        entry.value = value.value;
+        key.prefix = DB_SPENT;
+        if (DBSpentValue spent; m_db->Read(key, spent)) {
+            if (unspent_only) continue;
+            entry.spent = AddressHistoryEntry::Spend{spent.txid, spent.vin, spent.height};
+        }
+        if (skip > 0) {
+            --skip;
+            continue;
+        }
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2017-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <consensus/amount.h>
+#include <index/base.h>
+#include <uint256.h>
+
+#include <optional>
+#include <vector>
+
+class CScript;
+
+/** An output paying to a script, as recorded by the AddressIndex */
+struct AddressHistoryEntry {
+    //! Height of the block that created the output
+    int height{0};
+    uint256 txid;
+    uint32_t vout{0};
+    CAmount value{0};
+
+    /** The input that spent the output */
+    struct Spend {
+        uint256 txid;
+        uint32_t vin{0};
+        int height{0};
+    };
+    //! Set if the output is spent in the indexed chain
+    std::optional<Spend> spent;
+};
+
+/**
+ * AddressIndex records, for each scriptPubKey, the outputs paying to it and
+ * the inputs that spent them. The index is written to a LevelDB database.
+ * Records are keyed by a truncated hash of the script followed by the height
+ * of the output, so that the history of a script is a single range of the
+ * database, ordered by height.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    struct AddressData;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /// Look up the outputs paying to a script, ordered by height.
+    ///
+    /// @param[in]   script  The scriptPubKey to look up.
+    /// @param[in]   skip  The number of matching outputs to skip.
+    /// @param[in]   count  The maximum number of outputs to return.
+    /// @param[in]   unspent_only  Whether to leave out outputs that are spent in the indexed chain.
+    /// @param[out]  entries  The outputs found.
+    /// @return  false if the database could not be read, true otherwise
+    bool FindScriptHistory(const CScript& script, size_t skip, size_t count, bool unspent_only,
+                           std::vector<AddressHistoryEntry>& entries) const;
+};
+
+/// The global address index. May be null.
+extern std::unique_ptr<AddressIndex> g_address_index;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
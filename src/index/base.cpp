@@ -9,17 +9,26 @@
 #include <shutdown.h>
 #include <tinyformat.h>
 #include <util/syscall_sandbox.h>
+#include <util/system.h>
 #include <util/thread.h>
 #include <util/translation.h>
 #include <validation.h> // For g_chainman
 #include <warnings.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <thread>
+
 using node::ReadBlockFromDisk;
 
 constexpr uint8_t DB_BEST_BLOCK{'B'};
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+constexpr size_t SYNC_BATCH_SIZE = 64; // blocks read and prepared in parallel
 
 template <typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -31,8 +40,116 @@ static void FatalError(const char* fmt, const Args&... args)
     StartShutdown();
 }
 
-BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
-    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+/**
+ * Threads that read and prepare the blocks of each batch during the initial
+ * sync of an index. They are started once for the whole sync and wait for the
+ * next batch in between. The thread calling Run() works on the batch too.
+ */
+class IndexSyncWorkers
+{
+    using Job = std::function<void(size_t)>;
+
+    Mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    //! The batch being run: (*m_job)(i) for every i below m_count
+    const Job* m_job GUARDED_BY(m_mutex){nullptr};
+    size_t m_count GUARDED_BY(m_mutex){0};
+    size_t m_next GUARDED_BY(m_mutex){0};
+    //! Jobs taken and not finished yet
+    size_t m_running GUARDED_BY(m_mutex){0};
+    //! Why a job of the current batch threw, if one did
+    std::optional<std::string> m_error GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void RunJob(const Job& job, size_t i)
+    {
+        std::optional<std::string> error;
+        try {
+            job(i);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        {
+            LOCK(m_mutex);
+            if (error) {
+                if (!m_error) m_error = std::move(error);
+                m_next = m_count; // Skip the rest of the batch
+            }
+            if (--m_running > 0 || m_next < m_count) return;
+        }
+        m_done_cv.notify_all();
+    }
+
+    void ThreadWork()
+    {
+        SetSyscallSandboxPolicy(SyscallSandboxPolicy::TX_INDEX);
+        while (true) {
+            const Job* job;
+            size_t i;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_work_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_next < m_count; });
+                if (m_stop) return;
+                job = m_job;
+                i = m_next++;
+                ++m_running;
+            }
+            RunJob(*job, i);
+        }
+    }
+
+public:
+    IndexSyncWorkers(const std::string& name, int threads)
+    {
+        for (int n = 0; n < threads; ++n) {
+            m_threads.emplace_back([this, name, n] {
+                util::TraceThread(strprintf("%s.%i", name, n).c_str(), [this] { ThreadWork(); });
+            });
+        }
+    }
+
+    ~IndexSyncWorkers()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_work_cv.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /** Run job(i) for every i below count. Returns the error if a job threw, after which the remaining ones are skipped. */
+    std::optional<std::string> Run(size_t count, const Job& job)
+    {
+        {
+            LOCK(m_mutex);
+            m_job = &job;
+            m_count = count;
+            m_next = 0;
+            m_error.reset();
+        }
+        m_work_cv.notify_all();
+        while (true) {
+            size_t i;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                if (m_next >= m_count) {
+                    m_done_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_running == 0; });
+                    m_job = nullptr;
+                    m_count = m_next = 0;
+                    return m_error;
+                }
+                i = m_next++;
+                ++m_running;
+            }
+            RunJob(job, i);
+        }
+    }
+};
+
+BaseIndex::DB::DB(const fs::path& path, const DBOptions& options, bool f_memory, bool f_wipe, bool f_obfuscate) :
+    CDBWrapper(path, options, f_memory, f_wipe, f_obfuscate)
 {}
 
 bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
@@ -136,6 +253,12 @@ void BaseIndex::ThreadSync()
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
+        const int num_threads{m_sync_threads > 0 ? m_sync_threads : std::max(GetNumCores(), 1)};
+        std::optional<IndexSyncWorkers> workers;
+        if (num_threads > 1) workers.emplace(GetName(), num_threads - 1);
+        std::vector<const CBlockIndex*> batch;
+        std::vector<CBlock> blocks;
+        std::vector<std::unique_ptr<BlockData>> prepared;
         while (true) {
             if (m_interrupt) {
                 m_best_block_index = pindex;
@@ -146,9 +269,13 @@ void BaseIndex::ThreadSync()
                 return;
             }
 
+            // Collect the next blocks to sync. Only the first one can require a
+            // rewind, the others follow it in the active chain.
+            batch.clear();
+            const CBlockIndex* pindex_next;
             {
                 LOCK(cs_main);
-                const CBlockIndex* pindex_next = NextSyncBlock(pindex, m_chainstate->m_chain);
+                pindex_next = NextSyncBlock(pindex, m_chainstate->m_chain);
                 if (!pindex_next) {
                     m_best_block_index = pindex;
                     m_synced = true;
@@ -156,39 +283,74 @@ void BaseIndex::ThreadSync()
                     Commit();
                     break;
                 }
-                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
-                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
-                               __func__, GetName());
-                    return;
-                }
-                pindex = pindex_next;
             }
-
-            int64_t current_time = GetTime();
-            if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
-                LogPrintf("Syncing %s with block chain from height %d\n",
-                          GetName(), pindex->nHeight);
-                last_log_time = current_time;
+            // Rewinding may read blocks from disk, so it is done without cs_main.
+            if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
+                FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                           __func__, GetName());
+                return;
             }
-
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
-                m_best_block_index = pindex;
-                last_locator_write_time = current_time;
-                // No need to handle errors in Commit. See rationale above.
-                Commit();
+            {
+                LOCK(cs_main);
+                const size_t batch_size = num_threads > 1 ? SYNC_BATCH_SIZE : 1;
+                while (pindex_next && batch.size() < batch_size) {
+                    batch.push_back(pindex_next);
+                    pindex_next = m_chainstate->m_chain.Next(pindex_next);
+                }
             }
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
+            // Read and prepare the blocks in parallel.
+            const size_t count = batch.size();
+            blocks.assign(count, CBlock{});
+            prepared.clear();
+            prepared.resize(count);
+            const auto read_block = [&](size_t i) {
+                if (m_interrupt) return;
+                if (!ReadBlockFromDisk(blocks[i], batch[i], consensus_params)) {
+                    throw std::runtime_error(strprintf("Failed to read block %s from disk", batch[i]->GetBlockHash().ToString()));
+                }
+                prepared[i] = PrepareBlock(blocks[i], batch[i]);
+            };
+            std::optional<std::string> read_error;
+            if (workers) {
+                read_error = workers->Run(count, read_block);
+            } else {
+                try {
+                    for (size_t i = 0; i < count; ++i) read_block(i);
+                } catch (const std::exception& e) {
+                    read_error = e.what();
+                }
             }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
+            if (m_interrupt) continue;
+            if (read_error) {
+                FatalError("%s: %s", __func__, *read_error);
                 return;
             }
+
+            // Write them in chain order.
+            for (size_t i = 0; i < count; ++i) {
+                pindex = batch[i];
+
+                int64_t current_time = GetTime();
+                if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+                    LogPrintf("Syncing %s with block chain from height %d\n",
+                              GetName(), pindex->nHeight);
+                    last_log_time = current_time;
+                }
+
+                if (pindex->pprev && last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                    m_best_block_index = pindex->pprev;
+                    last_locator_write_time = current_time;
+                    // No need to handle errors in Commit. See rationale above.
+                    Commit();
+                }
+
+                if (!WritePreparedBlock(blocks[i], pindex, std::move(prepared[i]))) {
+                    FatalError("%s: Failed to write block %s to index database",
+                               __func__, pindex->GetBlockHash().ToString());
+                    return;
+                }
+            }
         }
     }
 
@@ -202,9 +364,14 @@ void BaseIndex::ThreadSync()
 bool BaseIndex::Commit()
 {
     CDBBatch batch(GetDB());
-    if (!CommitInternal(batch) || !GetDB().WriteBatch(batch)) {
+    if (!CommitInternal(batch)) {
         return error("%s: Failed to commit latest %s state", __func__, GetName());
     }
+    // Make the locator and the index data written before it durable
+    // together, on this thread rather than in the chainstate flush.
+    if (!GetDB().WriteBatchAsync(batch) || !GetDB().SyncAsyncWrites()) {
+        return error("%s: Failed to write latest %s state", __func__, GetName());
+    }
     return true;
 }
 
@@ -378,6 +545,8 @@ IndexSummary BaseIndex::GetSummary() const
     IndexSummary summary{};
     summary.name = GetName();
     summary.synced = m_synced;
-    summary.best_block_height = m_best_block_index ? m_best_block_index.load()->nHeight : 0;
+    const CBlockIndex* best_block_index{m_best_block_index.load()};
+    summary.best_block_height = best_block_index ? best_block_index->nHeight : 0;
+    if (best_block_index) summary.best_block_hash = best_block_index->GetBlockHash();
     return summary;
 }
@@ -17,6 +17,7 @@ struct IndexSummary {
     std::string name;
     bool synced{false};
     int best_block_height{0};
+    uint256 best_block_hash;
 };
 
 /**
@@ -37,7 +38,7 @@ protected:
     class DB : public CDBWrapper
     {
     public:
-        DB(const fs::path& path, size_t n_cache_size,
+        DB(const fs::path& path, const DBOptions& options,
            bool f_memory = false, bool f_wipe = false, bool f_obfuscate = false);
 
         /// Read block locator of the chain that the index is in sync with.
@@ -59,6 +60,9 @@ private:
     std::thread m_thread_sync;
     CThreadInterrupt m_interrupt;
 
+    /// Threads that read and prepare blocks during the initial sync, 0 for one per core.
+    int m_sync_threads{0};
+
     /// Sync the index with the block index starting from the current best block.
     /// Intended to be run in its own thread, m_thread_sync, and can be
     /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
@@ -90,6 +94,23 @@ protected:
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Index data of a block that is computed ahead of writing it, see PrepareBlock().
+    struct BlockData {
+        virtual ~BlockData() = default;
+    };
+
+    /// Compute the index data of a block that does not depend on earlier blocks,
+    /// such as reading its undo data. During the initial sync this is called on
+    /// several threads at once and out of chain order; its result is passed to
+    /// WritePreparedBlock() in chain order.
+    virtual std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const { return nullptr; }
+
+    /// Write update index entries for a block, given the result of PrepareBlock().
+    virtual bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data)
+    {
+        return WriteBlock(block, pindex);
+    }
+
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
     virtual bool CommitInternal(CDBBatch& batch);
@@ -123,8 +144,15 @@ public:
     /// Stops the instance from staying in sync with blockchain updates.
     void Stop();
 
+    /// Set the number of threads that read and prepare blocks during the
+    /// initial sync, 0 for one per core. Must be called before Start().
+    void SetSyncThreads(int threads) { m_sync_threads = threads; }
+
     /// Get a summary of the index and its state.
     IndexSummary GetSummary() const;
+
+    /// Get the index's database, e.g. for reporting its statistics.
+    const CDBWrapper& GetDatabase() const { return GetDB(); }
 };
 
 #endif // BITCOIN_INDEX_BASE_H
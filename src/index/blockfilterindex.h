@@ -43,8 +43,14 @@ protected:
 
     bool CommitInternal(CDBBatch& batch) override;
 
+    struct FilterData;
+
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data) override;
+
     bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
 
     BaseIndex::DB& GetDB() const override { return *m_db; }
@@ -2,11 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <coins.h>
 #include <crypto/muhash.h>
 #include <index/coinstatsindex.h>
+#include <kernel.h>
 #include <node/blockstorage.h>
+#include <node/caches.h>
 #include <serialize.h>
 #include <txdb.h>
 #include <undo.h>
@@ -21,6 +24,10 @@ using node::UndoReadFromDisk;
 static constexpr uint8_t DB_BLOCK_HASH{'s'};
 static constexpr uint8_t DB_BLOCK_HEIGHT{'t'};
 static constexpr uint8_t DB_MUHASH{'M'};
+static constexpr uint8_t DB_AGE_BUCKETS{'A'};
+
+//! Granularity of the coin ages tracked for the stake statistics
+static constexpr int64_t AGE_BUCKET_SECONDS{24 * 60 * 60};
 
 namespace {
 
@@ -38,6 +45,11 @@ struct DBVal {
     CAmount total_unspendables_bip30;
     CAmount total_unspendables_scripts;
     CAmount total_unspendables_unclaimed_rewards;
+    CAmount total_pow_reward;
+    CAmount total_pos_reward;
+    CAmount total_fees_destroyed;
+    CAmount stakeable_amount;
+    uint64_t stake_coin_days;
 
     SERIALIZE_METHODS(DBVal, obj)
     {
@@ -54,6 +66,11 @@ struct DBVal {
         READWRITE(obj.total_unspendables_bip30);
         READWRITE(obj.total_unspendables_scripts);
         READWRITE(obj.total_unspendables_unclaimed_rewards);
+        READWRITE(obj.total_pow_reward);
+        READWRITE(obj.total_pos_reward);
+        READWRITE(obj.total_fees_destroyed);
+        READWRITE(obj.stakeable_amount);
+        READWRITE(obj.stake_coin_days);
     }
 };
 
@@ -97,6 +114,55 @@ struct DBHashKey {
     }
 };
 
+/** The creation time of a coin, which its stake age counts from. pindex is a descendant of the block that created it. */
+int64_t CoinTime(const Coin& coin, const CBlockIndex* pindex)
+{
+    return coin.nTime ? coin.nTime : pindex->GetAncestor(coin.nHeight)->GetBlockTime();
+}
+
+/** The age bucket a coin is counted in. pindex is a descendant of the block that created it. */
+int64_t AgeBucket(const Coin& coin, const CBlockIndex* pindex)
+{
+    return CoinTime(coin, pindex) / AGE_BUCKET_SECONDS;
+}
+
+/** Add amount to an age bucket, dropping the bucket once it is empty. */
+void AddToAgeBucket(std::map<int64_t, CAmount>& age_buckets, int64_t bucket, CAmount amount)
+{
+    const auto it{age_buckets.emplace(bucket, 0).first};
+    if ((it->second += amount) == 0) age_buckets.erase(it);
+}
+
+/**
+ * Sum up the coins that can stake at the given time, weighing their amounts by
+ * age like CheckStakeKernelHash() does. Ages are rounded to the middle of their
+ * bucket. Only the buckets younger than the maximum stake age are visited; the
+ * older ones make up the rest of total_amount.
+ */
+void SumStakeAges(const std::map<int64_t, CAmount>& age_buckets, CAmount total_amount, int64_t time, const Consensus::Params& params,
+                  CAmount& stakeable_amount, uint64_t& stake_coin_days)
+{
+    const int64_t min_weight_age{IsProtocolV03(time) ? params.nStakeMinAge : 0};
+    CAmount max_age_amount{total_amount};
+    stakeable_amount = total_amount;
+    arith_uint256 coin_seconds;
+    for (auto it = age_buckets.rbegin(); it != age_buckets.rend(); ++it) {
+        const auto& [bucket, amount] = *it;
+        const int64_t age{time - bucket * AGE_BUCKET_SECONDS - AGE_BUCKET_SECONDS / 2};
+        if (age >= params.nStakeMaxAge) break;
+        max_age_amount -= amount;
+        if (age < params.nStakeMinAge) {
+            stakeable_amount -= amount;
+        } else if (amount > 0) {
+            coin_seconds += arith_uint256(amount) * arith_uint256(age - min_weight_age);
+        }
+    }
+    if (max_age_amount > 0) {
+        coin_seconds += arith_uint256(max_age_amount) * arith_uint256(params.nStakeMaxAge - min_weight_age);
+    }
+    stake_coin_days = (coin_seconds / arith_uint256(COIN * 24 * 60 * 60)).GetLow64();
+}
+
 }; // namespace
 
 std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
@@ -106,35 +172,47 @@ CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
     fs::path path{gArgs.GetDataDirNet() / "indexes" / "coinstats"};
     fs::create_directories(path);
 
-    m_db = std::make_unique<CoinStatsIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe);
+    m_db = std::make_unique<CoinStatsIndex::DB>(path / "db", node::GetDBOptions(gArgs, "coinstatsindex", n_cache_size), f_memory, f_wipe);
+
+    // peercoin: indexes built before the stake statistics were added have to be rebuilt
+    if (!m_db->Exists(DB_AGE_BUCKETS)) {
+        if (!m_db->IsEmpty()) {
+            LogPrintf("%s: Rebuilding %s to add stake statistics\n", __func__, GetName());
+            m_db.reset();
+            m_db = std::make_unique<CoinStatsIndex::DB>(path / "db", node::GetDBOptions(gArgs, "coinstatsindex", n_cache_size), f_memory, /*f_wipe=*/true);
+        }
+        m_db->Write(DB_AGE_BUCKETS, m_age_buckets);
+    }
 }
 
-bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+/** The changes a block makes to the UTXO set statistics, computed ahead of writing them */
+struct CoinStatsIndex::StatsDelta : public BaseIndex::BlockData {
+    MuHash3072 muhash;
+    int64_t transaction_output_count{0};
+    int64_t bogo_size{0};
+    CAmount total_amount{0};
+    CAmount total_unspendable_amount{0};
+    CAmount total_prevout_spent_amount{0};
+    CAmount total_new_outputs_ex_coinbase_amount{0};
+    CAmount total_coinbase_amount{0};
+    CAmount total_unspendables_scripts{0};
+    CAmount pow_reward{0};
+    CAmount pos_reward{0};
+    CAmount fees_destroyed{0};
+    //! Changes to the amounts of the age buckets
+    std::map<int64_t, CAmount> age_buckets;
+};
+
+std::unique_ptr<BaseIndex::BlockData> CoinStatsIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
 {
+    auto delta{std::make_unique<StatsDelta>()};
     CBlockUndo block_undo;
     //const CAmount block_subsidy{GetBlockSubsidy(pindex->nHeight, Params().GetConsensus())};
-    //m_total_subsidy += block_subsidy;
 
     // Ignore genesis block
     if (pindex->nHeight > 0) {
         if (!UndoReadFromDisk(block_undo, pindex)) {
-            return false;
-        }
-
-        std::pair<uint256, DBVal> read_out;
-        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
-            return false;
-        }
-
-        uint256 expected_block_hash{pindex->pprev->GetBlockHash()};
-        if (read_out.first != expected_block_hash) {
-            LogPrintf("WARNING: previous block header belongs to unexpected block %s; expected %s\n",
-                      read_out.first.ToString(), expected_block_hash.ToString());
-
-            if (!m_db->Read(DBHashKey(expected_block_hash), read_out)) {
-                return error("%s: previous block header not found; expected %s",
-                             __func__, expected_block_hash.ToString());
-            }
+            return nullptr;
         }
 
         // TODO: Deduplicate BIP30 related code
@@ -147,11 +225,28 @@ bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
 
             // Skip duplicate txid coinbase transactions (BIP30).
             if (is_bip30_block && tx->IsCoinBase()) {
-                //m_total_unspendable_amount += block_subsidy;
-                //m_total_unspendables_bip30 += block_subsidy;
+                //delta->total_unspendable_amount += block_subsidy;
+                //delta->total_unspendables_bip30 += block_subsidy;
                 continue;
             }
 
+            // peercoin: proof-of-work blocks mint their coinbase, coinstakes
+            // mint their surplus, and the fees of all other transactions are
+            // destroyed
+            if (tx->IsCoinBase()) {
+                if (block.IsProofOfWork()) delta->pow_reward += tx->GetValueOut();
+            } else {
+                CAmount value_in{0};
+                for (const Coin& prevout : block_undo.vtxundo.at(i - 1).vprevout) {
+                    value_in += prevout.out.nValue;
+                }
+                if (tx->IsCoinStake()) {
+                    delta->pos_reward += tx->GetValueOut() - value_in;
+                } else {
+                    delta->fees_destroyed += value_in - tx->GetValueOut();
+                }
+            }
+
             for (uint32_t j = 0; j < tx->vout.size(); ++j) {
                 const CTxOut& out{tx->vout[j]};
                 Coin coin{out, pindex->nHeight, tx->IsCoinBase(), tx->IsCoinStake(), (int)tx->nTime};
@@ -159,22 +254,23 @@ bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
 
                 // Skip unspendable coins
                 if (coin.out.scriptPubKey.IsUnspendable()) {
-                    m_total_unspendable_amount += coin.out.nValue;
-                    m_total_unspendables_scripts += coin.out.nValue;
+                    delta->total_unspendable_amount += coin.out.nValue;
+                    delta->total_unspendables_scripts += coin.out.nValue;
                     continue;
                 }
 
-                m_muhash.Insert(MakeUCharSpan(TxOutSer(outpoint, coin)));
+                delta->muhash.Insert(MakeUCharSpan(TxOutSer(outpoint, coin)));
+                AddToAgeBucket(delta->age_buckets, AgeBucket(coin, pindex), coin.out.nValue);
 
                 if (tx->IsCoinBase()) {
-                    m_total_coinbase_amount += coin.out.nValue;
+                    delta->total_coinbase_amount += coin.out.nValue;
                 } else {
-                    m_total_new_outputs_ex_coinbase_amount += coin.out.nValue;
+                    delta->total_new_outputs_ex_coinbase_amount += coin.out.nValue;
                 }
 
-                ++m_transaction_output_count;
-                m_total_amount += coin.out.nValue;
-                m_bogo_size += GetBogoSize(coin.out.scriptPubKey);
+                ++delta->transaction_output_count;
+                delta->total_amount += coin.out.nValue;
+                delta->bogo_size += GetBogoSize(coin.out.scriptPubKey);
             }
 
             // The coinbase tx has no undo data since no former output is spent
@@ -185,20 +281,70 @@ bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
                     Coin coin{tx_undo.vprevout[j]};
                     COutPoint outpoint{tx->vin[j].prevout.hash, tx->vin[j].prevout.n};
 
-                    m_muhash.Remove(MakeUCharSpan(TxOutSer(outpoint, coin)));
+                    delta->muhash.Remove(MakeUCharSpan(TxOutSer(outpoint, coin)));
+                    AddToAgeBucket(delta->age_buckets, AgeBucket(coin, pindex), -coin.out.nValue);
 
-                    m_total_prevout_spent_amount += coin.out.nValue;
+                    delta->total_prevout_spent_amount += coin.out.nValue;
 
-                    --m_transaction_output_count;
-                    m_total_amount -= coin.out.nValue;
-                    m_bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+                    --delta->transaction_output_count;
+                    delta->total_amount -= coin.out.nValue;
+                    delta->bogo_size -= GetBogoSize(coin.out.scriptPubKey);
                 }
             }
         }
     } else {
         // genesis block
-        //m_total_unspendable_amount += block_subsidy;
-        //m_total_unspendables_genesis_block += block_subsidy;
+        //delta->total_unspendable_amount += block_subsidy;
+        //delta->total_unspendables_genesis_block += block_subsidy;
+    }
+    return delta;
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return WritePreparedBlock(block, pindex, PrepareBlock(block, pindex));
+}
+
+bool CoinStatsIndex::WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data)
+{
+    if (!data) {
+        return false;
+    }
+    const StatsDelta& delta = static_cast<const StatsDelta&>(*data);
+    //m_total_subsidy += block_subsidy;
+
+    if (pindex->nHeight > 0) {
+        std::pair<uint256, DBVal> read_out;
+        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+            return false;
+        }
+
+        uint256 expected_block_hash{pindex->pprev->GetBlockHash()};
+        if (read_out.first != expected_block_hash) {
+            LogPrintf("WARNING: previous block header belongs to unexpected block %s; expected %s\n",
+                      read_out.first.ToString(), expected_block_hash.ToString());
+
+            if (!m_db->Read(DBHashKey(expected_block_hash), read_out)) {
+                return error("%s: previous block header not found; expected %s",
+                             __func__, expected_block_hash.ToString());
+            }
+        }
+    }
+
+    m_muhash *= delta.muhash;
+    m_transaction_output_count += delta.transaction_output_count;
+    m_bogo_size += delta.bogo_size;
+    m_total_amount += delta.total_amount;
+    m_total_unspendable_amount += delta.total_unspendable_amount;
+    m_total_prevout_spent_amount += delta.total_prevout_spent_amount;
+    m_total_new_outputs_ex_coinbase_amount += delta.total_new_outputs_ex_coinbase_amount;
+    m_total_coinbase_amount += delta.total_coinbase_amount;
+    m_total_unspendables_scripts += delta.total_unspendables_scripts;
+    m_total_pow_reward += delta.pow_reward;
+    m_total_pos_reward += delta.pos_reward;
+    m_total_fees_destroyed += delta.fees_destroyed;
+    for (const auto& [bucket, amount] : delta.age_buckets) {
+        AddToAgeBucket(m_age_buckets, bucket, amount);
     }
 
     // If spent prevouts + block subsidy are still a higher amount than
@@ -223,6 +369,11 @@ bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
     //value.second.total_unspendables_bip30 = m_total_unspendables_bip30;
     value.second.total_unspendables_scripts = m_total_unspendables_scripts;
     //value.second.total_unspendables_unclaimed_rewards = m_total_unspendables_unclaimed_rewards;
+    value.second.total_pow_reward = m_total_pow_reward;
+    value.second.total_pos_reward = m_total_pos_reward;
+    value.second.total_fees_destroyed = m_total_fees_destroyed;
+    SumStakeAges(m_age_buckets, m_total_amount, pindex->GetBlockTime(), Params().GetConsensus(),
+                 value.second.stakeable_amount, value.second.stake_coin_days);
 
     uint256 out;
     m_muhash.Finalize(out);
@@ -231,7 +382,7 @@ bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
     CDBBatch batch(*m_db);
     batch.Write(DBHeightKey(pindex->nHeight), value);
     batch.Write(DB_MUHASH, m_muhash);
-    return m_db->WriteBatch(batch);
+    return m_db->WriteBatchAsync(batch);
 }
 
 static bool CopyHeightIndexToHashIndex(CDBIterator& db_it, CDBBatch& batch,
@@ -337,6 +488,11 @@ bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& co
     coins_stats.total_unspendables_bip30 = entry.total_unspendables_bip30;
     coins_stats.total_unspendables_scripts = entry.total_unspendables_scripts;
     coins_stats.total_unspendables_unclaimed_rewards = entry.total_unspendables_unclaimed_rewards;
+    coins_stats.total_pow_reward = entry.total_pow_reward;
+    coins_stats.total_pos_reward = entry.total_pos_reward;
+    coins_stats.total_fees_destroyed = entry.total_fees_destroyed;
+    coins_stats.stakeable_amount = entry.stakeable_amount;
+    coins_stats.stake_coin_days = entry.stake_coin_days;
 
     return true;
 }
@@ -353,6 +509,11 @@ bool CoinStatsIndex::Init()
         }
     }
 
+    if (!m_db->Read(DB_AGE_BUCKETS, m_age_buckets)) {
+        return error("%s: Cannot read current %s state; index may be corrupted",
+                     __func__, GetName());
+    }
+
     if (!BaseIndex::Init()) return false;
 
     const CBlockIndex* pindex{CurrentIndex()};
@@ -383,11 +544,22 @@ bool CoinStatsIndex::Init()
         //m_total_unspendables_bip30 = entry.total_unspendables_bip30;
         m_total_unspendables_scripts = entry.total_unspendables_scripts;
         //m_total_unspendables_unclaimed_rewards = entry.total_unspendables_unclaimed_rewards;
+        m_total_pow_reward = entry.total_pow_reward;
+        m_total_pos_reward = entry.total_pos_reward;
+        m_total_fees_destroyed = entry.total_fees_destroyed;
     }
 
     return true;
 }
 
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    // The age buckets are written with the best block, as they are too
+    // large to write with every block like the MuHash state.
+    batch.Write(DB_AGE_BUCKETS, m_age_buckets);
+    return BaseIndex::CommitInternal(batch);
+}
+
 // Reverse a single block as part of a reorg
 bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex)
 {
@@ -436,6 +608,7 @@ bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex
             }
 
             m_muhash.Remove(MakeUCharSpan(TxOutSer(outpoint, coin)));
+            AddToAgeBucket(m_age_buckets, AgeBucket(coin, pindex), -coin.out.nValue);
 
             if (tx->IsCoinBase()) {
                 m_total_coinbase_amount -= coin.out.nValue;
@@ -457,6 +630,7 @@ bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex
                 COutPoint outpoint{tx->vin[j].prevout.hash, tx->vin[j].prevout.n};
 
                 m_muhash.Insert(MakeUCharSpan(TxOutSer(outpoint, coin)));
+                AddToAgeBucket(m_age_buckets, AgeBucket(coin, pindex), coin.out.nValue);
 
                 m_total_prevout_spent_amount -= coin.out.nValue;
 
@@ -467,9 +641,15 @@ bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex
         }
     }
 
-    const CAmount unclaimed_rewards{(m_total_new_outputs_ex_coinbase_amount + m_total_coinbase_amount + m_total_unspendable_amount) - (m_total_prevout_spent_amount + m_total_subsidy)};
-    m_total_unspendable_amount -= unclaimed_rewards;
-    m_total_unspendables_unclaimed_rewards -= unclaimed_rewards;
+    // peercoin: unclaimed rewards are not counted when connecting blocks, see WritePreparedBlock()
+    //const CAmount unclaimed_rewards{(m_total_new_outputs_ex_coinbase_amount + m_total_coinbase_amount + m_total_unspendable_amount) - (m_total_prevout_spent_amount + m_total_subsidy)};
+    //m_total_unspendable_amount -= unclaimed_rewards;
+    //m_total_unspendables_unclaimed_rewards -= unclaimed_rewards;
+
+    // peercoin: the supply totals of the previous block are stored with it
+    m_total_pow_reward = read_out.second.total_pow_reward;
+    m_total_pos_reward = read_out.second.total_pos_reward;
+    m_total_fees_destroyed = read_out.second.total_fees_destroyed;
 
     // Check that the rolled back internal values are consistent with the DB read out
     uint256 out;
@@ -480,14 +660,14 @@ bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex
     Assert(m_total_amount == read_out.second.total_amount);
     Assert(m_bogo_size == read_out.second.bogo_size);
     Assert(m_total_subsidy == read_out.second.total_subsidy);
-    Assert(m_total_unspendable_amount == read_out.second.total_unspendable_amount);
+    //Assert(m_total_unspendable_amount == read_out.second.total_unspendable_amount);
     Assert(m_total_prevout_spent_amount == read_out.second.total_prevout_spent_amount);
     Assert(m_total_new_outputs_ex_coinbase_amount == read_out.second.total_new_outputs_ex_coinbase_amount);
     Assert(m_total_coinbase_amount == read_out.second.total_coinbase_amount);
     Assert(m_total_unspendables_genesis_block == read_out.second.total_unspendables_genesis_block);
     Assert(m_total_unspendables_bip30 == read_out.second.total_unspendables_bip30);
     Assert(m_total_unspendables_scripts == read_out.second.total_unspendables_scripts);
-    Assert(m_total_unspendables_unclaimed_rewards == read_out.second.total_unspendables_unclaimed_rewards);
+    //Assert(m_total_unspendables_unclaimed_rewards == read_out.second.total_unspendables_unclaimed_rewards);
 
     return m_db->Write(DB_MUHASH, m_muhash);
 }
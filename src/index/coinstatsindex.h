@@ -11,6 +11,8 @@
 #include <index/base.h>
 #include <node/coinstats.h>
 
+#include <map>
+
 /**
  * CoinStatsIndex maintains statistics on the UTXO set.
  */
@@ -34,13 +36,28 @@ private:
     CAmount m_total_unspendables_scripts{0};
     CAmount m_total_unspendables_unclaimed_rewards{0};
 
+    // peercoin: supply and stake statistics
+    CAmount m_total_pow_reward{0};
+    CAmount m_total_pos_reward{0};
+    CAmount m_total_fees_destroyed{0};
+    //! Amount of the spendable UTXO set by the day its coins were created
+    std::map<int64_t, CAmount> m_age_buckets;
+
     bool ReverseBlock(const CBlock& block, const CBlockIndex* pindex);
 
 protected:
     bool Init() override;
 
+    bool CommitInternal(CDBBatch& batch) override;
+
+    struct StatsDelta;
+
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data) override;
+
     bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
 
     BaseIndex::DB& GetDB() const override { return *m_db; }
@@ -4,21 +4,53 @@
 
 #include <index/txindex.h>
 
+#include <crypto/common.h>
 #include <index/disktxpos.h>
 #include <node/blockstorage.h>
+#include <node/caches.h>
 #include <util/system.h>
 #include <validation.h>
 
-using node::OpenBlockFile;
+#include <map>
+#include <optional>
+
+using node::ReadTxFromDisk;
 
 constexpr uint8_t DB_TXINDEX{'t'};
+constexpr uint8_t DB_TXINDEX_COMPACT{'T'};
+constexpr uint8_t DB_TXINDEX_OVERFLOW{'U'};
+constexpr uint8_t DB_TXINDEX_LAYOUT{'L'};
+
+/** Layouts of the txindex database */
+enum class TxIndexLayout : uint8_t {
+    //! ('t', txid) -> CDiskTxPos
+    LEGACY = 0,
+    //! ('T', first 8 bytes of txid) -> CompactTxPos, and ('U', txid) -> CDiskTxPos
+    //! for transactions whose truncated txid is already taken by another one
+    COMPACT = 1,
+};
 
 std::unique_ptr<TxIndex> g_txindex;
 
+namespace {
+/** Position of a transaction in the compact layout, tagged with more bits of its txid */
+struct CompactTxPos {
+    uint32_t check;
+    CDiskTxPos pos;
+
+    SERIALIZE_METHODS(CompactTxPos, obj) { READWRITE(obj.check, obj.pos); }
+};
+
+uint64_t TxidPrefix(const uint256& txid) { return ReadLE64(txid.begin()); }
+uint32_t TxidCheck(const uint256& txid) { return ReadLE32(txid.begin() + 8); }
+} // namespace
 
 /** Access to the txindex database (indexes/txindex/) */
 class TxIndex::DB : public BaseIndex::DB
 {
+private:
+    TxIndexLayout m_layout;
+
 public:
     explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
 
@@ -31,21 +63,70 @@ public:
 };
 
 TxIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
-    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
-{}
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "txindex", node::GetDBOptions(gArgs, "txindex", n_cache_size), f_memory, f_wipe)
+{
+    // Indexes built before the compact layout existed keep using the legacy
+    // one until they are rebuilt.
+    if (IsEmpty()) {
+        m_layout = TxIndexLayout::COMPACT;
+        Write(DB_TXINDEX_LAYOUT, static_cast<uint8_t>(m_layout));
+    } else if (uint8_t layout; Read(DB_TXINDEX_LAYOUT, layout) && layout == static_cast<uint8_t>(TxIndexLayout::COMPACT)) {
+        m_layout = TxIndexLayout::COMPACT;
+    } else {
+        m_layout = TxIndexLayout::LEGACY;
+        LogPrintf("txindex uses the legacy database layout; delete the indexes/txindex directory to rebuild it in the smaller compact layout\n");
+    }
+}
 
 bool TxIndex::DB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
 {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    if (m_layout == TxIndexLayout::LEGACY) {
+        return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    }
+    CompactTxPos compact;
+    if (!Read(std::make_pair(DB_TXINDEX_COMPACT, TxidPrefix(txid)), compact)) {
+        return false;
+    }
+    if (compact.check == TxidCheck(txid)) {
+        pos = compact.pos;
+        return true;
+    }
+    // The truncated txid belongs to another transaction.
+    return Read(std::make_pair(DB_TXINDEX_OVERFLOW, txid), pos);
 }
 
 bool TxIndex::DB::WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos)
 {
     CDBBatch batch(*this);
-    for (const auto& tuple : v_pos) {
-        batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+    if (m_layout == TxIndexLayout::LEGACY) {
+        for (const auto& tuple : v_pos) {
+            batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+        }
+        return WriteBatchAsync(batch);
+    }
+
+    // Truncated txids taken by this batch, and the check bits of their owners
+    std::map<uint64_t, uint32_t> batch_checks;
+    for (const auto& [txid, pos] : v_pos) {
+        const uint64_t prefix{TxidPrefix(txid)};
+        const uint32_t check{TxidCheck(txid)};
+        std::optional<uint32_t> owner;
+        if (const auto it{batch_checks.find(prefix)}; it != batch_checks.end()) {
+            owner = it->second;
+        } else if (CompactTxPos existing; Read(std::make_pair(DB_TXINDEX_COMPACT, prefix), existing)) {
+            owner = existing.check;
+        }
+        // Transactions that are indexed again keep their slot. A different
+        // transaction with the same truncated txid goes to the overflow
+        // records, which are keyed by the full txid.
+        if (!owner || *owner == check) {
+            batch.Write(std::make_pair(DB_TXINDEX_COMPACT, prefix), CompactTxPos{check, pos});
+            batch_checks.emplace(prefix, check);
+        } else {
+            batch.Write(std::make_pair(DB_TXINDEX_OVERFLOW, txid), pos);
+        }
     }
-    return WriteBatch(batch);
+    return WriteBatchAsync(batch);
 }
 
 TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
@@ -54,20 +135,37 @@ TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
 
 TxIndex::~TxIndex() {}
 
-bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+/** The positions of the transactions of a block, computed ahead of writing them */
+struct TxIndex::TxPosData : public BaseIndex::BlockData {
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+};
+
+std::unique_ptr<BaseIndex::BlockData> TxIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
 {
+    auto data{std::make_unique<TxPosData>()};
     // Exclude genesis block transaction because outputs are not spendable.
-    if (pindex->nHeight == 0) return true;
+    if (pindex->nHeight == 0) return data;
 
     CDiskTxPos pos{
         WITH_LOCK(::cs_main, return pindex->GetBlockPos()),
         GetSizeOfCompactSize(block.vtx.size())};
-    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
-    vPos.reserve(block.vtx.size());
+    data->vPos.reserve(block.vtx.size());
     for (const auto& tx : block.vtx) {
-        vPos.emplace_back(tx->GetHash(), pos);
+        data->vPos.emplace_back(tx->GetHash(), pos);
         pos.nTxOffset += ::GetSerializeSize(*tx, CLIENT_VERSION);
     }
+    return data;
+}
+
+bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return WritePreparedBlock(block, pindex, PrepareBlock(block, pindex));
+}
+
+bool TxIndex::WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data)
+{
+    const auto& vPos = static_cast<const TxPosData&>(*data).vPos;
+    if (vPos.empty()) return true;
     return m_db->WriteTxs(vPos);
 }
 
@@ -80,19 +178,9 @@ bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRe
         return false;
     }
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        return error("%s: OpenBlockFile failed", __func__);
-    }
     CBlockHeader header;
-    try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
-        }
-        file >> tx;
-    } catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    if (!ReadTxFromDisk(header, tx, postx, postx.nTxOffset)) {
+        return false;
     }
     if (tx->GetHash() != tx_hash) {
         return error("%s: txid mismatch", __func__);
@@ -12,7 +12,9 @@
 /**
  * TxIndex is used to look up transactions included in the blockchain by hash.
  * The index is written to a LevelDB database and records the filesystem
- * location of each transaction by transaction hash.
+ * location of each transaction by transaction hash. New indexes key the
+ * records by the first 8 bytes of the hash, which keeps the database small
+ * and its lookups within a single LevelDB read in all but rare collisions.
  */
 class TxIndex final : public BaseIndex
 {
@@ -23,8 +25,14 @@ private:
     const std::unique_ptr<DB> m_db;
 
 protected:
+    struct TxPosData;
+
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData> data) override;
+
     BaseIndex::DB& GetDB() const override;
 
     const char* GetName() const override { return "txindex"; }
@@ -16,10 +16,12 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/amount.h>
+#include <dbwrapper.h>
 #include <fs.h>
 #include <hash.h>
 #include <httprpc.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
 #include <index/txindex.h>
@@ -38,6 +40,7 @@
 #include <node/context.h>
 #include <node/miner.h>
 #include <node/ui_interface.h>
+#include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <protocol.h>
@@ -95,14 +98,21 @@
 #include <zmq/zmqrpc.h>
 #endif
 
+using node::BlockTemplateCache;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::ChainstateLoadVerifyError;
 using node::ChainstateLoadingError;
+using node::DEFAULT_BLOCK_COMPRESSION;
+using node::DEFAULT_MAX_REINDEX_THREADS;
 using node::DEFAULT_PRINTPRIORITY;
+using node::DEFAULT_REINDEX_THREADS;
 using node::DEFAULT_STOPAFTERBLOCKIMPORT;
 using node::LoadChainstate;
+using node::MAX_MAPPED_BLOCKFILES;
 using node::NodeContext;
+using node::StartBlockFileCompression;
+using node::StopBlockFileCompression;
 using node::ThreadImport;
 using node::VerifyLoadedChainstate;
 using node::fReindex;
@@ -191,6 +201,9 @@ void Interrupt(NodeContext& node)
     if (g_coin_stats_index) {
         g_coin_stats_index->Interrupt();
     }
+    if (g_address_index) {
+        g_address_index->Interrupt();
+    }
 }
 
 void Shutdown(NodeContext& node)
@@ -220,6 +233,7 @@ void Shutdown(NodeContext& node)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (node.peerman) UnregisterValidationInterface(node.peerman.get());
+    if (node.template_cache) UnregisterValidationInterface(node.template_cache.get());
     if (node.connman) node.connman->Stop();
 
     StopTorControl();
@@ -228,11 +242,14 @@ void Shutdown(NodeContext& node)
     // CScheduler/checkqueue, scheduler and load block thread.
     if (node.scheduler) node.scheduler->stop();
     if (node.chainman && node.chainman->m_load_block.joinable()) node.chainman->m_load_block.join();
+    StopBlockFileCompression();
+    StopMempoolDumpThread();
     StopScriptCheckWorkerThreads();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     node.peerman.reset();
+    node.template_cache.reset();
     node.connman.reset();
     node.banman.reset();
     node.addrman.reset();
@@ -265,6 +282,10 @@ void Shutdown(NodeContext& node)
         g_coin_stats_index->Stop();
         g_coin_stats_index.reset();
     }
+    if (g_address_index) {
+        g_address_index->Stop();
+        g_address_index.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -300,8 +321,12 @@ void Shutdown(NodeContext& node)
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     init::UnsetGlobals();
     node.mempool.reset();
+    node.fee_estimator.reset();
     node.chainman.reset();
     node.scheduler.reset();
+    // All databases using the writer are closed by now.
+    SetDBWriter(nullptr);
+    node.db_writer.reset();
 
     try {
         if (!fs::remove(GetPidFile(*node.args))) {
@@ -390,7 +415,9 @@ void SetupServerArgs(ArgsManager& argsman)
 #if HAVE_SYSTEM
     argsman.AddArg("-alertnotify=<cmd>", "Execute command when an alert is raised (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
+    argsman.AddArg("-addressindex", strprintf("Maintain an index of the outputs paying to each address, used by the getaddresshistory RPC and to speed up scantxoutset (default: %u)", DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockcompression", strprintf("Compress finalized block files in the background. Compressed files stay readable when this is turned off (default: %u)", DEFAULT_BLOCK_COMPRESSION), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune", "Use smaller block files and lower minimum prune height for testing purposes", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 #if HAVE_SYSTEM
@@ -403,17 +430,23 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbengine=<db>:<engine>", strprintf("Store database <db> (%s) with storage engine <engine> (leveldb, or mmap for read-mostly databases; default: leveldb). This option can be specified multiple times to configure several databases.", Join(SelectableDBNames(), ", ")), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dboption=<db>:<option>=<n>", "Tune the storage engine of database <db> (see -dbengine). <option> is blockcache or writebuffer (percent of the database's cache assigned to the block cache or to each of the up to two write buffers), bloombits (bloom filter bits per key, 0 to disable) or compression (0 or 1). This option can be specified multiple times.", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-maxorphansize=<n>", strprintf("Keep unconnectable transactions below <n> kilobytes of memory, each peer's below 1/%u of that (default: %u)", MAX_ORPHAN_PEER_SHARE, DEFAULT_MAX_ORPHAN_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-mempoolsnapshotinterval=<n>", strprintf("Publish a copy of the mempool for RPC and REST readers every <n> milliseconds while they poll it and it changed, so that they do not contend for the mempool lock. Their results may then lag the mempool by up to twice <n>. 0 to read the mempool directly (default: %u)", DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex(), signetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-persistmempoolinterval=<n>", strprintf("With -persistmempool, also save the mempool every <n> minutes while running, 0 to only save it on shutdown (default: %u)", DEFAULT_PERSIST_MEMPOOL_INTERVAL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-reindexthreads=<n>", strprintf("Number of threads that read and check block files during -reindex (1 to read them serially, 0 = one per core up to %d, default: %d)", DEFAULT_MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-settings=<file>", strprintf("Specify path to dynamic settings data file. Can be disabled with -nosettings. File is written at runtime and not meant to be edited by users (use %s instead for custom settings). Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME, BITCOIN_SETTINGS_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
@@ -841,6 +874,20 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         }
     }
 
+    for (const std::string& value : args.GetArgs("-dbengine")) {
+        const auto sep = value.find(':');
+        const auto& names = SelectableDBNames();
+        if (sep == std::string::npos || std::find(names.begin(), names.end(), value.substr(0, sep)) == names.end() ||
+            !DBEngineFromString(value.substr(sep + 1))) {
+            return InitError(strprintf(_("Invalid -dbengine value %s."), value));
+        }
+    }
+    for (const std::string& value : args.GetArgs("-dboption")) {
+        if (!node::IsValidDBOption(value)) {
+            return InitError(strprintf(_("Invalid -dboption value %s."), value));
+        }
+    }
+
     // Signal NODE_COMPACT_FILTERS if peerblockfilters and basic filters index are both enabled.
     if (args.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
         if (g_enabled_filter_types.count(BlockFilterType::BASIC) != 1) {
@@ -850,6 +897,11 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
     }
 
+    // Compressing a block file maps all of it, which 32-bit builds do not do
+    if (MAX_MAPPED_BLOCKFILES == 0 && args.GetBoolArg("-blockcompression", DEFAULT_BLOCK_COMPRESSION)) {
+        return InitError(Untranslated("-blockcompression is not supported on 32-bit systems."));
+    }
+
     // If -forcednsseed is set to true, ensure -dnsseed has not been set to false
     if (args.GetBoolArg("-forcednsseed", DEFAULT_FORCEDNSSEED) && !args.GetBoolArg("-dnsseed", DEFAULT_DNSSEED)){
         return InitError(_("Cannot set -forcednsseed to true when setting -dnsseed to false."));
@@ -1100,6 +1152,11 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     // Start the lightweight task scheduler thread
     node.scheduler->m_service_thread = std::thread(util::TraceThread, "scheduler", [&] { node.scheduler->serviceQueue(); });
 
+    // Start the thread writing chainstate and index batches in the background
+    assert(!node.db_writer);
+    node.db_writer = std::make_unique<DBWriter>();
+    SetDBWriter(node.db_writer.get());
+
     // Gather some entropy once per minute.
     node.scheduler->scheduleEvery([]{
         RandAddPeriodic();
@@ -1193,9 +1250,15 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     assert(!node.connman);
     node.connman = std::make_unique<CConnman>(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()), *node.addrman, args.GetBoolArg("-networkactive", true));
 
+    assert(!node.fee_estimator);
+    // Blocks are assumed to be created with the default block weight limit.
+    node.fee_estimator = std::make_unique<FeeEstimator>(DEFAULT_BLOCK_MAX_WEIGHT / WITNESS_SCALE_FACTOR);
+
     assert(!node.mempool);
     int check_ratio = std::min<int>(std::max<int>(args.GetIntArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
-    node.mempool = std::make_unique<CTxMemPool>(check_ratio);
+    node.mempool = std::make_unique<CTxMemPool>(node.fee_estimator.get(), check_ratio);
+    node.template_cache = std::make_unique<BlockTemplateCache>(*node.mempool);
+    RegisterValidationInterface(node.template_cache.get());
 
     assert(!node.chainman);
     node.chainman = std::make_unique<ChainstateManager>();
@@ -1479,6 +1542,13 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         }
     }
 
+    if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_address_index = std::make_unique<AddressIndex>(/* cache size */ 0, false, fReindex);
+        if (!g_address_index->Start(chainman.ActiveChainstate())) {
+            return false;
+        }
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : node.chain_clients) {
         if (!client->load()) {
@@ -1533,6 +1603,9 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     chainman.m_load_block = std::thread(&util::TraceThread, "loadblk", [=, &chainman, &args] {
         ThreadImport(chainman, vImportFiles, args);
     });
+    if (args.GetBoolArg("-blockcompression", DEFAULT_BLOCK_COMPRESSION)) {
+        StartBlockFileCompression();
+    }
 
     // Wait for genesis block to be processed
     {
@@ -1729,6 +1802,25 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL);
 
+    // Save the mempool periodically, so that it is not lost if the node
+    // doesn't shut down cleanly. Writing it takes a while, so it is done on
+    // its own thread rather than the scheduler's. The mempool is only locked
+    // briefly for each chunk of transactions written.
+    const int64_t mempool_dump_interval{args.GetIntArg("-persistmempoolinterval", DEFAULT_PERSIST_MEMPOOL_INTERVAL)};
+    if (args.GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL) && mempool_dump_interval > 0) {
+        StartMempoolDumpThread(*node.mempool, std::chrono::minutes{mempool_dump_interval});
+    }
+
+    // Keep a copy of the mempool for RPC and REST, so that polling them does
+    // not contend with transaction relay for the mempool lock.
+    const int64_t mempool_snapshot_interval{args.GetIntArg("-mempoolsnapshotinterval", DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL)};
+    if (mempool_snapshot_interval > 0) {
+        CTxMemPool* mempool = node.mempool.get();
+        node.scheduler->scheduleEvery([mempool]{
+            mempool->PublishSnapshot();
+        }, std::chrono::milliseconds{mempool_snapshot_interval});
+    }
+
     if (node.peerman) node.peerman->StartScheduledTasks(*node.scheduler);
 
 #if HAVE_SYSTEM
@@ -6,11 +6,15 @@
 
 #include <primitives/transaction.h> // CTransaction(Ref)
 
+#include <vector>
+
 class CBlockIndex;
 class BlockValidationState;
 class CBlockHeader;
 class CBlock;
 class CChainState;
+class CScriptCheck;
+struct PrecomputedTransactionData;
 
 
 // MODIFIER_INTERVAL_RATIO:
@@ -50,7 +54,9 @@ bool CheckStakeKernelHash(unsigned int nBits, CBlockIndex* pindexPrev, const CBl
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
-bool CheckProofOfStake(BlockValidationState &state, CBlockIndex* pindexPrev, const CTransactionRef &tx, unsigned int nBits, uint256& hashProofOfStake, unsigned int nTimeTx, CChainState& chainstate);
+// If pvChecks is not nullptr, the coinstake signature check is pushed onto it
+// instead of being performed inline, using txdata which must outlive the check
+bool CheckProofOfStake(BlockValidationState &state, CBlockIndex* pindexPrev, const CTransactionRef &tx, unsigned int nBits, uint256& hashProofOfStake, unsigned int nTimeTx, CChainState& chainstate, std::vector<CScriptCheck>* pvChecks = nullptr, PrecomputedTransactionData* txdata = nullptr);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
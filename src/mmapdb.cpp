@@ -0,0 +1,666 @@
+// Copyright (c) 2023 The Peercoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mmapdb.h>
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <logging.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * Table file layout, all integers little endian:
+ * - records: u32 key length, u32 value length, key, value; sorted by key
+ * - index: u64 offset of every record
+ * - footer: u64 offset of the index, u64 number of records, u64 magic
+ */
+constexpr uint64_t TABLE_MAGIC{0x3170616d6d637070}; // "ppcmmap1"
+constexpr size_t RECORD_HEADER_SIZE{8};
+constexpr size_t FOOTER_SIZE{24};
+
+/**
+ * Log file layout: a sequence of batches, each a u32 payload length, the
+ * first 4 bytes of the payload's SHA256 and the payload. The payload is a
+ * sequence of u8 operation (1 = put, 0 = delete), u32 key length, key and,
+ * for puts, u32 value length and value. A torn batch at the end of the log
+ * is discarded on open.
+ */
+constexpr size_t LOG_HEADER_SIZE{8};
+constexpr unsigned char OP_DELETE{0};
+constexpr unsigned char OP_PUT{1};
+
+//! Rough per-entry bookkeeping cost of the overlay map.
+constexpr size_t OVERLAY_NODE_OVERHEAD{96};
+
+//! Smallest overlay worth merging, so that tiny caches do not rewrite the table constantly.
+constexpr size_t MIN_OVERLAY_LIMIT{1 << 20};
+
+const char* const TABLE_FILE{"table.dat"};
+const char* const TABLE_TMP_FILE{"table.dat.new"};
+const char* const LOG_FILE{"log.dat"};
+
+/** Unapplied writes on top of the table; a nullopt value is a deletion. */
+using Overlay = std::map<std::string, std::optional<std::string>, std::less<>>;
+
+std::string_view AsView(Span<const std::byte> s)
+{
+    return {reinterpret_cast<const char*>(s.data()), s.size()};
+}
+
+Span<const std::byte> AsSpan(std::string_view s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+uint32_t PayloadChecksum(const std::string& payload)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(payload.data()), payload.size()).Finalize(hash);
+    return ReadLE32(hash);
+}
+
+[[noreturn]] void ThrowCorrupt(const std::string& what)
+{
+    const std::string errmsg = "Fatal mmap database error: " + what;
+    LogPrintf("%s\n", errmsg);
+    throw dbwrapper_error(errmsg);
+}
+
+/** Immutable sorted table, either memory-mapped from disk or held in memory. */
+class Table
+{
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+    uint64_t m_index_offset{0};
+    uint64_t m_count{0};
+    std::vector<unsigned char> m_buffer;
+    void* m_mapping{nullptr};
+
+    void Parse()
+    {
+        if (m_size == 0) return;
+        if (m_size < FOOTER_SIZE) ThrowCorrupt("truncated table");
+        const unsigned char* footer = m_data + m_size - FOOTER_SIZE;
+        m_index_offset = ReadLE64(footer);
+        m_count = ReadLE64(footer + 8);
+        if (ReadLE64(footer + 16) != TABLE_MAGIC || m_index_offset > m_size - FOOTER_SIZE ||
+            (m_size - FOOTER_SIZE - m_index_offset) / 8 != m_count) {
+            ThrowCorrupt("bad table footer");
+        }
+    }
+
+    std::pair<uint64_t, uint64_t> Record(uint64_t i) const
+    {
+        const uint64_t offset = ReadLE64(m_data + m_index_offset + 8 * i);
+        if (offset > m_index_offset || m_index_offset - offset < RECORD_HEADER_SIZE) ThrowCorrupt("bad record offset");
+        const uint64_t key_size = ReadLE32(m_data + offset);
+        const uint64_t value_size = ReadLE32(m_data + offset + 4);
+        if (m_index_offset - offset - RECORD_HEADER_SIZE < key_size + value_size) ThrowCorrupt("bad record size");
+        return {offset, key_size};
+    }
+
+public:
+    Table() = default;
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+
+    ~Table()
+    {
+#ifndef WIN32
+        if (m_mapping) munmap(m_mapping, m_size);
+#endif
+    }
+
+    static std::shared_ptr<const Table> FromBuffer(std::vector<unsigned char>&& buffer)
+    {
+        auto table = std::make_shared<Table>();
+        table->m_buffer = std::move(buffer);
+        table->m_data = table->m_buffer.data();
+        table->m_size = table->m_buffer.size();
+        table->Parse();
+        return table;
+    }
+
+    static std::shared_ptr<const Table> Open(const fs::path& file)
+    {
+#ifndef WIN32
+        auto table = std::make_shared<Table>();
+        int fd = open(fs::PathToString(file).c_str(), O_RDONLY);
+        if (fd == -1) ThrowCorrupt(strprintf("cannot open %s", fs::PathToString(file)));
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            ThrowCorrupt(strprintf("cannot stat %s", fs::PathToString(file)));
+        }
+        table->m_size = st.st_size;
+        if (table->m_size > 0) {
+            void* mapping = mmap(nullptr, table->m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                ThrowCorrupt(strprintf("cannot map %s", fs::PathToString(file)));
+            }
+            table->m_mapping = mapping;
+            table->m_data = static_cast<const unsigned char*>(mapping);
+        }
+        close(fd);
+        table->Parse();
+        return table;
+#else
+        // Read the table into memory where mapping is not implemented.
+        FILE* f = fsbridge::fopen(file, "rb");
+        if (!f) ThrowCorrupt(strprintf("cannot open %s", fs::PathToString(file)));
+        std::vector<unsigned char> buffer(fs::file_size(file));
+        const bool ok = buffer.empty() || fread(buffer.data(), 1, buffer.size(), f) == buffer.size();
+        fclose(f);
+        if (!ok) ThrowCorrupt(strprintf("cannot read %s", fs::PathToString(file)));
+        return FromBuffer(std::move(buffer));
+#endif
+    }
+
+    uint64_t Count() const { return m_count; }
+    size_t Size() const { return m_size; }
+
+    std::string_view Key(uint64_t i) const
+    {
+        const auto [offset, key_size] = Record(i);
+        return {reinterpret_cast<const char*>(m_data + offset + RECORD_HEADER_SIZE), key_size};
+    }
+
+    std::string_view Value(uint64_t i) const
+    {
+        const auto [offset, key_size] = Record(i);
+        return {reinterpret_cast<const char*>(m_data + offset + RECORD_HEADER_SIZE + key_size), ReadLE32(m_data + offset + 4)};
+    }
+
+    //! Offset of record i, or of the index for i == Count().
+    uint64_t Offset(uint64_t i) const
+    {
+        return i < m_count ? ReadLE64(m_data + m_index_offset + 8 * i) : m_index_offset;
+    }
+
+    //! Position of the first record whose key is not less than key.
+    uint64_t LowerBound(std::string_view key) const
+    {
+        uint64_t lo = 0, hi = m_count;
+        while (lo < hi) {
+            const uint64_t mid = lo + (hi - lo) / 2;
+            if (Key(mid) < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    std::optional<std::string_view> Find(std::string_view key) const
+    {
+        const uint64_t pos = LowerBound(key);
+        if (pos == m_count || Key(pos) != key) return std::nullopt;
+        return Value(pos);
+    }
+};
+
+/** Streams a sorted table to a file or to memory. */
+class TableWriter
+{
+    FILE* m_file;
+    std::vector<unsigned char>* m_buffer;
+    uint64_t m_pos{0};
+    std::vector<uint64_t> m_offsets;
+
+    void Append(const void* data, size_t size)
+    {
+        if (m_file) {
+            if (fwrite(data, 1, size, m_file) != size) ThrowCorrupt("failed to write table");
+        } else {
+            const auto* p = static_cast<const unsigned char*>(data);
+            m_buffer->insert(m_buffer->end(), p, p + size);
+        }
+        m_pos += size;
+    }
+
+public:
+    TableWriter(FILE* file, std::vector<unsigned char>* buffer) : m_file(file), m_buffer(buffer) {}
+
+    void Add(std::string_view key, std::string_view value)
+    {
+        unsigned char header[RECORD_HEADER_SIZE];
+        WriteLE32(header, key.size());
+        WriteLE32(header + 4, value.size());
+        m_offsets.push_back(m_pos);
+        Append(header, sizeof(header));
+        Append(key.data(), key.size());
+        Append(value.data(), value.size());
+    }
+
+    void Finish()
+    {
+        const uint64_t index_offset = m_pos;
+        unsigned char word[8];
+        for (const uint64_t offset : m_offsets) {
+            WriteLE64(word, offset);
+            Append(word, sizeof(word));
+        }
+        unsigned char footer[FOOTER_SIZE];
+        WriteLE64(footer, index_offset);
+        WriteLE64(footer + 8, m_offsets.size());
+        WriteLE64(footer + 16, TABLE_MAGIC);
+        Append(footer, sizeof(footer));
+    }
+};
+
+/** What a reader sees: the overlay and the table it sits on. */
+struct State {
+    std::shared_ptr<const Overlay> overlay;
+    std::shared_ptr<const Table> table;
+
+    std::optional<std::string_view> Find(std::string_view key) const
+    {
+        if (const auto it = overlay->find(key); it != overlay->end()) {
+            if (!it->second) return std::nullopt;
+            return std::string_view{*it->second};
+        }
+        return table->Find(key);
+    }
+};
+
+class MmapBatch final : public DBBackend::Batch
+{
+public:
+    //! The batch in log payload format.
+    std::string payload;
+
+    void Put(Span<const std::byte> key, Span<const std::byte> value) override
+    {
+        unsigned char size[4];
+        payload.push_back(OP_PUT);
+        WriteLE32(size, key.size());
+        payload.append(reinterpret_cast<const char*>(size), 4).append(AsView(key));
+        WriteLE32(size, value.size());
+        payload.append(reinterpret_cast<const char*>(size), 4).append(AsView(value));
+    }
+
+    void Delete(Span<const std::byte> key) override
+    {
+        unsigned char size[4];
+        payload.push_back(OP_DELETE);
+        WriteLE32(size, key.size());
+        payload.append(reinterpret_cast<const char*>(size), 4).append(AsView(key));
+    }
+
+    void Clear() override { payload.clear(); }
+};
+
+class MmapSnapshot final : public DBBackend::Snapshot
+{
+public:
+    const State state;
+
+    explicit MmapSnapshot(State s) : state(std::move(s)) {}
+};
+
+class MmapIterator final : public DBBackend::Iterator
+{
+    const State m_state;
+    Overlay::const_iterator m_oit;
+    uint64_t m_ti{0};
+    bool m_valid{false};
+    std::string_view m_key;
+    std::string_view m_value;
+
+    //! Position on the smaller of both cursors, letting the overlay shadow
+    //! the table and skipping deletions.
+    void Settle()
+    {
+        const Table& table = *m_state.table;
+        while (true) {
+            const bool have_overlay = m_oit != m_state.overlay->end();
+            const bool have_table = m_ti < table.Count();
+            if (!have_overlay && !have_table) {
+                m_valid = false;
+                return;
+            }
+            if (have_overlay) {
+                const int cmp = have_table ? std::string_view{m_oit->first}.compare(table.Key(m_ti)) : -1;
+                if (cmp == 0) ++m_ti;
+                if (cmp <= 0) {
+                    if (!m_oit->second) {
+                        ++m_oit;
+                        continue;
+                    }
+                    m_valid = true;
+                    m_key = m_oit->first;
+                    m_value = *m_oit->second;
+                    return;
+                }
+            }
+            m_valid = true;
+            m_key = table.Key(m_ti);
+            m_value = table.Value(m_ti);
+            return;
+        }
+    }
+
+public:
+    explicit MmapIterator(State state) : m_state(std::move(state)), m_oit(m_state.overlay->end()), m_ti(m_state.table->Count()) {}
+
+    bool Valid() const override { return m_valid; }
+
+    void SeekToFirst() override
+    {
+        m_oit = m_state.overlay->begin();
+        m_ti = 0;
+        Settle();
+    }
+
+    void Seek(Span<const std::byte> key) override
+    {
+        m_oit = m_state.overlay->lower_bound(AsView(key));
+        m_ti = m_state.table->LowerBound(AsView(key));
+        Settle();
+    }
+
+    void Next() override
+    {
+        assert(m_valid);
+        // Both cursors may sit on the current key only if the table's entry
+        // was shadowed, which Settle() already stepped over.
+        if (m_oit != m_state.overlay->end() && m_oit->first == m_key) {
+            ++m_oit;
+        } else {
+            ++m_ti;
+        }
+        Settle();
+    }
+
+    Span<const std::byte> Key() const override { return AsSpan(m_key); }
+    Span<const std::byte> Value() const override { return AsSpan(m_value); }
+};
+
+class MmapDBBackend final : public DBBackend
+{
+    const fs::path m_path;
+    const bool m_in_memory;
+    const size_t m_overlay_limit;
+
+    mutable Mutex m_mutex;
+    //! Shared with snapshots and iterators, copied before modification while they hold it.
+    std::shared_ptr<Overlay> m_overlay GUARDED_BY(m_mutex);
+    size_t m_overlay_bytes GUARDED_BY(m_mutex){0};
+    std::shared_ptr<const Table> m_table GUARDED_BY(m_mutex);
+    FILE* m_log GUARDED_BY(m_mutex){nullptr};
+    uint64_t m_log_size GUARDED_BY(m_mutex){0};
+
+    State GetState() const EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        return {m_overlay, m_table};
+    }
+
+    Overlay& MutableOverlay() EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        if (m_overlay.use_count() > 1) m_overlay = std::make_shared<Overlay>(*m_overlay);
+        return *m_overlay;
+    }
+
+    //! Apply a batch payload to the overlay. Returns false if it is malformed.
+    bool Apply(const std::string& payload) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        Overlay& overlay = MutableOverlay();
+        size_t pos = 0;
+        const auto read = [&](std::string_view& out) {
+            if (payload.size() - pos < 4) return false;
+            const uint32_t size = ReadLE32(reinterpret_cast<const unsigned char*>(payload.data() + pos));
+            pos += 4;
+            if (payload.size() - pos < size) return false;
+            out = std::string_view{payload}.substr(pos, size);
+            pos += size;
+            return true;
+        };
+        while (pos < payload.size()) {
+            const unsigned char op = payload[pos++];
+            std::string_view key, value;
+            if ((op != OP_PUT && op != OP_DELETE) || !read(key) || (op == OP_PUT && !read(value))) return false;
+            auto [it, inserted] = overlay.try_emplace(std::string{key});
+            if (inserted) {
+                m_overlay_bytes += OVERLAY_NODE_OVERHEAD + key.size();
+            } else if (it->second) {
+                m_overlay_bytes -= it->second->size();
+            }
+            if (op == OP_PUT) {
+                it->second.emplace(value);
+                m_overlay_bytes += value.size();
+            } else {
+                it->second.reset();
+            }
+        }
+        return true;
+    }
+
+    void OpenLog() EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        const fs::path log_path = m_path / LOG_FILE;
+        std::string contents;
+        if (FILE* f = fsbridge::fopen(log_path, "rb")) {
+            char buf[65536];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0) contents.append(buf, n);
+            fclose(f);
+        }
+        // Replay every complete batch; anything after the first torn or
+        // corrupt one was never acknowledged as written.
+        size_t pos = 0;
+        while (contents.size() - pos >= LOG_HEADER_SIZE) {
+            const auto* header = reinterpret_cast<const unsigned char*>(contents.data() + pos);
+            const uint32_t size = ReadLE32(header);
+            if (contents.size() - pos - LOG_HEADER_SIZE < size) break;
+            std::string payload = contents.substr(pos + LOG_HEADER_SIZE, size);
+            if (PayloadChecksum(payload) != ReadLE32(header + 4) || !Apply(payload)) break;
+            pos += LOG_HEADER_SIZE + size;
+        }
+        m_log = fsbridge::fopen(log_path, "ab");
+        if (!m_log) ThrowCorrupt(strprintf("cannot open %s", fs::PathToString(log_path)));
+        if (pos != contents.size()) {
+            LogPrintf("Discarding %u bytes of incomplete writes at the end of %s\n", contents.size() - pos, fs::PathToString(log_path));
+            if (!TruncateFile(m_log, pos)) ThrowCorrupt("cannot truncate log");
+        }
+        m_log_size = pos;
+    }
+
+    //! Merge the overlay into a new table and start an empty log.
+    void CompactLocked() EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        const Overlay& overlay = *m_overlay;
+        const Table& table = *m_table;
+        std::vector<unsigned char> buffer;
+        FILE* file{nullptr};
+        const fs::path tmp_path = m_path / TABLE_TMP_FILE;
+        if (!m_in_memory) {
+            file = fsbridge::fopen(tmp_path, "wb");
+            if (!file) ThrowCorrupt(strprintf("cannot create %s", fs::PathToString(tmp_path)));
+        }
+        TableWriter writer{file, &buffer};
+        auto oit = overlay.begin();
+        uint64_t ti = 0;
+        while (oit != overlay.end() || ti < table.Count()) {
+            const int cmp = oit == overlay.end() ? 1 : ti == table.Count() ? -1 : std::string_view{oit->first}.compare(table.Key(ti));
+            if (cmp <= 0) {
+                if (oit->second) writer.Add(oit->first, *oit->second);
+                if (cmp == 0) ++ti;
+                ++oit;
+            } else {
+                writer.Add(table.Key(ti), table.Value(ti));
+                ++ti;
+            }
+        }
+        writer.Finish();
+
+        if (m_in_memory) {
+            m_table = Table::FromBuffer(std::move(buffer));
+        } else {
+            const bool committed = FileCommit(file);
+            fclose(file);
+            if (!committed || !RenameOver(tmp_path, m_path / TABLE_FILE)) ThrowCorrupt("failed to commit table");
+            DirectoryCommit(m_path);
+            m_table = Table::Open(m_path / TABLE_FILE);
+            // Crashing before this point merely replays the log onto the
+            // new table, which yields the same state.
+            fclose(m_log);
+            m_log = fsbridge::fopen(m_path / LOG_FILE, "wb");
+            if (!m_log) ThrowCorrupt("cannot reset log");
+            m_log_size = 0;
+        }
+        LogPrint(BCLog::LEVELDB, "Merged %u buffered writes into %s (%u entries, %u bytes)\n",
+                 overlay.size(), fs::PathToString(m_path), m_table->Count(), m_table->Size());
+        m_overlay = std::make_shared<Overlay>();
+        m_overlay_bytes = 0;
+    }
+
+public:
+    MmapDBBackend(const fs::path& path, size_t cache_size, bool in_memory, bool wipe)
+        : m_path(path), m_in_memory(in_memory), m_overlay_limit(std::max(cache_size, MIN_OVERLAY_LIMIT))
+    {
+        LOCK(m_mutex);
+        m_overlay = std::make_shared<Overlay>();
+        m_table = std::make_shared<const Table>();
+        if (m_in_memory) return;
+
+        if (wipe) {
+            LogPrintf("Wiping mmap database in %s\n", fs::PathToString(path));
+            fs::remove(path / TABLE_FILE);
+            fs::remove(path / TABLE_TMP_FILE);
+            fs::remove(path / LOG_FILE);
+        }
+        TryCreateDirectories(path);
+        LogPrintf("Opening mmap database in %s\n", fs::PathToString(path));
+        if (fs::exists(path / TABLE_FILE)) m_table = Table::Open(path / TABLE_FILE);
+        OpenLog();
+        LogPrintf("Opened mmap database successfully (%u entries, %u buffered writes)\n", m_table->Count(), m_overlay->size());
+    }
+
+    ~MmapDBBackend()
+    {
+        LOCK(m_mutex);
+        if (m_log) fclose(m_log);
+    }
+
+    bool Read(Span<const std::byte> key, std::string& value, const Snapshot* snapshot) const override
+    {
+        State state;
+        if (snapshot) {
+            state = static_cast<const MmapSnapshot*>(snapshot)->state;
+        } else {
+            LOCK(m_mutex);
+            state = GetState();
+        }
+        const auto found = state.Find(AsView(key));
+        if (!found) return false;
+        value.assign(found->data(), found->size());
+        return true;
+    }
+
+    std::unique_ptr<Batch> NewBatch() const override
+    {
+        return std::make_unique<MmapBatch>();
+    }
+
+    void Write(Batch& batch, bool sync) override
+    {
+        const std::string& payload = static_cast<MmapBatch&>(batch).payload;
+        LOCK(m_mutex);
+        if (payload.empty()) {
+            // Nothing to apply, but a synchronous write still makes the log durable.
+            if (sync && !m_in_memory && !FileCommit(m_log)) {
+                ThrowCorrupt(strprintf("failed to sync %s", fs::PathToString(m_path / LOG_FILE)));
+            }
+            return;
+        }
+        if (!m_in_memory) {
+            unsigned char header[LOG_HEADER_SIZE];
+            WriteLE32(header, payload.size());
+            WriteLE32(header + 4, PayloadChecksum(payload));
+            if (fwrite(header, 1, sizeof(header), m_log) != sizeof(header) ||
+                fwrite(payload.data(), 1, payload.size(), m_log) != payload.size() ||
+                fflush(m_log) != 0 || (sync && !FileCommit(m_log))) {
+                ThrowCorrupt(strprintf("failed to append to %s", fs::PathToString(m_path / LOG_FILE)));
+            }
+            m_log_size += sizeof(header) + payload.size();
+        }
+        if (!Apply(payload)) ThrowCorrupt("malformed batch");
+        if (m_overlay_bytes > m_overlay_limit) CompactLocked();
+    }
+
+    std::unique_ptr<Iterator> NewIterator(const Snapshot* snapshot) const override
+    {
+        if (snapshot) return std::make_unique<MmapIterator>(static_cast<const MmapSnapshot*>(snapshot)->state);
+        LOCK(m_mutex);
+        return std::make_unique<MmapIterator>(GetState());
+    }
+
+    std::unique_ptr<Snapshot> NewSnapshot() const override
+    {
+        LOCK(m_mutex);
+        return std::make_unique<MmapSnapshot>(GetState());
+    }
+
+    size_t EstimateSize(Span<const std::byte> begin, Span<const std::byte> end) const override
+    {
+        std::shared_ptr<const Table> table;
+        {
+            LOCK(m_mutex);
+            table = m_table;
+        }
+        const uint64_t first = table->LowerBound(AsView(begin));
+        const uint64_t last = table->LowerBound(AsView(end));
+        return last > first ? table->Offset(last) - table->Offset(first) : 0;
+    }
+
+    void CompactRange(const Span<const std::byte>*, const Span<const std::byte>*) override
+    {
+        // There is only one table, so any compaction is a full merge.
+        LOCK(m_mutex);
+        if (!m_overlay->empty()) CompactLocked();
+    }
+
+    size_t DynamicMemoryUsage() const override
+    {
+        LOCK(m_mutex);
+        return m_overlay_bytes;
+    }
+
+    bool GetProperty(const std::string& name, std::string& value) const override
+    {
+        if (name != "mmapdb.stats") return false;
+        LOCK(m_mutex);
+        value = strprintf("table entries: %u\ntable bytes: %u\nbuffered writes: %u\nbuffered bytes: %u\nlog bytes: %u\n",
+                          m_table->Count(), m_table->Size(), m_overlay->size(), m_overlay_bytes, m_log_size);
+        return true;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<DBBackend> MakeMmapDBBackend(const fs::path& path, size_t cache_size, bool in_memory, bool wipe)
+{
+    return std::make_unique<MmapDBBackend>(path, cache_size, in_memory, wipe);
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2023 The Peercoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PEERCOIN_MMAPDB_H
+#define PEERCOIN_MMAPDB_H
+
+#include <dbwrapper.h>
+#include <fs.h>
+
+#include <cstddef>
+#include <memory>
+
+/**
+ * Create the read-optimized storage engine.
+ *
+ * The data lives in one immutable, sorted table that is memory-mapped and
+ * searched in place, so point lookups and scans need no copies or block cache.
+ * Writes are appended to a log and kept in an in-memory overlay that is
+ * merged into a new table once it outgrows cache_size (or on CompactRange).
+ * Every merge rewrites the whole table, which is why this engine is meant
+ * for read-mostly stores such as the block index and the txindex.
+ */
+std::unique_ptr<DBBackend> MakeMmapDBBackend(const fs::path& path, size_t cache_size, bool in_memory, bool wipe);
+
+#endif // PEERCOIN_MMAPDB_H
@@ -16,6 +16,10 @@ class ChainstateManager;
 
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphansize, maximum memory usage of orphan transactions in kilobytes */
+static const unsigned int DEFAULT_MAX_ORPHAN_SIZE = 5000;
+/** The orphans of a single peer may use at most this fraction of -maxorphansize */
+static const unsigned int MAX_ORPHAN_PEER_SHARE = 10;
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 static const bool DEFAULT_PEERBLOOMFILTERS = false;
@@ -8,6 +8,7 @@
 #include <chainparams.h>
 #include <clientversion.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
@@ -17,11 +18,20 @@
 #include <shutdown.h>
 #include <signet.h>
 #include <streams.h>
+#include <threadinterrupt.h>
 #include <undo.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <optional>
+#include <thread>
+
 namespace node {
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
@@ -29,6 +39,88 @@ std::atomic_bool fReindex(false);
 static FILE* OpenUndoFile(const FlatFilePos& pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
+static FlatFileSeq CompressedBlockFileSeq();
+
+/** A finalized block file, either memory-mapped or stored compressed */
+struct FinalizedBlockFile {
+    std::shared_ptr<const FlatFileMapping> mapping;
+    std::shared_ptr<const CompressedFlatFile> compressed;
+};
+
+/**
+ * Read-only mappings of the blk?????.dat files that are no longer appended to,
+ * so that block and transaction reads from them need neither a file handle nor
+ * a seek and deserialize straight from the page cache. Files that have been
+ * compressed (see StartBlockFileCompression) are opened as blkz?????.dat
+ * instead. Least recently used files are dropped once MAX_MAPPED_BLOCKFILES
+ * files are open. Where that is 0, uncompressed files are read through file
+ * handles, but compressed files, which cannot be read any other way, are still
+ * opened here, one at a time.
+ */
+class BlockFileMapCache
+{
+private:
+    struct Entry {
+        int nFile;
+        fs::path path;
+        FinalizedBlockFile file;
+    };
+
+    Mutex m_mutex;
+    //! Most recently used first.
+    std::list<Entry> m_entries GUARDED_BY(m_mutex);
+    //! Files numbered below this are finalized and safe to map.
+    int m_finalized_files GUARDED_BY(m_mutex){0};
+
+public:
+    /** Return the file holding pos, or std::nullopt if it is still being written or cannot be opened this way. */
+    std::optional<FinalizedBlockFile> Get(const FlatFilePos& pos)
+    {
+        if (pos.IsNull()) return std::nullopt;
+        const fs::path path{BlockFileSeq().FileName(pos)};
+        LOCK(m_mutex);
+        if (pos.nFile >= m_finalized_files) return std::nullopt;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->nFile == pos.nFile && it->path == path) {
+                m_entries.splice(m_entries.begin(), m_entries, it);
+                return it->file;
+            }
+        }
+        FinalizedBlockFile file;
+        file.compressed = CompressedFlatFile::Open(CompressedBlockFileSeq().FileName(pos));
+        if (!file.compressed) {
+            if (MAX_MAPPED_BLOCKFILES == 0) return std::nullopt;
+            file.mapping = FlatFileMapping::Open(path);
+            if (!file.mapping) return std::nullopt;
+        }
+        m_entries.push_front(Entry{pos.nFile, path, file});
+        if (m_entries.size() > std::max<size_t>(MAX_MAPPED_BLOCKFILES, 1)) m_entries.pop_back();
+        return file;
+    }
+
+    int GetFinalized()
+    {
+        LOCK(m_mutex);
+        return m_finalized_files;
+    }
+
+    /** Mark all files numbered below n_files as finalized and drop mappings of the others. */
+    void SetFinalized(int n_files)
+    {
+        LOCK(m_mutex);
+        m_finalized_files = n_files;
+        m_entries.remove_if([n_files](const Entry& entry) { return entry.nFile >= n_files; });
+    }
+
+    /** Drop the entry for one file, after it was compressed or restored. */
+    void Evict(int nFile)
+    {
+        LOCK(m_mutex);
+        m_entries.remove_if([nFile](const Entry& entry) { return entry.nFile == nFile; });
+    }
+};
+
+static BlockFileMapCache g_blockfile_maps;
 
 CBlockIndex* BlockManager::LookupBlockIndex(const uint256& hash) const
 {
@@ -223,7 +315,7 @@ void BlockManager::Unload()
     m_block_index.clear();
 
     m_blockfile_info.clear();
-    m_last_blockfile = 0;
+    SetLastBlockFile(0);
     m_dirty_blockindex.clear();
     m_dirty_fileinfo.clear();
 }
@@ -256,7 +348,9 @@ bool BlockManager::LoadBlockIndexDB(ChainstateManager& chainman)
     }
 
     // Load block file info
-    m_block_tree_db->ReadLastBlockFile(m_last_blockfile);
+    int last_blockfile = 0;
+    m_block_tree_db->ReadLastBlockFile(last_blockfile);
+    SetLastBlockFile(last_blockfile);
     m_blockfile_info.resize(m_last_blockfile + 1);
     LogPrintf("%s: last block file = %i\n", __func__, m_last_blockfile);
     for (int nFile = 0; nFile <= m_last_blockfile; nFile++) {
@@ -283,6 +377,9 @@ bool BlockManager::LoadBlockIndexDB(ChainstateManager& chainman)
     }
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++) {
         FlatFilePos pos(*it, 0);
+        if (fs::exists(CompressedBlockFileSeq().FileName(pos))) {
+            continue;
+        }
         if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
             return false;
         }
@@ -349,7 +446,11 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
 {
     const FlatFilePos pos{WITH_LOCK(::cs_main, return pindex->GetUndoPos())};
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashPrevBlock)
+{
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
@@ -364,7 +465,7 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     uint256 hashChecksum;
     CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
-        verifier << pindex->pprev->GetBlockHash();
+        verifier << hashPrevBlock;
         verifier >> blockundo;
         filein >> hashChecksum;
     } catch (const std::exception& e) {
@@ -399,6 +500,12 @@ void BlockManager::FlushBlockFile(bool fFinalize, bool finalize_undo)
     if (!fFinalize || finalize_undo) FlushUndoFile(m_last_blockfile, finalize_undo);
 }
 
+void BlockManager::SetLastBlockFile(int last_blockfile)
+{
+    m_last_blockfile = last_blockfile;
+    g_blockfile_maps.SetFinalized(last_blockfile);
+}
+
 uint64_t BlockManager::CalculateCurrentUsage()
 {
     LOCK(cs_LastBlockFile);
@@ -420,6 +527,11 @@ static FlatFileSeq UndoFileSeq()
     return FlatFileSeq(gArgs.GetBlocksDirPath(), "rev", UNDOFILE_CHUNK_SIZE);
 }
 
+static FlatFileSeq CompressedBlockFileSeq()
+{
+    return FlatFileSeq(gArgs.GetBlocksDirPath(), "blkz", BLOCKFILE_CHUNK_SIZE);
+}
+
 FILE* OpenBlockFile(const FlatFilePos& pos, bool fReadOnly)
 {
     return BlockFileSeq().Open(pos, fReadOnly);
@@ -466,7 +578,7 @@ bool BlockManager::FindBlockPos(FlatFilePos& pos, unsigned int nAddSize, unsigne
             LogPrint(BCLog::BLOCKSTORE, "Leaving block file %i: %s\n", m_last_blockfile, m_blockfile_info[m_last_blockfile].ToString());
         }
         FlushBlockFile(!fKnown, finalize_undo);
-        m_last_blockfile = nFile;
+        SetLastBlockFile(nFile);
     }
 
     m_blockfile_info[nFile].AddBlock(nHeight, nTime);
@@ -560,19 +672,79 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+/** One block read from a finalized block file, kept alive together with the data it points into */
+struct FinalizedBlock {
+    std::shared_ptr<const FlatFileMapping> mapping;
+    std::vector<unsigned char> frames;
+    //! The serialized block, preceded in memory by its 8 byte meta header
+    Span<const unsigned char> data;
+};
+
+/**
+ * Locate the block at pos in a finalized block file, bounded by the size
+ * recorded in front of it. Compressed files are decoded starting at the frame
+ * that holds the meta header. Returns false if the file may still be written
+ * to, in which case the caller reads it through a FILE*. Throws if the block
+ * does not lie within the file.
+ */
+static bool ReadFinalizedBlock(const FlatFilePos& pos, FinalizedBlock& block)
 {
-    block.SetNull();
+    const auto file{g_blockfile_maps.Get(pos)};
+    if (!file) return false;
+
+    Span<const unsigned char> data;
+    uint64_t offset{pos.nPos};
+    if (file->compressed) {
+        uint64_t frame_pos;
+        if (pos.nPos < 8 || !file->compressed->ReadFrame(pos.nPos - 8, block.frames, frame_pos)) {
+            throw std::ios_base::failure("position outside of compressed block file");
+        }
+        offset -= frame_pos;
+        // Blocks are normally framed whole; append the following frames while
+        // the block extends past the decoded ones.
+        std::vector<unsigned char> next;
+        while (true) {
+            uint64_t end{offset};
+            if (block.frames.size() >= offset) end += ReadLE32(block.frames.data() + offset - 4);
+            if (block.frames.size() >= end) break;
+            uint64_t next_pos;
+            if (!file->compressed->ReadFrame(frame_pos + block.frames.size(), next, next_pos)) {
+                throw std::ios_base::failure("block extends past end of compressed block file");
+            }
+            block.frames.insert(block.frames.end(), next.begin(), next.end());
+        }
+        data = block.frames;
+    } else {
+        block.mapping = file->mapping;
+        data = block.mapping->Data();
+    }
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    if (offset < 8 || offset > data.size()) {
+        throw std::ios_base::failure("position outside of block file");
+    }
+    const unsigned int size{ReadLE32(data.data() + offset - 4)};
+    if (size > data.size() - offset) {
+        throw std::ios_base::failure("block extends past end of block file");
     }
+    block.data = data.subspan(offset, size);
+    return true;
+}
 
-    // Read block
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+{
+    block.SetNull();
+
+    // Read block, from a mapping of the file if it is finalized
     try {
-        filein >> block;
+        if (FinalizedBlock finalized; ReadFinalizedBlock(pos, finalized)) {
+            SpanReader{SER_DISK, CLIENT_VERSION, finalized.data} >> block;
+        } else {
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            }
+            filein >> block;
+        }
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
@@ -610,6 +782,25 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
 
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
+    FinalizedBlock finalized;
+    bool is_finalized;
+    try {
+        is_finalized = ReadFinalizedBlock(pos, finalized);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+    if (is_finalized) {
+        const Span<const unsigned char> data{finalized.data};
+        // ReadFinalizedBlock() guarantees the 8 byte meta header in front of the block
+        if (memcmp(data.data() - 8, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                         HexStr(Span{data.data() - 8, CMessageHeader::MESSAGE_START_SIZE}),
+                         HexStr(message_start));
+        }
+        block.assign(data.begin(), data.end());
+        return true;
+    }
+
     FlatFilePos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
     CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
@@ -643,6 +834,31 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
     return true;
 }
 
+bool ReadTxFromDisk(CBlockHeader& header, CTransactionRef& tx, const FlatFilePos& pos, unsigned int tx_offset)
+{
+    try {
+        if (FinalizedBlock finalized; ReadFinalizedBlock(pos, finalized)) {
+            SpanReader reader{SER_DISK, CLIENT_VERSION, finalized.data};
+            reader >> header;
+            reader.ignore(tx_offset);
+            reader >> tx;
+        } else {
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull()) {
+                return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+            }
+            filein >> header;
+            if (fseek(filein.Get(), tx_offset, SEEK_CUR)) {
+                return error("%s: fseek(...) failed for %s", __func__, pos.ToString());
+            }
+            filein >> tx;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 FlatFilePos BlockManager::SaveBlockToDisk(const CBlock& block, int nHeight, CChain& active_chain, const CChainParams& chainparams, const FlatFilePos* dbp)
 {
@@ -664,6 +880,374 @@ FlatFilePos BlockManager::SaveBlockToDisk(const CBlock& block, int nHeight, CCha
     return blockPos;
 }
 
+/** Held while a block file is being compressed or restored */
+static Mutex g_blockfile_compression_mutex;
+
+/**
+ * Offsets at which the contents of a block file are split into compression
+ * frames: after whole blocks, once a frame holds BLOCKFILE_FRAME_SIZE bytes.
+ * Data that is not a block (such as zeroes left by an unclean shutdown) is
+ * framed up to the next message start.
+ */
+static std::vector<size_t> BlockFileFrameEnds(Span<const unsigned char> data, const CMessageHeader::MessageStartChars& message_start)
+{
+    std::vector<size_t> ends;
+    size_t frame_start{0};
+    size_t pos{0};
+    while (pos < data.size()) {
+        if (data.size() - pos >= 8 && memcmp(data.data() + pos, message_start, CMessageHeader::MESSAGE_START_SIZE) == 0 &&
+            ReadLE32(data.data() + pos + 4) <= data.size() - pos - 8) {
+            pos += 8 + ReadLE32(data.data() + pos + 4);
+        } else {
+            pos = std::search(data.begin() + pos + 1, data.end(), message_start, message_start + CMessageHeader::MESSAGE_START_SIZE) - data.begin();
+        }
+        if (pos - frame_start >= BLOCKFILE_FRAME_SIZE || pos == data.size()) {
+            ends.push_back(pos);
+            frame_start = pos;
+        }
+    }
+    return ends;
+}
+
+/** Replace a finalized blk?????.dat file with a verified blkz?????.dat file */
+static bool CompressBlockFile(const FlatFilePos& pos) EXCLUSIVE_LOCKS_REQUIRED(g_blockfile_compression_mutex)
+{
+    const fs::path path{BlockFileSeq().FileName(pos)};
+    const fs::path compressed_path{CompressedBlockFileSeq().FileName(pos)};
+    fs::path tmp_path{compressed_path};
+    tmp_path += ".tmp";
+
+    const auto mapping{BlockFileSeq().Map(pos)};
+    if (!mapping) {
+        return error("%s: failed to map %s", __func__, fs::PathToString(path));
+    }
+    const Span<const unsigned char> data{mapping->Data()};
+    if (!CompressedFlatFile::Write(tmp_path, data, BlockFileFrameEnds(data, Params().MessageStart()))) {
+        fs::remove(tmp_path);
+        return false;
+    }
+
+    // Only give up the original once every frame decodes back to it.
+    const auto compressed{CompressedFlatFile::Open(tmp_path)};
+    bool verified{compressed && compressed->Size() == data.size()};
+    std::vector<unsigned char> frame;
+    for (uint64_t frame_pos{0}; verified && frame_pos < data.size(); frame_pos += frame.size()) {
+        uint64_t start;
+        verified = compressed->ReadFrame(frame_pos, frame, start) && start == frame_pos && !frame.empty() &&
+                   frame.size() <= data.size() - frame_pos && std::equal(frame.begin(), frame.end(), data.begin() + frame_pos);
+    }
+    if (!verified || !RenameOver(tmp_path, compressed_path)) {
+        fs::remove(tmp_path);
+        return error("%s: failed to verify compressed copy of %s", __func__, fs::PathToString(path));
+    }
+    DirectoryCommit(gArgs.GetBlocksDirPath());
+    LogPrint(BCLog::BLOCKSTORE, "Compressed %s: %u -> %u bytes\n", fs::PathToString(path.filename()), data.size(), compressed->DataSize());
+
+    // Readers that still hold the mapping of the original keep it until they are done.
+    g_blockfile_maps.Evict(pos.nFile);
+    try {
+        fs::remove(path);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("Unable to remove %s after compressing it: %s\n", fs::PathToString(path), fsbridge::get_filesystem_error_message(e));
+    }
+    return true;
+}
+
+bool DecompressBlockFiles()
+{
+    LOCK(g_blockfile_compression_mutex);
+    for (int nFile = 0; fs::exists(CompressedBlockFileSeq().FileName(FlatFilePos(nFile, 0))) || fs::exists(BlockFileSeq().FileName(FlatFilePos(nFile, 0))); nFile++) {
+        const FlatFilePos pos(nFile, 0);
+        const fs::path compressed_path{CompressedBlockFileSeq().FileName(pos)};
+        if (!fs::exists(compressed_path)) continue;
+
+        const auto compressed{CompressedFlatFile::Open(compressed_path)};
+        if (!compressed) {
+            return error("%s: failed to open %s", __func__, fs::PathToString(compressed_path));
+        }
+        LogPrintf("Restoring uncompressed block file blk%05u.dat...\n", (unsigned int)nFile);
+        const fs::path path{BlockFileSeq().FileName(pos)};
+        fs::path tmp_path{path};
+        tmp_path += ".tmp";
+        FILE* file = fsbridge::fopen(tmp_path, "wb");
+        if (!file) {
+            return error("%s: failed to open %s", __func__, fs::PathToString(tmp_path));
+        }
+        std::vector<unsigned char> frame;
+        bool ok{true};
+        for (uint64_t frame_pos{0}; ok && frame_pos < compressed->Size(); frame_pos += frame.size()) {
+            uint64_t start;
+            ok = compressed->ReadFrame(frame_pos, frame, start) && start == frame_pos &&
+                 fwrite(frame.data(), 1, frame.size(), file) == frame.size();
+        }
+        ok = ok && FileCommit(file);
+        fclose(file);
+        if (!ok || !RenameOver(tmp_path, path)) {
+            fs::remove(tmp_path);
+            return error("%s: failed to restore %s", __func__, fs::PathToString(path));
+        }
+        DirectoryCommit(gArgs.GetBlocksDirPath());
+        g_blockfile_maps.Evict(nFile);
+        fs::remove(compressed_path);
+    }
+    return true;
+}
+
+/**
+ * Background thread that recompresses finalized block files. It pauses while
+ * blocks are imported or reindexed, since reindexing may append to any file.
+ */
+class BlockFileCompressor
+{
+private:
+    std::thread m_thread;
+    CThreadInterrupt m_interrupt;
+    //! Files below this number have been compressed or found not to need it.
+    int m_done_files{0};
+
+    void Run()
+    {
+        while (!m_interrupt) {
+            bool compressed_one{false};
+            {
+                LOCK(g_blockfile_compression_mutex);
+                const int finalized{g_blockfile_maps.GetFinalized()};
+                if (m_done_files > finalized) m_done_files = finalized;
+                if (!fImporting && !fReindex && m_done_files < finalized) {
+                    const FlatFilePos pos(m_done_files, 0);
+                    if (fs::exists(BlockFileSeq().FileName(pos)) && !fs::exists(CompressedBlockFileSeq().FileName(pos))) {
+                        if (!CompressBlockFile(pos)) {
+                            LogPrintf("Block file compression stopped after failing on blk%05u.dat\n", (unsigned int)pos.nFile);
+                            return;
+                        }
+                    }
+                    m_done_files++;
+                    compressed_one = true;
+                }
+            }
+            if (!compressed_one) m_interrupt.sleep_for(std::chrono::minutes{1});
+        }
+    }
+
+public:
+    void Start()
+    {
+        m_interrupt.reset();
+        m_thread = std::thread(&util::TraceThread, "blkcompress", [this] { Run(); });
+    }
+
+    void Stop()
+    {
+        m_interrupt();
+        if (m_thread.joinable()) m_thread.join();
+    }
+};
+
+static BlockFileCompressor g_blockfile_compressor;
+
+void StartBlockFileCompression()
+{
+    LogPrintf("Compressing finalized block files in the background\n");
+    g_blockfile_compressor.Start();
+}
+
+void StopBlockFileCompression()
+{
+    g_blockfile_compressor.Stop();
+}
+
+/**
+ * Reads the block files for -reindex on several threads. Each thread scans a
+ * whole file, deserializes its blocks and runs the context-free CheckBlock()
+ * on them. The blocks are handed out in file order, because adding them to the
+ * block index and computing their stake modifiers depends on their parents.
+ * Files are read ahead of the one handed out next only while their combined
+ * size stays within MAX_REINDEX_READAHEAD.
+ */
+class ReindexBlockFileReader
+{
+public:
+    using Blocks = std::vector<std::pair<std::shared_ptr<CBlock>, FlatFilePos>>;
+
+private:
+    const CChainParams& m_params;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! Files read so far; std::nullopt if the file does not exist
+    std::map<int, std::optional<Blocks>> m_files GUARDED_BY(m_mutex);
+    //! Sizes of the files claimed by readers and not handed out yet
+    std::map<int, uint64_t> m_file_sizes GUARDED_BY(m_mutex);
+    uint64_t m_bytes_ahead GUARDED_BY(m_mutex){0};
+    int m_next_read GUARDED_BY(m_mutex){0};
+    int m_next_handout GUARDED_BY(m_mutex){0};
+    //! Set once a file was found missing; no files after it are read
+    bool m_read_all GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    //! Why a reader thread failed, if one did
+    std::optional<std::string> m_error GUARDED_BY(m_mutex);
+    std::vector<std::thread> m_threads;
+
+    std::optional<Blocks> ReadFile(int nFile) const
+    {
+        const FlatFilePos file_pos(nFile, 0);
+        if (!fs::exists(GetBlockPosFilename(file_pos))) {
+            return std::nullopt; // No block files left to reindex
+        }
+        std::vector<unsigned char> buffer;
+        const auto mapping{BlockFileSeq().Map(file_pos)};
+        Span<const unsigned char> data;
+        if (mapping) {
+            data = mapping->Data();
+        } else {
+            CAutoFile file(OpenBlockFile(file_pos, true), SER_DISK, CLIENT_VERSION);
+            if (file.IsNull()) {
+                return std::nullopt; // This error is logged in OpenBlockFile
+            }
+            try {
+                buffer.resize(fs::file_size(GetBlockPosFilename(file_pos)));
+                file.read(MakeWritableByteSpan(buffer));
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                return std::nullopt;
+            }
+            data = buffer;
+        }
+
+        const auto& message_start{m_params.MessageStart()};
+        Blocks blocks;
+        size_t pos{0};
+        while (pos < data.size()) {
+            // locate a header, and start one byte further next time, in case of failure
+            const size_t start = std::search(data.begin() + pos, data.end(), message_start, message_start + CMessageHeader::MESSAGE_START_SIZE) - data.begin();
+            if (data.size() - start < 8) break;
+            pos = start + 1;
+            const unsigned int nSize = ReadLE32(data.data() + start + 4);
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE) continue;
+            try {
+                SpanReader reader{SER_DISK, CLIENT_VERSION, data.subspan(start + 8, std::min<size_t>(nSize, data.size() - start - 8))};
+                auto pblock{std::make_shared<CBlock>()};
+                reader >> *pblock;
+                pos = start + 8 + nSize - reader.size();
+                // CheckBlock() may mark the block as checked before failing; let
+                // AcceptBlock() repeat the checks so that the failure is recorded.
+                BlockValidationState state;
+                if (!CheckBlock(*pblock, state, m_params.GetConsensus())) {
+                    pblock->fChecked = false;
+                }
+                blocks.emplace_back(std::move(pblock), FlatFilePos(nFile, start + 8));
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+        return blocks;
+    }
+
+    /** Claim the next file to read, once the read-ahead allows it. Returns std::nullopt when the reader is stopping. */
+    std::optional<int> ClaimFile()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            if (m_stop || m_read_all) return std::nullopt;
+            std::error_code ec;
+            const uint64_t size{fs::file_size(GetBlockPosFilename(FlatFilePos(m_next_read, 0)), ec)};
+            if (ec) {
+                // Let ReadFile() report the missing file, and read no further
+                m_read_all = true;
+                return m_next_read++;
+            }
+            // Always allow one file, so that a file larger than the limit is still read
+            if (m_bytes_ahead == 0 || m_bytes_ahead + size <= MAX_REINDEX_READAHEAD) {
+                m_bytes_ahead += size;
+                m_file_sizes.emplace(m_next_read, size);
+                return m_next_read++;
+            }
+            m_cond.wait(lock);
+        }
+    }
+
+    void ThreadRead()
+    {
+        try {
+            while (const std::optional<int> nFile{ClaimFile()}) {
+                auto blocks{ReadFile(*nFile)};
+                {
+                    LOCK(m_mutex);
+                    m_files.emplace(*nFile, std::move(blocks));
+                }
+                m_cond.notify_all();
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            {
+                LOCK(m_mutex);
+                if (!m_error) m_error = e.what();
+                m_stop = true;
+            }
+            m_cond.notify_all();
+        }
+    }
+
+public:
+    ReindexBlockFileReader(const CChainParams& params, int threads)
+        : m_params{params}
+    {
+        for (int i = 0; i < threads; ++i) {
+            m_threads.emplace_back([this, i] {
+                util::TraceThread(strprintf("reindex.%i", i).c_str(), [this] { ThreadRead(); });
+            });
+        }
+    }
+
+    ~ReindexBlockFileReader()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * Wait for the next block file to be read. Returns std::nullopt once there
+     * are no block files left, or if reading failed; see Error().
+     */
+    std::optional<Blocks> Next()
+    {
+        std::optional<Blocks> blocks;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_error || m_files.count(m_next_handout) > 0; });
+            if (m_error) return std::nullopt;
+            auto it{m_files.find(m_next_handout)};
+            blocks = std::move(it->second);
+            m_files.erase(it);
+            if (const auto size{m_file_sizes.find(m_next_handout)}; size != m_file_sizes.end()) {
+                m_bytes_ahead -= size->second;
+                m_file_sizes.erase(size);
+            }
+            ++m_next_handout;
+        }
+        m_cond.notify_all();
+        return blocks;
+    }
+
+    /** Why reading the block files failed, if it did. */
+    std::optional<std::string> Error()
+    {
+        LOCK(m_mutex);
+        return m_error;
+    }
+};
+
+static int GetReindexThreads(const ArgsManager& args)
+{
+    int threads = args.GetIntArg("-reindexthreads", DEFAULT_REINDEX_THREADS);
+    if (threads <= 0) {
+        threads = std::min(GetNumCores(), DEFAULT_MAX_REINDEX_THREADS);
+    }
+    return std::clamp(threads, 1, MAX_REINDEX_THREADS);
+}
+
 struct CImportingNow {
     CImportingNow()
     {
@@ -688,23 +1272,50 @@ void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFile
 
         // -reindex
         if (fReindex) {
-            int nFile = 0;
-            while (true) {
-                FlatFilePos pos(nFile, 0);
-                if (!fs::exists(GetBlockPosFilename(pos))) {
-                    break; // No block files left to reindex
-                }
-                FILE* file = OpenBlockFile(pos, true);
-                if (!file) {
-                    break; // This error is logged in OpenBlockFile
+            // Reindexing may append to any block file, so they must all be uncompressed
+            if (!DecompressBlockFiles()) {
+                AbortNode("Failed to restore compressed block files for reindexing");
+                return;
+            }
+            const int reindex_threads{GetReindexThreads(args)};
+            if (reindex_threads > 1) {
+                LogPrintf("Reindexing with %d block file reader threads\n", reindex_threads);
+                ReindexBlockFileReader reader{Params(), reindex_threads};
+                for (int nFile = 0;; ++nFile) {
+                    std::optional<ReindexBlockFileReader::Blocks> blocks{reader.Next()};
+                    if (!blocks) {
+                        if (const auto error{reader.Error()}) {
+                            AbortNode(strprintf("Failed to read block files for reindexing: %s", *error));
+                            return;
+                        }
+                        break; // No block files left to reindex
+                    }
+                    LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                    chainman.ActiveChainstate().LoadExternalBlocks(*blocks);
+                    if (ShutdownRequested()) {
+                        LogPrintf("Shutdown requested. Exit %s\n", __func__);
+                        return;
+                    }
                 }
-                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-                chainman.ActiveChainstate().LoadExternalBlockFile(file, &pos);
-                if (ShutdownRequested()) {
-                    LogPrintf("Shutdown requested. Exit %s\n", __func__);
-                    return;
+            } else {
+                int nFile = 0;
+                while (true) {
+                    FlatFilePos pos(nFile, 0);
+                    if (!fs::exists(GetBlockPosFilename(pos))) {
+                        break; // No block files left to reindex
+                    }
+                    FILE* file = OpenBlockFile(pos, true);
+                    if (!file) {
+                        break; // This error is logged in OpenBlockFile
+                    }
+                    LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                    chainman.ActiveChainstate().LoadExternalBlockFile(file, &pos);
+                    if (ShutdownRequested()) {
+                        LogPrintf("Shutdown requested. Exit %s\n", __func__);
+                        return;
+                    }
+                    nFile++;
                 }
-                nFile++;
             }
             WITH_LOCK(::cs_main, chainman.m_blockman.m_block_tree_db->WriteReindexing(false));
             fReindex = false;
@@ -6,6 +6,7 @@
 #define BITCOIN_NODE_BLOCKSTORAGE_H
 
 #include <fs.h>
+#include <primitives/transaction.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <sync.h>
 #include <txdb.h>
@@ -20,6 +21,7 @@ class ArgsManager;
 class BlockValidationState;
 class CBlock;
 class CBlockFileInfo;
+class CBlockHeader;
 class CBlockIndex;
 class CBlockUndo;
 class CChain;
@@ -41,6 +43,20 @@ static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
+/** Blocks are grouped into compression frames of at least this many bytes */
+static const unsigned int BLOCKFILE_FRAME_SIZE = 0x4000; // 16 KiB
+/** Default for -blockcompression */
+static constexpr bool DEFAULT_BLOCK_COMPRESSION{false};
+/** The maximum number of finalized blk?????.dat files kept memory-mapped for reading */
+static const size_t MAX_MAPPED_BLOCKFILES = sizeof(void*) >= 8 ? 64 : 0;
+/** -reindexthreads default (0 = one per core, up to DEFAULT_MAX_REINDEX_THREADS) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** Default number of block file reader threads when -reindexthreads is 0 */
+static const int DEFAULT_MAX_REINDEX_THREADS = 4;
+/** Maximum number of block file reader threads */
+static const int MAX_REINDEX_THREADS = 16;
+/** Maximum combined size of the block files read ahead of the one being reindexed */
+static const uint64_t MAX_REINDEX_READAHEAD = 4 * uint64_t{MAX_BLOCKFILE_SIZE}; // 512 MiB
 
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
@@ -65,6 +81,8 @@ class BlockManager
 
 private:
     void FlushBlockFile(bool fFinalize = false, bool finalize_undo = false);
+    /** Change the file that blocks are appended to; all files before it may be memory-mapped for reading. */
+    void SetLastBlockFile(int last_blockfile);
     void FlushUndoFile(int block_file, bool finalize = false);
     bool FindBlockPos(FlatFilePos& pos, unsigned int nAddSize, unsigned int nHeight, CChain& active_chain, uint64_t nTime, bool fKnown);
     bool FindUndoPos(BlockValidationState& state, int nFile, FlatFilePos& pos, unsigned int nAddSize);
@@ -138,8 +156,22 @@ fs::path GetBlockPosFilename(const FlatFilePos& pos);
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
+/** Read the header of the block at pos and the transaction tx_offset bytes after the header */
+bool ReadTxFromDisk(CBlockHeader& header, CTransactionRef& tx, const FlatFilePos& pos, unsigned int tx_offset);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Read undo data at a known position. Does not take cs_main, so it can be used from prefetch threads. */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashPrevBlock);
+
+/**
+ * Start the background thread that replaces finalized blk?????.dat files by
+ * compressed blkz?????.dat files. Reads from compressed files are transparent
+ * and do not depend on the thread running.
+ */
+void StartBlockFileCompression();
+void StopBlockFileCompression();
+/** Turn all compressed block files back into blk?????.dat files */
+bool DecompressBlockFiles();
 
 void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args);
 } // namespace node
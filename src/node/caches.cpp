@@ -5,9 +5,68 @@
 #include <node/caches.h>
 
 #include <txdb.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <map>
+#include <optional>
+
+namespace {
+/** How a database's cache budget is split, in percent, and its filter and compression settings. */
+struct DBProfile {
+    int block_cache_pct;
+    int write_buffer_pct;
+    int bloom_bits;
+    bool compression;
+};
+
+/** Default profiles, keyed by SelectableDBNames(). */
+const std::map<std::string, DBProfile> DB_PROFILES{
+    // Random point reads and heavy batched writes during sync.
+    {"chainstate", {50, 25, 10, false}},
+    // Scanned once at startup (scans bypass the block cache), then mostly written.
+    {"blockindex", {10, 40, 10, false}},
+    // Point lookups of random txids; writes are appends during sync.
+    {"txindex", {70, 15, 10, false}},
+    // Filters and headers are served by height or hash.
+    {"blockfilterindex", {50, 25, 10, false}},
+    // Read by height or hash, one small record per block.
+    {"coinstatsindex", {50, 25, 10, false}},
+    // Range reads of the records of one script; many small writes per block.
+    {"addressindex", {60, 25, 10, false}},
+};
+
+struct DBOptionArg {
+    std::string db;
+    std::string option;
+    int64_t value;
+};
+
+std::optional<DBOptionArg> ParseDBOption(const std::string& arg)
+{
+    const auto colon = arg.find(':');
+    const auto equals = arg.find('=', colon == std::string::npos ? 0 : colon);
+    if (colon == std::string::npos || equals == std::string::npos) return std::nullopt;
+    DBOptionArg parsed{arg.substr(0, colon), arg.substr(colon + 1, equals - colon - 1), 0};
+    if (DB_PROFILES.count(parsed.db) == 0) return std::nullopt;
+    const auto value = ToIntegral<int64_t>(arg.substr(equals + 1));
+    if (!value) return std::nullopt;
+    parsed.value = *value;
+    if (parsed.option == "blockcache" || parsed.option == "writebuffer") {
+        if (parsed.value < 0 || parsed.value > 100) return std::nullopt;
+    } else if (parsed.option == "bloombits") {
+        if (parsed.value < 0 || parsed.value > 32) return std::nullopt;
+    } else if (parsed.option == "compression") {
+        if (parsed.value != 0 && parsed.value != 1) return std::nullopt;
+    } else {
+        return std::nullopt;
+    }
+    return parsed;
+}
+} // namespace
+
 namespace node {
 CacheSizes CalculateCacheSizes(const ArgsManager& args, size_t n_indexes)
 {
@@ -31,4 +90,32 @@ CacheSizes CalculateCacheSizes(const ArgsManager& args, size_t n_indexes)
     sizes.coins = nTotalCache; // the rest goes to in-memory cache
     return sizes;
 }
+
+DBOptions GetDBOptions(const ArgsManager& args, const std::string& db_name, size_t cache_size)
+{
+    DBProfile profile{50, 25, 10, false};
+    if (const auto it = DB_PROFILES.find(db_name); it != DB_PROFILES.end()) profile = it->second;
+    for (const std::string& arg : args.GetArgs("-dboption")) {
+        const auto parsed = ParseDBOption(arg);
+        if (!parsed || parsed->db != db_name) continue;
+        if (parsed->option == "blockcache") profile.block_cache_pct = parsed->value;
+        if (parsed->option == "writebuffer") profile.write_buffer_pct = parsed->value;
+        if (parsed->option == "bloombits") profile.bloom_bits = parsed->value;
+        if (parsed->option == "compression") profile.compression = parsed->value;
+    }
+
+    DBOptions options;
+    options.engine = GetDBEngine(args, db_name);
+    options.cache_size = cache_size;
+    options.block_cache_size = cache_size / 100 * profile.block_cache_pct;
+    options.write_buffer_size = cache_size / 100 * profile.write_buffer_pct;
+    options.bloom_bits = profile.bloom_bits;
+    options.compression = profile.compression;
+    return options;
+}
+
+bool IsValidDBOption(const std::string& arg)
+{
+    return ParseDBOption(arg).has_value();
+}
 } // namespace node
@@ -5,8 +5,11 @@
 #ifndef BITCOIN_NODE_CACHES_H
 #define BITCOIN_NODE_CACHES_H
 
+#include <dbwrapper.h>
+
 #include <cstddef>
 #include <cstdint>
+#include <string>
 
 class ArgsManager;
 
@@ -19,6 +22,16 @@ struct CacheSizes {
     int64_t filter_index;
 };
 CacheSizes CalculateCacheSizes(const ArgsManager& args, size_t n_indexes = 0);
+
+/**
+ * Split the cache budget of database db_name (one of SelectableDBNames())
+ * into engine caches and buffers according to how the database is used,
+ * applying any -dboption overrides.
+ */
+DBOptions GetDBOptions(const ArgsManager& args, const std::string& db_name, size_t cache_size);
+
+/** Check a -dboption=<db>:<option>=<value> argument. */
+bool IsValidDBOption(const std::string& arg);
 } // namespace node
 
 #endif // BITCOIN_NODE_CACHES_H
@@ -70,6 +70,19 @@ struct CCoinsStats {
     //! Total cumulative amount of coins lost due to unclaimed miner rewards up to and including this block
     CAmount total_unspendables_unclaimed_rewards{0};
 
+    // peercoin: supply and stake statistics, only available from coinstats index
+
+    //! Total cumulative amount minted by proof-of-work blocks up to and including this block
+    CAmount total_pow_reward{0};
+    //! Total cumulative amount minted by coinstakes up to and including this block
+    CAmount total_pos_reward{0};
+    //! Total cumulative amount of transaction fees destroyed up to and including this block
+    CAmount total_fees_destroyed{0};
+    //! Amount of the UTXO set that is old enough to stake at the time of this block
+    CAmount stakeable_amount{0};
+    //! Coin-days of the UTXO set that count towards staking at the time of this block
+    uint64_t stake_coin_days{0};
+
     CCoinsStats(CoinStatsHashType hash_type) : m_hash_type(hash_type) {}
 };
 
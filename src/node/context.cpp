@@ -6,9 +6,12 @@
 
 #include <addrman.h>
 #include <banman.h>
+#include <dbwrapper.h>
 #include <interfaces/chain.h>
 #include <net.h>
 #include <net_processing.h>
+#include <node/miner.h>
+#include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
 #include <validation.h>
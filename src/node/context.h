@@ -21,6 +21,8 @@ class CConnman;
 class CScheduler;
 class CTxMemPool;
 class ChainstateManager;
+class DBWriter;
+class FeeEstimator;
 class PeerManager;
 
 using interfaces::Chain;
@@ -29,6 +31,8 @@ using interfaces::Init;
 using interfaces::WalletLoader;
 
 namespace node {
+class BlockTemplateCache;
+
 //! NodeContext struct containing references to chain state and connection
 //! state.
 //!
@@ -42,9 +46,13 @@ namespace node {
 struct NodeContext {
     //! Init interface for initializing current process and connecting to other processes.
     interfaces::Init* init{nullptr};
+    //! Declared before the members holding databases, so that it outlives them.
+    std::unique_ptr<DBWriter> db_writer;
     std::unique_ptr<AddrMan> addrman;
     std::unique_ptr<CConnman> connman;
+    std::unique_ptr<FeeEstimator> fee_estimator;
     std::unique_ptr<CTxMemPool> mempool;
+    std::unique_ptr<BlockTemplateCache> template_cache;
     std::unique_ptr<PeerManager> peerman;
     std::unique_ptr<ChainstateManager> chainman;
     std::unique_ptr<BanMan> banman;
@@ -103,7 +103,7 @@ BlockAssembler::BlockAssembler(CChainState& chainstate, const CTxMemPool& mempoo
 
 void BlockAssembler::resetBlock()
 {
-    inBlock.clear();
+    m_buffers.Clear();
 
     // Reserve space for coinbase tx
     nBlockWeight = 4000;
@@ -113,6 +113,47 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    m_capacity_limited = false;
+}
+
+/** Transactions timestamped after the returned time can't be included in a block with time nTime */
+static int64_t PackageTimeLimit(uint32_t nTime)
+{
+    return nTime ? std::min<int64_t>(nTime, GetAdjustedTime()) : GetAdjustedTime();
+}
+
+void BlockTemplateCache::Invalidate()
+{
+    m_tip.SetNull();
+    m_selected.clear();
+    m_added.clear();
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    if (m_tip.IsNull()) return;
+    // A new transaction may pay more than packages in a full block
+    if (m_capacity_limited || m_added.size() >= MAX_TEMPLATE_CACHE_ADDED) {
+        Invalidate();
+        return;
+    }
+    m_added.push_back(tx->GetHash());
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    // Removed transactions are skipped when the selection is reused, but the
+    // space they leave in a full block should go to the packages left out.
+    if (m_capacity_limited) Invalidate();
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    LOCK(m_mutex);
+    Invalidate();
 }
 
 // peercoin: if pwallet != NULL it will attempt to create coinstake
@@ -204,7 +245,22 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated, pblock->nTime);
+    // Reuse the selection of the last template when it was made for the same
+    // mempool, which is not the case for the empty mempool of generateblock.
+    BlockTemplateCache* cache{m_node && m_node->template_cache && &m_node->template_cache->GetMemPool() == &m_mempool ? m_node->template_cache.get() : nullptr};
+    if (cache) {
+        WITH_LOCK(cache->m_mutex, std::swap(m_buffers, cache->m_buffers));
+        m_buffers.Clear();
+    }
+    const bool from_cache{cache && addCachedPackageTxs(*cache, pindexPrev, pblock->nTime)};
+    if (!from_cache) {
+        const size_t first_tx{pblock->vtx.size()};
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, pblock->nTime);
+        if (cache) storeSelection(*cache, pindexPrev, pblock->nTime, first_tx);
+    }
+    if (cache) {
+        WITH_LOCK(cache->m_mutex, std::swap(m_buffers, cache->m_buffers));
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -236,19 +292,65 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants%s), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, from_cache ? ", cached" : "", 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
 
-void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
+PackageSlot* BlockAssembler::FindSlot(CTxMemPool::txiter it)
 {
-    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
-        // Only test txs not already in the block
-        if (inBlock.count(*iit)) {
-            testSet.erase(iit++);
-        } else {
-            iit++;
+    // The index is left over by whichever assembler looked at the entry last,
+    // so check that it refers to this entry.
+    const uint32_t index{it->m_block_slot};
+    if (index >= m_buffers.slots.size() || m_buffers.slots[index].iter != it) return nullptr;
+    return &m_buffers.slots[index];
+}
+
+const PackageSlot* BlockAssembler::FindSlot(CTxMemPool::txiter it) const
+{
+    return const_cast<BlockAssembler*>(this)->FindSlot(it);
+}
+
+uint32_t BlockAssembler::GetSlot(CTxMemPool::txiter it)
+{
+    if (FindSlot(it)) return it->m_block_slot;
+    it->m_block_slot = m_buffers.slots.size();
+    m_buffers.slots.emplace_back(it);
+    return it->m_block_slot;
+}
+
+bool BlockAssembler::InBlock(CTxMemPool::txiter it) const
+{
+    const PackageSlot* slot{FindSlot(it)};
+    return slot && slot->state == PackageSlot::State::IN_BLOCK;
+}
+
+bool BlockAssembler::ParentsInBlock(CTxMemPool::txiter it) const
+{
+    AssertLockHeld(m_mempool.cs);
+    for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+        if (!InBlock(m_mempool.mapTx.iterator_to(parent))) return false;
+    }
+    return true;
+}
+
+void BlockAssembler::FailTxsNewerThan(int64_t time_limit)
+{
+    AssertLockHeld(m_mempool.cs);
+    if (time_limit >= std::numeric_limits<uint32_t>::max()) return;
+    auto& stack{m_buffers.stack};
+    const auto& by_time{m_mempool.mapTx.get<tx_time>()};
+    for (auto it = by_time.upper_bound(static_cast<uint32_t>(std::max<int64_t>(time_limit, 0))); it != by_time.end(); ++it) {
+        stack.push_back(m_mempool.mapTx.project<0>(it));
+        while (!stack.empty()) {
+            const CTxMemPool::txiter entry{stack.back()};
+            stack.pop_back();
+            PackageSlot& slot{m_buffers.slots[GetSlot(entry)]};
+            if (slot.state == PackageSlot::State::FAILED) continue;
+            slot.state = PackageSlot::State::FAILED;
+            for (const CTxMemPoolEntry& child : entry->GetMemPoolChildrenConst()) {
+                stack.push_back(m_mempool.mapTx.iterator_to(child));
+            }
         }
     }
 }
@@ -269,7 +371,7 @@ bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost
 // - transaction finality (locktime)
 // - premature witness (in case segwit transactions are added to mempool before
 //   segwit activation)
-bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package, uint32_t nTime) const
+bool BlockAssembler::TestPackageTransactions(Span<const CTxMemPool::txiter> package, uint32_t nTime) const
 {
     for (CTxMemPool::txiter it : package) {
         if (!IsFinalTx(it->GetTx(), nHeight, m_lock_time_cutoff)) {
@@ -277,9 +379,9 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
         }
         if (!fIncludeWitness && it->GetTx().HasWitness()) {
             return false;
-
+        }
         // peercoin: timestamp limit
-        if (it->GetTx().nTime > GetAdjustedTime() || (nTime && it->GetTx().nTime > nTime))
+        if (it->GetTx().nTime > GetAdjustedTime() || (nTime && it->GetTx().nTime > nTime)) {
             return false;
         }
     }
@@ -295,7 +397,7 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     ++nBlockTx;
     nBlockSigOpsCost += iter->GetSigOpCost();
     nFees += iter->GetFee();
-    inBlock.insert(iter);
+    m_buffers.slots[GetSlot(iter)].state = PackageSlot::State::IN_BLOCK;
 
     bool fPrintPriority = gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
     if (fPrintPriority) {
@@ -305,62 +407,99 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
-int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
-        indexed_modified_transaction_set &mapModifiedTx)
+/** Orders the heap of modified entries so that the best ancestor feerate comes first */
+static bool WorseAncestorFee(const CTxMemPoolModifiedEntry& a, const CTxMemPoolModifiedEntry& b)
+{
+    return CompareTxMemPoolEntryByAncestorFee()(b, a);
+}
+
+int BlockAssembler::UpdatePackagesForAdded(Span<const CTxMemPool::txiter> alreadyAdded)
 {
     AssertLockHeld(m_mempool.cs);
 
+    auto& stack{m_buffers.stack};
     int nDescendantsUpdated = 0;
     for (CTxMemPool::txiter it : alreadyAdded) {
-        CTxMemPool::setEntries descendants;
-        m_mempool.CalculateDescendants(it, descendants);
-        // Insert all descendants (not yet in block) into the modified set
-        for (CTxMemPool::txiter desc : descendants) {
-            if (alreadyAdded.count(desc)) {
-                continue;
+        WITH_FRESH_EPOCH(m_epoch);
+        // Walk all descendants, and update the ones not yet in block
+        for (const CTxMemPoolEntry& child : it->GetMemPoolChildrenConst()) {
+            stack.push_back(m_mempool.mapTx.iterator_to(child));
+        }
+        while (!stack.empty()) {
+            const CTxMemPool::txiter desc{stack.back()};
+            stack.pop_back();
+            const uint32_t index{GetSlot(desc)};
+            PackageSlot& slot{m_buffers.slots[index]};
+            if (m_epoch.visited(slot.marker)) continue;
+            for (const CTxMemPoolEntry& child : desc->GetMemPoolChildrenConst()) {
+                stack.push_back(m_mempool.mapTx.iterator_to(child));
             }
+            if (slot.state == PackageSlot::State::IN_BLOCK) continue;
+
             ++nDescendantsUpdated;
-            modtxiter mit = mapModifiedTx.find(desc);
-            if (mit == mapModifiedTx.end()) {
-                CTxMemPoolModifiedEntry modEntry(desc);
-                modEntry.nSizeWithAncestors -= it->GetTxSize();
-                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
-                modEntry.nSigOpCostWithAncestors -= it->GetSigOpCost();
-                mapModifiedTx.insert(modEntry);
-            } else {
-                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+            if (slot.state != PackageSlot::State::MODIFIED) {
+                slot.state = PackageSlot::State::MODIFIED;
+                slot.nSizeWithAncestors = desc->GetSizeWithAncestors();
+                slot.nModFeesWithAncestors = desc->GetModFeesWithAncestors();
+                slot.nSigOpCostWithAncestors = desc->GetSigOpCostWithAncestors();
             }
+            slot.nSizeWithAncestors -= it->GetTxSize();
+            slot.nModFeesWithAncestors -= it->GetModifiedFee();
+            slot.nSigOpCostWithAncestors -= it->GetSigOpCost();
+            ++slot.version;
+            // The entry taken before the update is left in the heap, and
+            // dropped when it comes up.
+            m_buffers.modified.emplace_back(slot, index);
+            std::push_heap(m_buffers.modified.begin(), m_buffers.modified.end(), WorseAncestorFee);
         }
     }
     return nDescendantsUpdated;
 }
 
-// Skip entries in mapTx that are already in a block or are present
-// in mapModifiedTx (which implies that the mapTx ancestor state is
-// stale due to ancestor inclusion in the block)
+// Skip entries in mapTx that are already in a block or are modified
+// (which implies that the mapTx ancestor state is stale due to ancestor
+// inclusion in the block)
 // Also skip transactions that we've already failed to add. This can happen if
-// we consider a transaction in mapModifiedTx and it fails: we can then
+// we consider a modified transaction and it fails: we can then
 // potentially consider it again while walking mapTx.  It's currently
-// guaranteed to fail again, but as a belt-and-suspenders check we put it in
-// failedTx and avoid re-evaluation, since the re-evaluation would be using
+// guaranteed to fail again, but as a belt-and-suspenders check we mark it
+// failed and avoid re-evaluation, since the re-evaluation would be using
 // cached size/sigops/fee values that are not actually correct.
-bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx)
+bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it)
 {
-    AssertLockHeld(m_mempool.cs);
-
     assert(it != m_mempool.mapTx.end());
-    return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
+    const PackageSlot* slot{FindSlot(it)};
+    return slot && slot->state != PackageSlot::State::NONE;
 }
 
-void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries)
+void BlockAssembler::CollectPackage(CTxMemPool::txiter it)
 {
+    AssertLockHeld(m_mempool.cs);
+
+    auto& package{m_buffers.package};
+    auto& stack{m_buffers.stack};
+    package.clear();
+    {
+        WITH_FRESH_EPOCH(m_epoch);
+        // Ancestors of transactions in the block are in the block as well
+        stack.push_back(it);
+        while (!stack.empty()) {
+            const CTxMemPool::txiter entry{stack.back()};
+            stack.pop_back();
+            PackageSlot& slot{m_buffers.slots[GetSlot(entry)]};
+            if (m_epoch.visited(slot.marker) || slot.state == PackageSlot::State::IN_BLOCK) continue;
+            package.push_back(entry);
+            for (const CTxMemPoolEntry& parent : entry->GetMemPoolParentsConst()) {
+                stack.push_back(m_mempool.mapTx.iterator_to(parent));
+            }
+        }
+    }
+
     // Sort package by ancestor count
     // If a transaction A depends on transaction B, then A's ancestor count
     // must be greater than B's.  So this is sufficient to validly order the
     // transactions for block inclusion.
-    sortedEntries.clear();
-    sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
-    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+    std::sort(package.begin(), package.end(), CompareTxIterByAncestorCount());
 }
 
 // This transaction selection algorithm orders the mempool based
@@ -369,23 +508,40 @@ void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::ve
 // for block inclusion, we need an alternate method of updating the feerate
 // of a transaction with its not-yet-selected ancestors as we go.
 // This is accomplished by walking the in-mempool descendants of selected
-// transactions and storing a temporary modified state in mapModifiedTxs.
-// Each time through the loop, we compare the best transaction in
-// mapModifiedTxs with the next transaction in the mempool to decide what
-// transaction package to work on next.
+// transactions and storing a temporary modified state in their PackageSlot.
+// Each time through the loop, we compare the best modified transaction
+// with the next transaction in the mempool to decide what transaction
+// package to work on next.
 void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpdated, uint32_t nTime)
 {
     AssertLockHeld(m_mempool.cs);
 
-    // mapModifiedTx will store sorted packages after they are modified
-    // because some of their txs are already in the block
-    indexed_modified_transaction_set mapModifiedTx;
-    // Keep track of entries that failed inclusion, to avoid duplicate work
-    CTxMemPool::setEntries failedTx;
+    // The modified entries are kept in a heap, sorted by ancestor feerate
+    // after some of their ancestors are included in the block. An entry is
+    // pushed whenever its state changes; the outdated ones are dropped as
+    // they come up.
+    auto& modified{m_buffers.modified};
+    const auto is_outdated = [&](const CTxMemPoolModifiedEntry& entry) {
+        const PackageSlot& slot{m_buffers.slots[entry.slot]};
+        return slot.state != PackageSlot::State::MODIFIED || slot.version != entry.version;
+    };
+    const auto pop_modified = [&] {
+        std::pop_heap(modified.begin(), modified.end(), WorseAncestorFee);
+        modified.pop_back();
+    };
+
+    // Start by adding all descendants of previously added txs to the modified
+    // entries and modifying them for their already included ancestors
+    m_buffers.package.clear();
+    for (const PackageSlot& slot : m_buffers.slots) {
+        if (slot.state == PackageSlot::State::IN_BLOCK) m_buffers.package.push_back(slot.iter);
+    }
+    UpdatePackagesForAdded(m_buffers.package);
 
-    // Start by adding all descendants of previously added txs to mapModifiedTx
-    // and modifying them for their already included ancestors
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
+    // peercoin: transactions timestamped after the block, and their
+    // descendants, can't be included. Look them up in the timestamp index
+    // and skip them, rather than computing their packages only to reject them.
+    FailTxsNewerThan(PackageTimeLimit(nTime));
 
     CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = m_mempool.mapTx.get<ancestor_score>().begin();
     CTxMemPool::txiter iter;
@@ -396,58 +552,63 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
     int64_t nConsecutiveFailed = 0;
 
-    while (mi != m_mempool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty()) {
+    while (true) {
+        while (!modified.empty() && is_outdated(modified.front())) {
+            pop_modified();
+        }
+        if (mi == m_mempool.mapTx.get<ancestor_score>().end() && modified.empty()) break;
+
         // First try to find a new transaction in mapTx to evaluate.
         if (mi != m_mempool.mapTx.get<ancestor_score>().end() &&
-            SkipMapTxEntry(m_mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
+            SkipMapTxEntry(m_mempool.mapTx.project<0>(mi))) {
             ++mi;
             continue;
         }
 
         // Now that mi is not stale, determine which transaction to evaluate:
-        // the next entry from mapTx, or the best from mapModifiedTx?
+        // the next entry from mapTx, or the best modified entry?
         bool fUsingModified = false;
 
-        modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
         if (mi == m_mempool.mapTx.get<ancestor_score>().end()) {
-            // We're out of entries in mapTx; use the entry from mapModifiedTx
-            iter = modit->iter;
+            // We're out of entries in mapTx; use the best modified entry
+            iter = modified.front().iter;
             fUsingModified = true;
         } else {
-            // Try to compare the mapTx entry to the mapModifiedTx entry
+            // Try to compare the mapTx entry to the best modified entry
             iter = m_mempool.mapTx.project<0>(mi);
-            if (modit != mapModifiedTx.get<ancestor_score>().end() &&
-                    CompareTxMemPoolEntryByAncestorFee()(*modit, CTxMemPoolModifiedEntry(iter))) {
-                // The best entry in mapModifiedTx has higher score
+            if (!modified.empty() &&
+                    CompareTxMemPoolEntryByAncestorFee()(modified.front(), CTxMemPoolModifiedEntry(iter))) {
+                // The best modified entry has higher score
                 // than the one from mapTx.
                 // Switch which transaction (package) to consider
-                iter = modit->iter;
+                iter = modified.front().iter;
                 fUsingModified = true;
             } else {
-                // Either no entry in mapModifiedTx, or it's worse than mapTx.
+                // Either no modified entry, or it's worse than mapTx.
                 // Increment mi for the next loop iteration.
                 ++mi;
             }
         }
 
-        // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
-        // contain anything that is inBlock.
-        assert(!inBlock.count(iter));
+        // We skip mapTx entries that are inBlock, and the modified entries
+        // shouldn't contain anything that is inBlock.
+        assert(!InBlock(iter));
 
         uint64_t packageSize = iter->GetSizeWithAncestors();
         int64_t packageSigOpsCost = iter->GetSigOpCostWithAncestors();
         if (fUsingModified) {
-            packageSize = modit->nSizeWithAncestors;
-            packageSigOpsCost = modit->nSigOpCostWithAncestors;
+            packageSize = modified.front().nSizeWithAncestors;
+            packageSigOpsCost = modified.front().nSigOpCostWithAncestors;
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            m_capacity_limited = true;
             if (fUsingModified) {
-                // Since we always look at the best entry in mapModifiedTx,
-                // we must erase failed entries so that we can consider the
-                // next best entry on the next loop iteration
-                mapModifiedTx.get<ancestor_score>().erase(modit);
-                failedTx.insert(iter);
+                // Since we always look at the best modified entry, we must
+                // drop failed entries so that we can consider the next best
+                // entry on the next loop iteration
+                m_buffers.slots[modified.front().slot].state = PackageSlot::State::FAILED;
+                pop_modified();
             }
 
             ++nConsecutiveFailed;
@@ -460,19 +621,14 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
             continue;
         }
 
-        CTxMemPool::setEntries ancestors;
-        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-        std::string dummy;
-        m_mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-
-        onlyUnconfirmed(ancestors);
-        ancestors.insert(iter);
+        // Collect the package, sorted in a valid order
+        CollectPackage(iter);
 
         // Test if all tx's are Final
-        if (!TestPackageTransactions(ancestors,nTime)) {
+        if (!TestPackageTransactions(m_buffers.package, nTime)) {
             if (fUsingModified) {
-                mapModifiedTx.get<ancestor_score>().erase(modit);
-                failedTx.insert(iter);
+                m_buffers.slots[modified.front().slot].state = PackageSlot::State::FAILED;
+                pop_modified();
             }
             continue;
         }
@@ -480,21 +636,106 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         // This transaction will make it in; reset the failed counter.
         nConsecutiveFailed = 0;
 
-        // Package can be added. Sort the entries in a valid order.
-        std::vector<CTxMemPool::txiter> sortedEntries;
-        SortForBlock(ancestors, sortedEntries);
-
-        for (size_t i = 0; i < sortedEntries.size(); ++i) {
-            AddToBlock(sortedEntries[i]);
-            // Erase from the modified set, if present
-            mapModifiedTx.erase(sortedEntries[i]);
+        // Package can be added. Its modified entries become outdated.
+        for (CTxMemPool::txiter entry : m_buffers.package) {
+            AddToBlock(entry);
         }
 
         ++nPackagesSelected;
 
         // Update transactions that depend on each of these
-        nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
+        nDescendantsUpdated += UpdatePackagesForAdded(m_buffers.package);
+    }
+}
+
+bool BlockAssembler::addCachedPackageTxs(BlockTemplateCache& cache, const CBlockIndex* pindexPrev, uint32_t nTime)
+{
+    AssertLockHeld(m_mempool.cs);
+    LOCK(cache.m_mutex);
+
+    const int64_t time_limit{PackageTimeLimit(nTime)};
+    if (cache.m_tip != pindexPrev->GetBlockHash() || cache.m_block_max_weight != nBlockMaxWeight ||
+        cache.m_include_witness != fIncludeWitness || time_limit >= cache.m_next_deferred_time) {
+        return false;
+    }
+
+    CBlockTemplate& tmpl{*pblocktemplate};
+    // A coinstake has no fee and sigops entries, so the vectors are truncated
+    // to their own sizes rather than to that of vtx.
+    const size_t first_tx{tmpl.block.vtx.size()};
+    const size_t first_fee{tmpl.vTxFees.size()};
+    const size_t first_sigops_cost{tmpl.vTxSigOpsCost.size()};
+    const uint64_t block_weight{nBlockWeight};
+    const uint64_t block_sigops_cost{nBlockSigOpsCost};
+    const auto rollback = [&] {
+        tmpl.block.vtx.resize(first_tx);
+        tmpl.vTxFees.resize(first_fee);
+        tmpl.vTxSigOpsCost.resize(first_sigops_cost);
+        nBlockWeight = block_weight;
+        nBlockSigOpsCost = block_sigops_cost;
+        nBlockTx = 0;
+        nFees = 0;
+        m_buffers.Clear();
+        return false;
+    };
+
+    std::vector<uint256> selected;
+    selected.reserve(cache.m_selected.size() + cache.m_added.size());
+
+    // The selected transactions left in the mempool still fit, and still
+    // follow their parents, unless a parent was removed without them.
+    for (const uint256& txid : cache.m_selected) {
+        const auto it{m_mempool.mapTx.find(txid)};
+        if (it == m_mempool.mapTx.end() || !ParentsInBlock(it)) continue;
+        if (!TestPackageTransactions(Span{&it, 1}, nTime)) return rollback();
+        AddToBlock(it);
+        selected.push_back(txid);
+    }
+
+    // The block had room for every package, so the added transactions whose
+    // parents are included can be appended, as long as there is still room.
+    int64_t next_deferred_time{cache.m_next_deferred_time};
+    for (const uint256& txid : cache.m_added) {
+        const auto it{m_mempool.mapTx.find(txid)};
+        if (it == m_mempool.mapTx.end() || InBlock(it) || !ParentsInBlock(it)) continue;
+        if (it->GetTx().nTime > time_limit) {
+            next_deferred_time = std::min<int64_t>(next_deferred_time, it->GetTx().nTime);
+            continue;
+        }
+        if (!TestPackage(it->GetTxSize(), it->GetSigOpCost())) return rollback();
+        if (!TestPackageTransactions(Span{&it, 1}, nTime)) continue;
+        AddToBlock(it);
+        selected.push_back(txid);
     }
+
+    cache.m_selected = std::move(selected);
+    cache.m_added.clear();
+    cache.m_next_deferred_time = next_deferred_time;
+    return true;
+}
+
+void BlockAssembler::storeSelection(BlockTemplateCache& cache, const CBlockIndex* pindexPrev, uint32_t nTime, size_t first_tx) const
+{
+    AssertLockHeld(m_mempool.cs);
+    LOCK(cache.m_mutex);
+
+    cache.m_tip = pindexPrev->GetBlockHash();
+    cache.m_block_max_weight = nBlockMaxWeight;
+    cache.m_include_witness = fIncludeWitness;
+    cache.m_capacity_limited = m_capacity_limited;
+
+    const auto& vtx{pblocktemplate->block.vtx};
+    cache.m_selected.clear();
+    for (size_t i = first_tx; i < vtx.size(); ++i) {
+        cache.m_selected.push_back(vtx[i]->GetHash());
+    }
+    cache.m_added.clear();
+
+    // Once the earliest of the transactions that were too new can be
+    // included, a new selection has to be made.
+    const auto& by_time{m_mempool.mapTx.get<tx_time>()};
+    const auto next{by_time.upper_bound(static_cast<uint32_t>(std::clamp<int64_t>(PackageTimeLimit(nTime), 0, std::numeric_limits<uint32_t>::max())))};
+    cache.m_next_deferred_time = next == by_time.end() ? std::numeric_limits<int64_t>::max() : int64_t{next->GetTx().nTime};
 }
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
@@ -11,12 +11,13 @@
 #include <node/context.h>
 #include <memory>
 #include <optional>
+#include <span.h>
 #include <stdint.h>
+#include <sync.h>
+#include <util/epochguard.h>
+#include <validationinterface.h>
 #include <wallet/wallet.h>
 
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index_container.hpp>
-
 extern int64_t nLastCoinStakeSearchInterval;
 class ChainstateManager;
 
@@ -37,8 +38,30 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
-// Container for tracking updates to ancestor feerate as we include (parent)
-// transactions in a block
+/** State of a mempool entry while packages are selected for a block */
+struct PackageSlot {
+    explicit PackageSlot(CTxMemPool::txiter entry) : iter(entry) {}
+
+    enum class State : uint8_t {
+        NONE,     //!< not considered yet
+        MODIFIED, //!< some ancestors are in the block; the ancestor state below is current
+        IN_BLOCK, //!< added to the block
+        FAILED,   //!< failed to be added, don't consider again
+    };
+
+    CTxMemPool::txiter iter;
+    State state{State::NONE};
+    //! Bumped on every change of the ancestor state, so that outdated heap entries can be told apart
+    uint32_t version{0};
+    uint64_t nSizeWithAncestors{0};
+    CAmount nModFeesWithAncestors{0};
+    int64_t nSigOpCostWithAncestors{0};
+    //! Marks the entry as visited by the current walk of the mempool graph
+    Epoch::Marker marker;
+};
+
+// Snapshot of the ancestor feerate of a transaction, updated as (parent)
+// transactions are included in a block
 struct CTxMemPoolModifiedEntry {
     explicit CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
     {
@@ -48,6 +71,15 @@ struct CTxMemPoolModifiedEntry {
         nSigOpCostWithAncestors = entry->GetSigOpCostWithAncestors();
     }
 
+    CTxMemPoolModifiedEntry(const PackageSlot& state, uint32_t index)
+        : iter(state.iter),
+          nSizeWithAncestors(state.nSizeWithAncestors),
+          nModFeesWithAncestors(state.nModFeesWithAncestors),
+          nSigOpCostWithAncestors(state.nSigOpCostWithAncestors),
+          slot(index),
+          version(state.version)
+    {}
+
     int64_t GetModifiedFee() const { return iter->GetModifiedFee(); }
     uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
     CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
@@ -58,26 +90,9 @@ struct CTxMemPoolModifiedEntry {
     uint64_t nSizeWithAncestors;
     CAmount nModFeesWithAncestors;
     int64_t nSigOpCostWithAncestors;
-};
-
-/** Comparator for CTxMemPool::txiter objects.
- *  It simply compares the internal memory address of the CTxMemPoolEntry object
- *  pointed to. This means it has no meaning, and is only useful for using them
- *  as key in other indexes.
- */
-struct CompareCTxMemPoolIter {
-    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
-    {
-        return &(*a) < &(*b);
-    }
-};
-
-struct modifiedentry_iter {
-    typedef CTxMemPool::txiter result_type;
-    result_type operator() (const CTxMemPoolModifiedEntry &entry) const
-    {
-        return entry.iter;
-    }
+    //! Slot and version of the state this was taken from
+    uint32_t slot{0};
+    uint32_t version{0};
 };
 
 // A comparator that sorts transactions based on number of ancestors.
@@ -93,38 +108,77 @@ struct CompareTxIterByAncestorCount {
     }
 };
 
-typedef boost::multi_index_container<
-    CTxMemPoolModifiedEntry,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<
-            modifiedentry_iter,
-            CompareCTxMemPoolIter
-        >,
-        // sorted by modified ancestor fee rate
-        boost::multi_index::ordered_non_unique<
-            // Reuse same tag from CTxMemPool's similar index
-            boost::multi_index::tag<ancestor_score>,
-            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
-            CompareTxMemPoolEntryByAncestorFee
-        >
-    >
-> indexed_modified_transaction_set;
-
-typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
-typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
-
-struct update_for_parent_inclusion
-{
-    explicit update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
-
-    void operator() (CTxMemPoolModifiedEntry &e)
+/**
+ * Buffers used to select packages. They are cleared, keeping their capacity,
+ * for every block, and are kept by the BlockTemplateCache in between so that
+ * building a template does not allocate once the buffers are large enough.
+ */
+struct PackageSelectionBuffers {
+    //! State of the entries looked at, indexed by CTxMemPoolEntry::m_block_slot
+    std::vector<PackageSlot> slots;
+    //! Heap of modified entries, best ancestor feerate first; may hold outdated entries
+    std::vector<CTxMemPoolModifiedEntry> modified;
+    //! The package being added, and the stack of the mempool graph walks
+    std::vector<CTxMemPool::txiter> package;
+    std::vector<CTxMemPool::txiter> stack;
+
+    void Clear()
     {
-        e.nModFeesWithAncestors -= iter->GetFee();
-        e.nSizeWithAncestors -= iter->GetTxSize();
-        e.nSigOpCostWithAncestors -= iter->GetSigOpCost();
+        slots.clear();
+        modified.clear();
+        package.clear();
+        stack.clear();
     }
+};
 
-    CTxMemPool::txiter iter;
+/** The largest number of mempool additions to queue up for a cached selection */
+static constexpr size_t MAX_TEMPLATE_CACHE_ADDED{10000};
+
+/**
+ * Keeps the transaction selection of the last block template, and the
+ * mempool additions since, so that the next template for the same tip can be
+ * assembled from them instead of going through the whole mempool again.
+ *
+ * The selection is dropped whenever the tip changes. While the block has room
+ * for more transactions, additions are appended and removals are skipped over
+ * when the selection is reused. Once the block is full, any change to the
+ * mempool may change which packages pay the most, so it is dropped as well.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+private:
+    const CTxMemPool& m_mempool;
+
+    mutable Mutex m_mutex;
+    //! Tip the selection was made on top of, null if there is no selection
+    uint256 m_tip GUARDED_BY(m_mutex);
+    //! Settings the selection was made with
+    unsigned int m_block_max_weight GUARDED_BY(m_mutex){0};
+    bool m_include_witness GUARDED_BY(m_mutex){false};
+    //! Whether packages were left out because the block was full
+    bool m_capacity_limited GUARDED_BY(m_mutex){false};
+    //! Earliest timestamp of a transaction left out for being too new
+    int64_t m_next_deferred_time GUARDED_BY(m_mutex){0};
+    //! Selected transactions, in block order
+    std::vector<uint256> m_selected GUARDED_BY(m_mutex);
+    //! Transactions added to the mempool since the selection was made
+    std::vector<uint256> m_added GUARDED_BY(m_mutex);
+    //! Buffers of the last package selection, to be reused by the next
+    PackageSelectionBuffers m_buffers GUARDED_BY(m_mutex);
+
+    void Invalidate() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    friend class BlockAssembler;
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override;
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+public:
+    explicit BlockTemplateCache(const CTxMemPool& mempool) : m_mempool(mempool) {}
+
+    const CTxMemPool& GetMemPool() const { return m_mempool; }
 };
 
 /** Generate a new block, without valid proof-of-work */
@@ -143,7 +197,12 @@ private:
     uint64_t nBlockTx;
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
-    CTxMemPool::setEntries inBlock;
+    //! Whether a package was left out because it did not fit
+    bool m_capacity_limited;
+
+    // State of the package selection
+    PackageSelectionBuffers m_buffers;
+    Epoch m_epoch;
 
     // Chain context for the block
     int nHeight;
@@ -181,26 +240,42 @@ private:
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics). */
     void addPackageTxs(int& nPackagesSelected, int& nDescendantsUpdated, uint32_t nTime) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Add the transactions selected for the last template on the same tip,
+      * followed by those added to the mempool since. Returns false, leaving
+      * the block as it was, if the selection can't be reused. */
+    bool addCachedPackageTxs(BlockTemplateCache& cache, const CBlockIndex* pindexPrev, uint32_t nTime) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Store the transactions added to the block, from index first_tx on, for the next template */
+    void storeSelection(BlockTemplateCache& cache, const CBlockIndex* pindexPrev, uint32_t nTime, size_t first_tx) const EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 
     // helper functions for addPackageTxs()
-    /** Remove confirmed (inBlock) entries from given set */
-    void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
+    /** Return the selection state of an entry, or nullptr if it has none yet */
+    PackageSlot* FindSlot(CTxMemPool::txiter it);
+    const PackageSlot* FindSlot(CTxMemPool::txiter it) const;
+    /** Return the index of the selection state of an entry, creating it if needed */
+    uint32_t GetSlot(CTxMemPool::txiter it);
+    /** Return true if the entry was added to the block */
+    bool InBlock(CTxMemPool::txiter it) const;
+    /** Return true if all in-mempool parents of the transaction are inBlock */
+    bool ParentsInBlock(CTxMemPool::txiter it) const EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Mark the transactions timestamped after time_limit, and their descendants, as failed */
+    void FailTxsNewerThan(int64_t time_limit) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
     /** Test if a new package would "fit" in the block */
     bool TestPackage(uint64_t packageSize, int64_t packageSigOpsCost) const;
     /** Perform checks on each transaction in a package:
       * locktime, premature-witness, serialized size (if necessary)
       * These checks should always succeed, and they're here
       * only as an extra check in case of suboptimal node configuration */
-    bool TestPackageTransactions(const CTxMemPool::setEntries& package, uint32_t nTime) const;
+    bool TestPackageTransactions(Span<const CTxMemPool::txiter> package, uint32_t nTime) const;
     /** Return true if given transaction from mapTx has already been evaluated,
       * or if the transaction's cached data in mapTx is incorrect. */
-    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
-    /** Sort the package in an order that is valid to appear in a block */
-    void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
-    /** Add descendants of given transactions to mapModifiedTx with ancestor
-      * state updated assuming given transactions are inBlock. Returns number
-      * of updated descendants. */
-    int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    bool SkipMapTxEntry(CTxMemPool::txiter it);
+    /** Collect the transaction and its ancestors not inBlock into m_buffers.package,
+      * in an order that is valid to appear in a block */
+    void CollectPackage(CTxMemPool::txiter it) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Add descendants of given transactions to the modified entries with
+      * ancestor state updated assuming given transactions are inBlock.
+      * Returns number of updated descendants. */
+    int UpdatePackagesForAdded(Span<const CTxMemPool::txiter> alreadyAdded) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 };
 
 /** Modify the extranonce in a block */
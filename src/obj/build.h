@@ -0,0 +1 @@
+#define BUILD_GIT_COMMIT "8db55be3f52d-dirty"
@@ -0,0 +1,97 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <policy/fees.h>
+
+#include <txmempool.h>
+
+#include <algorithm>
+
+namespace {
+/** Lower bounds of the feerate buckets, and the upper bound of the last one. Integer steps of
+ *  about 2^(1/4) keep the estimates identical on every node. */
+const std::array<CAmount, FeeEstimator::NUM_BUCKETS + 1> BUCKET_BOUNDS{[] {
+    std::array<CAmount, FeeEstimator::NUM_BUCKETS + 1> bounds;
+    bounds[0] = PERKB_TX_FEE;
+    for (size_t i = 1; i < bounds.size(); ++i) {
+        bounds[i] = bounds[i - 1] * 1189 / 1000;
+    }
+    return bounds;
+}()};
+
+size_t BucketIndex(CAmount fee_per_k)
+{
+    // Feerates below the first bound only come from transactions created before the current
+    // minimum fee rules; they fall into the first bucket, as do feerates above the last bound
+    // into the last one.
+    return std::upper_bound(BUCKET_BOUNDS.begin() + 1, BUCKET_BOUNDS.end() - 1, fee_per_k) - (BUCKET_BOUNDS.begin() + 1);
+}
+
+size_t EntryBucket(const CTxMemPoolEntry& entry)
+{
+    const int64_t vsize{std::max<int64_t>(entry.GetTxSize(), 1)};
+    return BucketIndex(entry.GetFee() * 1000 / vsize);
+}
+} // namespace
+
+FeeEstimator::FeeEstimator(int64_t block_max_vsize)
+    : m_block_max_vsize(block_max_vsize)
+{
+}
+
+void FeeEstimator::processTransaction(const CTxMemPoolEntry& entry)
+{
+    LOCK(m_cs_fee_estimator);
+    const size_t bucket{EntryBucket(entry)};
+    m_backlog_vsize[bucket] += entry.GetTxSize();
+    m_block_inflow[bucket] += entry.GetTxSize();
+}
+
+void FeeEstimator::removeTx(const CTxMemPoolEntry& entry)
+{
+    LOCK(m_cs_fee_estimator);
+    m_backlog_vsize[EntryBucket(entry)] -= entry.GetTxSize();
+}
+
+void FeeEstimator::processBlock(unsigned int nBlockHeight)
+{
+    LOCK(m_cs_fee_estimator);
+    // Blocks connected again after a reorg were already counted; their transactions' inflow
+    // is folded into the next new block instead.
+    if (nBlockHeight <= m_best_height) return;
+    m_best_height = nBlockHeight;
+
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        m_avg_inflow[i] += m_block_inflow[i] - m_avg_inflow[i] / INFLOW_DECAY;
+        m_block_inflow[i] = 0;
+    }
+}
+
+void FeeEstimator::ClearBacklog()
+{
+    LOCK(m_cs_fee_estimator);
+    m_backlog_vsize.fill(0);
+}
+
+CAmount FeeEstimator::EstimateFeePerK(unsigned int conf_target, bool conservative) const
+{
+    conf_target = std::clamp(conf_target, 1U, MAX_CONF_TARGET);
+    const int64_t block_space{int64_t{conf_target} * m_block_max_vsize};
+    const int64_t inflow_blocks{conservative ? conf_target : conf_target - 1};
+
+    LOCK(m_cs_fee_estimator);
+    // Walk down from the highest feerates. Once the transactions that pay more than a bucket's
+    // feerates no longer fit, a transaction has to pay more than that bucket to be included.
+    int64_t ahead{0};
+    for (size_t i = NUM_BUCKETS; i-- > 0;) {
+        ahead += m_backlog_vsize[i] + inflow_blocks * m_avg_inflow[i] / INFLOW_DECAY;
+        if (ahead > block_space) return BUCKET_BOUNDS[i + 1];
+    }
+    return BUCKET_BOUNDS[0];
+}
+
+CAmount FeeEstimator::BucketFloor(CAmount fee_per_k)
+{
+    return BUCKET_BOUNDS[BucketIndex(fee_per_k)];
+}
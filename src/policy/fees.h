@@ -0,0 +1,83 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POLICY_FEES_H
+#define BITCOIN_POLICY_FEES_H
+
+#include <consensus/amount.h>
+#include <sync.h>
+
+#include <array>
+#include <cstdint>
+
+class CTxMemPoolEntry;
+
+/**
+ * Estimates the fee per kvB a transaction needs to be included within a number
+ * of blocks.
+ *
+ * Fees are destroyed rather than paid to the block's creator, so there is no
+ * fee market to learn from confirmation times, and every transaction pays at
+ * least GetMinFee(), i.e. PERKB_TX_FEE per kvB. Above that, a higher feerate
+ * only moves a transaction ahead of the others when block assembly picks by
+ * feerate. The estimate therefore answers whether the mempool backlog that
+ * pays more, plus what is expected to arrive meanwhile, fits in the block
+ * space of the target.
+ *
+ * The mempool reports the transactions it adds and removes and the blocks it
+ * removes them for. The estimator keeps the virtual size of the backlog and a
+ * rolling average of the inflow per block, both bucketed by feerate, so an
+ * estimate is a single pass over a fixed number of buckets.
+ */
+class FeeEstimator
+{
+public:
+    /** Number of feerate buckets. Each bucket is about 2^(1/4) times as wide as the previous one,
+     *  starting at PERKB_TX_FEE. */
+    static constexpr size_t NUM_BUCKETS{64};
+    /** The rolling inflow average gives the last block a weight of 1 / INFLOW_DECAY. */
+    static constexpr int64_t INFLOW_DECAY{8};
+    /** Highest confirmation target that can be estimated for. */
+    static constexpr unsigned int MAX_CONF_TARGET{1008};
+
+    /** @param[in] block_max_vsize  The virtual size of the block space a block offers. */
+    explicit FeeEstimator(int64_t block_max_vsize);
+
+    /** Process a transaction added to the mempool. */
+    void processTransaction(const CTxMemPoolEntry& entry);
+
+    /** Process a transaction removed from the mempool, for any reason. */
+    void removeTx(const CTxMemPoolEntry& entry);
+
+    /** Process a block connected at the given height, after its transactions left the mempool. */
+    void processBlock(unsigned int nBlockHeight);
+
+    /** Forget the backlog, when the mempool is cleared. */
+    void ClearBacklog();
+
+    /**
+     * Estimate the fee per kvB to be included within conf_target blocks. A conservative estimate
+     * assumes all blocks of the target see the average inflow before the transaction is included,
+     * an economical one all but the last. Never below PERKB_TX_FEE.
+     */
+    CAmount EstimateFeePerK(unsigned int conf_target, bool conservative) const;
+
+    /** The lower bound of the feerate bucket a fee per kvB falls into. Exposed for testing. */
+    static CAmount BucketFloor(CAmount fee_per_k);
+
+private:
+    mutable Mutex m_cs_fee_estimator;
+
+    const int64_t m_block_max_vsize;
+    unsigned int m_best_height GUARDED_BY(m_cs_fee_estimator){0};
+
+    /** Virtual size of the mempool transactions in each bucket. */
+    std::array<int64_t, NUM_BUCKETS> m_backlog_vsize GUARDED_BY(m_cs_fee_estimator){};
+    /** Virtual size added to each bucket since the last block. */
+    std::array<int64_t, NUM_BUCKETS> m_block_inflow GUARDED_BY(m_cs_fee_estimator){};
+    /** Rolling average of the virtual size added to each bucket per block, times INFLOW_DECAY. */
+    std::array<int64_t, NUM_BUCKETS> m_avg_inflow GUARDED_BY(m_cs_fee_estimator){};
+};
+
+#endif // BITCOIN_POLICY_FEES_H
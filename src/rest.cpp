@@ -8,8 +8,10 @@
 #include <chainparams.h>
 #include <core_io.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/txindex.h>
+#include <key_io.h>
 #include <node/blockstorage.h>
 #include <node/context.h>
 #include <primitives/block.h>
@@ -919,6 +921,60 @@ static bool rest_blockhash_by_height(const std::any& context, HTTPRequest* req,
     }
 }
 
+static bool rest_address_history(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    // request is sent over URI scheme /rest/addresshistory/<address>/<skip>/<count>
+    std::vector<std::string> uri_parts;
+    boost::split(uri_parts, param, boost::is_any_of("/"));
+    if (uri_parts.size() != 3) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/addresshistory/<address>/<skip>/<count>");
+    }
+
+    const CTxDestination dest = DecodeDestination(uri_parts[0]);
+    if (!IsValidDestination(dest)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(uri_parts[0]));
+    }
+    int32_t skip, count;
+    if (!ParseInt32(uri_parts[1], &skip) || skip < 0) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid skip: " + SanitizeString(uri_parts[1]));
+    }
+    if (!ParseInt32(uri_parts[2], &count) || count < 0 || count > MAX_ADDRESS_HISTORY_COUNT) {
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Count must be between 0 and %d", MAX_ADDRESS_HISTORY_COUNT));
+    }
+
+    if (!g_address_index) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Address index is not enabled");
+    }
+    if (!g_address_index->BlockUntilSyncedToCurrentChain()) {
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Address history is still in the process of being indexed");
+    }
+    const IndexSummary summary{g_address_index->GetSummary()};
+
+    std::vector<AddressHistoryEntry> entries;
+    if (!g_address_index->FindScriptHistory(GetScriptForDestination(dest), skip, count, /*unspent_only=*/false, entries)) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read address history");
+    }
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        UniValue ret(UniValue::VOBJ);
+        ret.pushKV("height", summary.best_block_height);
+        ret.pushKV("bestblock", summary.best_block_hash.GetHex());
+        ret.pushKV("outputs", AddressHistoryToJSON(entries));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, ret.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(const std::any& context, HTTPRequest* req, const std::string& strReq);
@@ -934,6 +990,7 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/addresshistory/", rest_address_history},
 };
 
 void StartREST(const std::any& context)
@@ -16,6 +16,8 @@
 #include <deploymentinfo.h>
 #include <fs.h>
 #include <hash.h>
+#include <key_io.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
 #include <logging/timer.h>
@@ -480,64 +482,69 @@ static std::vector<RPCResult> MempoolEntryDescription() { return {
     RPCResult{RPCResult::Type::BOOL, "unbroadcast", "Whether this transaction is currently unbroadcast (initial broadcast not yet acknowledged by any peers)"},
 };}
 
-static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPoolEntry& e) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
+static void entryToJSON(UniValue& info, const MempoolEntrySummary& e)
 {
-    AssertLockHeld(pool.cs);
-
-    info.pushKV("vsize", (int)e.GetTxSize());
-    info.pushKV("weight", (int)e.GetTxWeight());
+    info.pushKV("vsize", e.vsize);
+    info.pushKV("weight", e.weight);
     // TODO: top-level fee fields are deprecated. deprecated_fee_fields_enabled blocks should be removed in v24
     const bool deprecated_fee_fields_enabled{IsDeprecatedRPCEnabled("fees")};
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("fee", ValueFromAmount(e.GetFee()));
-        info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
+        info.pushKV("fee", ValueFromAmount(e.fee));
+        info.pushKV("modifiedfee", ValueFromAmount(e.modified_fee));
     }
-    info.pushKV("time", count_seconds(e.GetTime()));
-    info.pushKV("height", (int)e.GetHeight());
-    info.pushKV("descendantcount", e.GetCountWithDescendants());
-    info.pushKV("descendantsize", e.GetSizeWithDescendants());
+    info.pushKV("time", count_seconds(e.time));
+    info.pushKV("height", (int)e.height);
+    info.pushKV("descendantcount", e.descendant_count);
+    info.pushKV("descendantsize", e.descendant_size);
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("descendantfees", e.GetModFeesWithDescendants());
+        info.pushKV("descendantfees", e.descendant_fees);
     }
-    info.pushKV("ancestorcount", e.GetCountWithAncestors());
-    info.pushKV("ancestorsize", e.GetSizeWithAncestors());
+    info.pushKV("ancestorcount", e.ancestor_count);
+    info.pushKV("ancestorsize", e.ancestor_size);
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
+        info.pushKV("ancestorfees", e.ancestor_fees);
     }
-    info.pushKV("wtxid", pool.vTxHashes[e.vTxHashesIdx].first.ToString());
+    info.pushKV("wtxid", e.wtxid.ToString());
 
     UniValue fees(UniValue::VOBJ);
-    fees.pushKV("base", ValueFromAmount(e.GetFee()));
-    fees.pushKV("modified", ValueFromAmount(e.GetModifiedFee()));
-    fees.pushKV("ancestor", ValueFromAmount(e.GetModFeesWithAncestors()));
-    fees.pushKV("descendant", ValueFromAmount(e.GetModFeesWithDescendants()));
+    fees.pushKV("base", ValueFromAmount(e.fee));
+    fees.pushKV("modified", ValueFromAmount(e.modified_fee));
+    fees.pushKV("ancestor", ValueFromAmount(e.ancestor_fees));
+    fees.pushKV("descendant", ValueFromAmount(e.descendant_fees));
     info.pushKV("fees", fees);
 
-    const CTransaction& tx = e.GetTx();
-    std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
-    {
-        if (pool.exists(GenTxid::Txid(txin.prevout.hash)))
-            setDepends.insert(txin.prevout.hash.ToString());
-    }
-
     UniValue depends(UniValue::VARR);
-    for (const std::string& dep : setDepends)
-    {
-        depends.push_back(dep);
+    for (const uint256& dep : e.depends) {
+        depends.push_back(dep.ToString());
     }
-
     info.pushKV("depends", depends);
 
     UniValue spent(UniValue::VARR);
-    const CTxMemPool::txiter& it = pool.mapTx.find(tx.GetHash());
-    const CTxMemPoolEntry::Children& children = it->GetMemPoolChildrenConst();
-    for (const CTxMemPoolEntry& child : children) {
-        spent.push_back(child.GetTx().GetHash().ToString());
+    for (const uint256& child : e.spent_by) {
+        spent.push_back(child.ToString());
     }
-
     info.pushKV("spentby", spent);
-    info.pushKV("unbroadcast", pool.IsUnbroadcastTx(tx.GetHash()));
+    info.pushKV("unbroadcast", e.unbroadcast);
+}
+
+static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPoolEntry& e) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
+{
+    AssertLockHeld(pool.cs);
+    entryToJSON(info, pool.SummarizeEntry(e));
+}
+
+/** Help note for the RPCs that may answer from a mempool snapshot. */
+static const std::string MEMPOOL_SNAPSHOT_NOTE{
+    "\nWith -mempoolsnapshotinterval, the result may lag changes to the mempool by up to twice that interval.\n"};
+
+/** The mempool snapshot RPC may answer from, or nullptr to read the mempool under its lock. */
+static std::shared_ptr<const MempoolSnapshot> GetMempoolSnapshot(const CTxMemPool& pool)
+{
+    // A snapshot is republished every interval while the mempool changes and readers poll it;
+    // allow for one missed publication before falling back to the mempool itself.
+    const int64_t interval{gArgs.GetIntArg("-mempoolsnapshotinterval", DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL)};
+    if (interval <= 0) return nullptr;
+    return pool.GetSnapshot(2 * std::chrono::milliseconds{interval});
 }
 
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempool_sequence)
@@ -546,8 +553,16 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempoo
         if (include_mempool_sequence) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbose results cannot contain mempool sequence values.");
         }
-        LOCK(pool.cs);
         UniValue o(UniValue::VOBJ);
+        if (const auto snapshot{GetMempoolSnapshot(pool)}) {
+            for (const MempoolEntrySummary& e : snapshot->entries) {
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(info, e);
+                o.__pushKV(e.txid.ToString(), info);
+            }
+            return o;
+        }
+        LOCK(pool.cs);
         for (const CTxMemPoolEntry& e : pool.mapTx) {
             const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
@@ -561,7 +576,13 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempoo
     } else {
         uint64_t mempool_sequence;
         std::vector<uint256> vtxid;
-        {
+        if (const auto snapshot{GetMempoolSnapshot(pool)}) {
+            vtxid.reserve(snapshot->entries.size());
+            for (const MempoolEntrySummary& e : snapshot->entries) {
+                vtxid.push_back(e.txid);
+            }
+            mempool_sequence = snapshot->sequence;
+        } else {
             LOCK(pool.cs);
             pool.queryHashes(vtxid);
             mempool_sequence = pool.GetSequence();
@@ -585,7 +606,8 @@ static RPCHelpMan getrawmempool()
 {
     return RPCHelpMan{"getrawmempool",
                 "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
-                "\nHint: use getmempoolentry to fetch a specific transaction from the mempool.\n",
+                "\nHint: use getmempoolentry to fetch a specific transaction from the mempool.\n" +
+                MEMPOOL_SNAPSHOT_NOTE,
                 {
                     {"verbose", RPCArg::Type::BOOL, RPCArg::Default{false}, "True for a json object, false for array of transaction ids"},
                     {"mempool_sequence", RPCArg::Type::BOOL, RPCArg::Default{false}, "If verbose=false, returns a json object with transaction list and mempool sequence number attached."},
@@ -763,7 +785,8 @@ static RPCHelpMan getmempooldescendants()
 static RPCHelpMan getmempoolentry()
 {
     return RPCHelpMan{"getmempoolentry",
-                "\nReturns mempool data for given transaction\n",
+                "\nReturns mempool data for given transaction\n" +
+                MEMPOOL_SNAPSHOT_NOTE,
                 {
                     {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The transaction id (must be in mempool)"},
                 },
@@ -778,6 +801,15 @@ static RPCHelpMan getmempoolentry()
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
     const CTxMemPool& mempool = EnsureAnyMemPool(request.context);
+    UniValue info(UniValue::VOBJ);
+    // A transaction missing from a snapshot may have arrived since it was taken.
+    if (const auto snapshot{GetMempoolSnapshot(mempool)}) {
+        if (const MempoolEntrySummary* e = snapshot->Find(hash)) {
+            entryToJSON(info, *e);
+            return info;
+        }
+    }
+
     LOCK(mempool.cs);
 
     CTxMemPool::txiter it = mempool.mapTx.find(hash);
@@ -785,9 +817,7 @@ static RPCHelpMan getmempoolentry()
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
-    UniValue info(UniValue::VOBJ);
-    entryToJSON(mempool, info, e);
+    entryToJSON(mempool, info, *it);
     return info;
 },
     };
@@ -1139,8 +1169,13 @@ static RPCHelpMan gettxoutsetinfo()
                         {RPCResult::Type::NUM, "disk_size", /*optional=*/true, "The estimated size of the chainstate on disk (not available when coinstatsindex is used)"},
                         {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount of coins in the UTXO set"},
                         {RPCResult::Type::STR_AMOUNT, "total_unspendable_amount", /*optional=*/true, "The total amount of coins permanently excluded from the UTXO set (only available if coinstatsindex is used)"},
+                        {RPCResult::Type::STR_AMOUNT, "stakeable_amount", /*optional=*/true, "The amount of coins old enough to stake at the time of this block (only available if coinstatsindex is used)"},
+                        {RPCResult::Type::NUM, "stake_coin_days", /*optional=*/true, "The coin-days of the UTXO set that count towards staking at the time of this block (only available if coinstatsindex is used)"},
                         {RPCResult::Type::OBJ, "block_info", /*optional=*/true, "Info on amounts in the block at this block height (only available if coinstatsindex is used)",
                         {
+                            {RPCResult::Type::STR_AMOUNT, "pow_reward", "Amount minted by this block if it is proof-of-work"},
+                            {RPCResult::Type::STR_AMOUNT, "pos_reward", "Amount minted by the coinstake of this block"},
+                            {RPCResult::Type::STR_AMOUNT, "fees_destroyed", "Total fees of the transactions in this block, which are destroyed"},
                             {RPCResult::Type::STR_AMOUNT, "prevout_spent", "Total amount of all prevouts spent in this block"},
                             {RPCResult::Type::STR_AMOUNT, "coinbase", "Coinbase subsidy amount of this block"},
                             {RPCResult::Type::STR_AMOUNT, "new_outputs_ex_coinbase", "Total amount of new outputs created by this block"},
@@ -1229,6 +1264,8 @@ static RPCHelpMan gettxoutsetinfo()
             ret.pushKV("disk_size", stats.nDiskSize);
         } else {
             ret.pushKV("total_unspendable_amount", ValueFromAmount(stats.total_unspendable_amount));
+            ret.pushKV("stakeable_amount", ValueFromAmount(stats.stakeable_amount));
+            ret.pushKV("stake_coin_days", stats.stake_coin_days);
 
             CCoinsStats prev_stats{hash_type};
 
@@ -1237,6 +1274,9 @@ static RPCHelpMan gettxoutsetinfo()
             }
 
             UniValue block_info(UniValue::VOBJ);
+            block_info.pushKV("pow_reward", ValueFromAmount(stats.total_pow_reward - prev_stats.total_pow_reward));
+            block_info.pushKV("pos_reward", ValueFromAmount(stats.total_pos_reward - prev_stats.total_pos_reward));
+            block_info.pushKV("fees_destroyed", ValueFromAmount(stats.total_fees_destroyed - prev_stats.total_fees_destroyed));
             block_info.pushKV("prevout_spent", ValueFromAmount(stats.total_prevout_spent_amount - prev_stats.total_prevout_spent_amount));
             block_info.pushKV("coinbase", ValueFromAmount(stats.total_coinbase_amount - prev_stats.total_coinbase_amount));
             block_info.pushKV("new_outputs_ex_coinbase", ValueFromAmount(stats.total_new_outputs_ex_coinbase_amount - prev_stats.total_new_outputs_ex_coinbase_amount));
@@ -1584,15 +1624,26 @@ static RPCHelpMan getchaintips()
 
 UniValue MempoolInfoToJSON(const CTxMemPool& pool)
 {
+    UniValue ret(UniValue::VOBJ);
+    size_t maxmempool = gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    if (const auto snapshot{GetMempoolSnapshot(pool)}) {
+        ret.pushKV("loaded", snapshot->loaded);
+        ret.pushKV("size", (int64_t)snapshot->entries.size());
+        ret.pushKV("bytes", (int64_t)snapshot->bytes);
+        ret.pushKV("usage", (int64_t)snapshot->usage);
+        ret.pushKV("total_fee", ValueFromAmount(snapshot->total_fee));
+        ret.pushKV("maxmempool", (int64_t) maxmempool);
+        ret.pushKV("unbroadcastcount", uint64_t{snapshot->unbroadcast_count});
+        return ret;
+    }
+
     // Make sure this call is atomic in the pool.
     LOCK(pool.cs);
-    UniValue ret(UniValue::VOBJ);
     ret.pushKV("loaded", pool.IsLoaded());
     ret.pushKV("size", (int64_t)pool.size());
     ret.pushKV("bytes", (int64_t)pool.GetTotalTxSize());
     ret.pushKV("usage", (int64_t)pool.DynamicMemoryUsage());
     ret.pushKV("total_fee", ValueFromAmount(pool.GetTotalFee()));
-    size_t maxmempool = gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     ret.pushKV("maxmempool", (int64_t) maxmempool);
     ret.pushKV("unbroadcastcount", uint64_t{pool.GetUnbroadcastTxs().size()});
     return ret;
@@ -1601,7 +1652,8 @@ UniValue MempoolInfoToJSON(const CTxMemPool& pool)
 static RPCHelpMan getmempoolinfo()
 {
     return RPCHelpMan{"getmempoolinfo",
-                "\nReturns details on the active state of the TX memory pool.\n",
+                "\nReturns details on the active state of the TX memory pool.\n" +
+                MEMPOOL_SNAPSHOT_NOTE,
                 {},
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
@@ -2186,6 +2238,40 @@ bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>&
     scan_progress = 100;
     return true;
 }
+
+//! Look up a given set of pubkey scripts in the address index instead of scanning the UTXO set
+bool FindScriptPubKeyIndexed(ChainstateManager& chainman, std::atomic<int>& scan_progress, const std::set<CScript>& needles, int64_t& count, std::map<COutPoint, Coin>& out_results, CBlockIndex*& tip)
+{
+    scan_progress = 0;
+    LOCK(cs_main);
+    CChainState& active_chainstate = chainman.ActiveChainstate();
+    tip = active_chainstate.m_chain.Tip();
+    CHECK_NONFATAL(tip);
+    // The index must have caught up with the tip for its unspent outputs to
+    // be those of the UTXO set. Blocks connected since the index synced make
+    // us fall back to a full scan.
+    if (g_address_index->GetSummary().best_block_hash != tip->GetBlockHash()) return false;
+
+    count = 0;
+    size_t scanned{0};
+    for (const CScript& script : needles) {
+        std::vector<AddressHistoryEntry> entries;
+        if (!g_address_index->FindScriptHistory(script, 0, std::numeric_limits<size_t>::max(), /*unspent_only=*/true, entries)) {
+            return false;
+        }
+        for (const AddressHistoryEntry& entry : entries) {
+            ++count;
+            const COutPoint outpoint{entry.txid, entry.vout};
+            Coin coin;
+            if (active_chainstate.CoinsTip().GetCoin(outpoint, coin) && coin.out.scriptPubKey == script) {
+                out_results.emplace(outpoint, std::move(coin));
+            }
+        }
+        // update progress reference after every script
+        scan_progress = (int)(++scanned * 100 / needles.size());
+    }
+    return true;
+}
 } // namespace
 
 /** RAII object to prevent concurrency issue when scanning the txout set */
@@ -2234,7 +2320,8 @@ static RPCHelpMan scantxoutset()
         "or more path elements separated by \"/\", and optionally ending in \"/*\" (unhardened), or \"/*'\" or \"/*h\" (hardened) to specify all\n"
         "unhardened or hardened child keys.\n"
         "In the latter case, a range needs to be specified by below if different from 1000.\n"
-        "For more information on output descriptors, see the documentation in the doc/descriptors.md file.\n",
+        "For more information on output descriptors, see the documentation in the doc/descriptors.md file.\n"
+        "When -addressindex is enabled and synced, the matching outputs are looked up in the index instead of scanning the whole set.\n",
         {
             {"action", RPCArg::Type::STR, RPCArg::Optional::NO, "The action to execute\n"
                 "\"start\" for starting a scan\n"
@@ -2261,7 +2348,7 @@ static RPCHelpMan scantxoutset()
             }},
             RPCResult{"When action=='start'", RPCResult::Type::OBJ, "", "", {
                 {RPCResult::Type::BOOL, "success", "Whether the scan was completed"},
-                {RPCResult::Type::NUM, "txouts", "The number of unspent transaction outputs scanned"},
+                {RPCResult::Type::NUM, "txouts", "The number of unspent transaction outputs scanned (or looked up in the address index)"},
                 {RPCResult::Type::NUM, "height", "The current block height (index)"},
                 {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at the tip of the chain"},
                 {RPCResult::Type::ARR, "unspents", "",
@@ -2343,17 +2430,24 @@ static RPCHelpMan scantxoutset()
         std::unique_ptr<CCoinsViewCursor> pcursor;
         CBlockIndex* tip;
         NodeContext& node = EnsureAnyNodeContext(request.context);
-        {
-            ChainstateManager& chainman = EnsureChainman(node);
-            LOCK(cs_main);
-            CChainState& active_chainstate = chainman.ActiveChainstate();
-            active_chainstate.ForceFlushStateToDisk();
-            pcursor = active_chainstate.CoinsDB().Cursor();
-            CHECK_NONFATAL(pcursor);
-            tip = active_chainstate.m_chain.Tip();
-            CHECK_NONFATAL(tip);
+        bool res;
+        if (g_address_index && g_address_index->BlockUntilSyncedToCurrentChain() &&
+            FindScriptPubKeyIndexed(EnsureChainman(node), g_scan_progress, needles, count, coins, tip)) {
+            res = true;
+        } else {
+            coins.clear();
+            {
+                ChainstateManager& chainman = EnsureChainman(node);
+                LOCK(cs_main);
+                CChainState& active_chainstate = chainman.ActiveChainstate();
+                active_chainstate.ForceFlushStateToDisk();
+                pcursor = active_chainstate.CoinsDB().Cursor();
+                CHECK_NONFATAL(pcursor);
+                tip = active_chainstate.m_chain.Tip();
+                CHECK_NONFATAL(tip);
+            }
+            res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins, node.rpc_interruption_point);
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins, node.rpc_interruption_point);
         result.pushKV("success", res);
         result.pushKV("txouts", count);
         result.pushKV("height", tip->nHeight);
@@ -2386,6 +2480,177 @@ static RPCHelpMan scantxoutset()
     };
 }
 
+static RPCHelpMan getsupplyinfo()
+{
+    return RPCHelpMan{"getsupplyinfo",
+                "\nReturns the coin supply and the stake statistics of the UTXO set at a block.\n"
+                "Requires coinstatsindex.\n",
+                {
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::DefaultHint{"the current best block"}, "The block hash or height of the target height.", "", {"", "string or numeric"}},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "height", "The block height (index) of the returned statistics"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at which these statistics are calculated"},
+                        {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount of coins in the UTXO set"},
+                        {RPCResult::Type::STR_AMOUNT, "pow_minted", "The total amount minted by proof-of-work blocks"},
+                        {RPCResult::Type::STR_AMOUNT, "pos_minted", "The total amount minted by coinstakes"},
+                        {RPCResult::Type::STR_AMOUNT, "fees_destroyed", "The total amount of transaction fees destroyed"},
+                        {RPCResult::Type::STR_AMOUNT, "stakeable_amount", "The amount of coins old enough to stake at the time of this block"},
+                        {RPCResult::Type::NUM, "stake_coin_days", "The coin-days of the UTXO set that count towards staking at the time of this block, with coin ages rounded to half a day"},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getsupplyinfo", "") +
+                    HelpExampleCli("getsupplyinfo", "1000") +
+                    HelpExampleRpc("getsupplyinfo", "1000")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (!g_coin_stats_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Querying supply information requires coinstatsindex");
+    }
+
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    const CBlockIndex* pindex;
+    if (request.params[0].isNull()) {
+        pindex = WITH_LOCK(::cs_main, return chainman.ActiveChain().Tip());
+    } else {
+        pindex = ParseHashOrHeight(request.params[0], chainman);
+    }
+
+    if (!g_coin_stats_index->BlockUntilSyncedToCurrentChain()) {
+        const IndexSummary summary{g_coin_stats_index->GetSummary()};
+        if (pindex->nHeight > summary.best_block_height) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because coinstatsindex is still syncing. Current height: %d", summary.best_block_height));
+        }
+    }
+
+    CCoinsStats stats{CoinStatsHashType::NONE};
+    if (!g_coin_stats_index->LookUpStats(pindex, stats)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read supply information");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("height", pindex->nHeight);
+    ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
+    ret.pushKV("total_amount", ValueFromAmount(stats.total_amount.value()));
+    ret.pushKV("pow_minted", ValueFromAmount(stats.total_pow_reward));
+    ret.pushKV("pos_minted", ValueFromAmount(stats.total_pos_reward));
+    ret.pushKV("fees_destroyed", ValueFromAmount(stats.total_fees_destroyed));
+    ret.pushKV("stakeable_amount", ValueFromAmount(stats.stakeable_amount));
+    ret.pushKV("stake_coin_days", stats.stake_coin_days);
+    return ret;
+},
+    };
+}
+
+UniValue AddressHistoryToJSON(const std::vector<AddressHistoryEntry>& entries)
+{
+    UniValue ret(UniValue::VARR);
+    for (const AddressHistoryEntry& entry : entries) {
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("txid", entry.txid.GetHex());
+        output.pushKV("vout", (int64_t)entry.vout);
+        output.pushKV("amount", ValueFromAmount(entry.value));
+        output.pushKV("height", entry.height);
+        if (entry.spent) {
+            UniValue spent(UniValue::VOBJ);
+            spent.pushKV("txid", entry.spent->txid.GetHex());
+            spent.pushKV("vin", (int64_t)entry.spent->vin);
+            spent.pushKV("height", entry.spent->height);
+            output.pushKV("spent", spent);
+        }
+        ret.push_back(output);
+    }
+    return ret;
+}
+
+static RPCHelpMan getaddresshistory()
+{
+    return RPCHelpMan{"getaddresshistory",
+                "\nReturns the outputs paying to an address or scriptPubKey, ordered by height, and the inputs that spent them.\n"
+                "Requires addressindex.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address, or the hex-encoded scriptPubKey"},
+                    {"skip", RPCArg::Type::NUM, RPCArg::Default{0}, "The number of outputs to skip"},
+                    {"count", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_ADDRESS_HISTORY_COUNT}, strprintf("The maximum number of outputs to return (at most %d)", MAX_ADDRESS_HISTORY_COUNT)},
+                    {"unspentonly", RPCArg::Type::BOOL, RPCArg::Default{false}, "Only return the outputs that are unspent in the indexed chain"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "height", "The height of the last block indexed"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the last block indexed"},
+                        {RPCResult::Type::ARR, "outputs", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                                {RPCResult::Type::NUM, "vout", "The output index"},
+                                {RPCResult::Type::STR_AMOUNT, "amount", "The value of the output in " + CURRENCY_UNIT},
+                                {RPCResult::Type::NUM, "height", "The height of the block that created the output"},
+                                {RPCResult::Type::OBJ, "spent", /*optional=*/true, "The input that spent the output",
+                                {
+                                    {RPCResult::Type::STR_HEX, "txid", "The id of the spending transaction"},
+                                    {RPCResult::Type::NUM, "vin", "The input index"},
+                                    {RPCResult::Type::NUM, "height", "The height of the block of the spending transaction"},
+                                }},
+                            }},
+                        }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getaddresshistory", "\"" + EXAMPLE_ADDRESS[0] + "\"") +
+                    HelpExampleCli("getaddresshistory", "\"" + EXAMPLE_ADDRESS[0] + "\" 100 50 true") +
+                    HelpExampleRpc("getaddresshistory", "\"" + EXAMPLE_ADDRESS[0] + "\", 100, 50")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (!g_address_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Querying address history requires addressindex");
+    }
+
+    const std::string& address = request.params[0].get_str();
+    CScript script;
+    const CTxDestination dest = DecodeDestination(address);
+    if (IsValidDestination(dest)) {
+        script = GetScriptForDestination(dest);
+    } else if (IsHex(address)) {
+        const std::vector<unsigned char> data(ParseHex(address));
+        script = CScript(data.begin(), data.end());
+    } else {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or scriptPubKey: " + address);
+    }
+
+    const int skip{request.params[1].isNull() ? 0 : request.params[1].get_int()};
+    const int count{request.params[2].isNull() ? DEFAULT_ADDRESS_HISTORY_COUNT : request.params[2].get_int()};
+    if (skip < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "skip must be non-negative");
+    }
+    if (count < 0 || count > MAX_ADDRESS_HISTORY_COUNT) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 0 and %d", MAX_ADDRESS_HISTORY_COUNT));
+    }
+    const bool unspent_only{request.params[3].isNull() ? false : request.params[3].get_bool()};
+
+    if (!g_address_index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because addressindex is still syncing. Current height: %d", g_address_index->GetSummary().best_block_height));
+    }
+    const IndexSummary summary{g_address_index->GetSummary()};
+
+    std::vector<AddressHistoryEntry> entries;
+    if (!g_address_index->FindScriptHistory(script, skip, count, unspent_only, entries)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read address history");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("height", summary.best_block_height);
+    ret.pushKV("bestblock", summary.best_block_hash.GetHex());
+    ret.pushKV("outputs", AddressHistoryToJSON(entries));
+    return ret;
+},
+    };
+}
+
 static RPCHelpMan getblockfilter()
 {
     return RPCHelpMan{"getblockfilter",
@@ -2618,6 +2883,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         &getrawmempool,                      },
     { "blockchain",         &gettxout,                           },
     { "blockchain",         &gettxoutsetinfo,                    },
+    { "blockchain",         &getsupplyinfo,                      },
+    { "blockchain",         &getaddresshistory,                  },
     { "blockchain",         &savemempool,                        },
     { "blockchain",         &verifychain,                        },
     { "blockchain",         &preciousblock,                      },
@@ -17,6 +17,7 @@
 
 extern RecursiveMutex cs_main;
 
+struct AddressHistoryEntry;
 class CBlock;
 class CBlockIndex;
 class CChainState;
@@ -27,6 +28,9 @@ struct NodeContext;
 } // namespace node
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
+/** Default and maximum number of outputs returned by one address history query */
+static constexpr int DEFAULT_ADDRESS_HISTORY_COUNT = 100;
+static constexpr int MAX_ADDRESS_HISTORY_COUNT = 1000;
 
 /**
  * Get the difficulty of the net wrt to the given block index.
@@ -51,6 +55,9 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false, bool includ
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
+/** Address index history entries to JSON */
+UniValue AddressHistoryToJSON(const std::vector<AddressHistoryEntry>& entries);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
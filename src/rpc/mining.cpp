@@ -16,6 +16,7 @@
 #include <net.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <policy/fees.h>
 #include <pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
@@ -1039,32 +1040,24 @@ static RPCHelpMan estimatesmartfee()
 {
     return RPCHelpMan{"estimatesmartfee",
         "\nEstimates the approximate fee per kilobyte needed for a transaction to begin\n"
-        "confirmation within conf_target blocks if possible and return the number of blocks\n"
-        "for which the estimate is valid. Uses virtual transaction size as defined\n"
-        "in BIP 141 (witness data is discounted).\n",
+        "confirmation within conf_target blocks. Fees are destroyed, so the estimate only\n"
+        "exceeds the minimum fee when the mempool backlog paying more, and the transactions\n"
+        "expected to arrive meanwhile, do not fit in the block space of conf_target blocks.\n"
+        "Uses virtual transaction size as defined in BIP 141 (witness data is discounted).\n",
         {
             {"conf_target", RPCArg::Type::NUM, RPCArg::Optional::NO, "Confirmation target in blocks (1 - 1008)"},
             {"estimate_mode", RPCArg::Type::STR, RPCArg::Default{"conservative"}, "The fee estimate mode.\n"
-            "                   Whether to return a more conservative estimate which also satisfies\n"
-            "                   a longer history. A conservative estimate potentially returns a\n"
-            "                   higher feerate and is more likely to be sufficient for the desired\n"
-            "                   target, but is not as responsive to short term drops in the\n"
-            "                   prevailing fee market. Must be one of (case insensitive):\n"
-             "\""},
+            "                   Whether to return a more conservative estimate which also counts\n"
+            "                   the transactions expected to arrive during the last block of the\n"
+            "                   target. Must be one of (case insensitive):\n"
+            "                   \"unset\", \"economical\", \"conservative\""},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
                     {
-                        {RPCResult::Type::NUM, "feerate", /*optional=*/true, "estimate fee rate in " + CURRENCY_UNIT + "/kvB (only present if no errors were encountered)"},
-                        {RPCResult::Type::ARR, "errors", /*optional=*/true, "Errors encountered during processing (if there are any)",
-                            {
-                                {RPCResult::Type::STR, "", "error"},
-                            }},
+                        {RPCResult::Type::NUM, "feerate", "estimate fee rate in " + CURRENCY_UNIT + "/kvB, at least the minimum fee"},
                         {RPCResult::Type::NUM, "blocks", "block number where estimate was found\n"
-            "The request target will be clamped between 2 and the highest target\n"
-            "fee estimation is able to return based on how long it has been running.\n"
-            "An error is returned if not enough transactions and blocks\n"
-            "have been observed to make an estimate for any number of blocks."},
+            "The request target will be clamped between 1 and 1008."},
                     }},
                 RPCExamples{
                     HelpExampleCli("estimatesmartfee", "6") +
@@ -1075,11 +1068,21 @@ static RPCHelpMan estimatesmartfee()
     RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR});
     RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
 
-    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    const FeeEstimator& fee_estimator = EnsureAnyFeeEstimator(request.context);
+    const unsigned int conf_target = std::clamp<int>(request.params[0].get_int(), 1, FeeEstimator::MAX_CONF_TARGET);
+    bool conservative = true;
+    if (!request.params[1].isNull()) {
+        const std::string mode{ToUpper(request.params[1].get_str())};
+        if (mode == "ECONOMICAL") {
+            conservative = false;
+        } else if (mode != "UNSET" && mode != "CONSERVATIVE") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid estimate_mode parameter, must be one of: \"unset\", \"economical\", \"conservative\"");
+        }
+    }
 
     UniValue result(UniValue::VOBJ);
-    result.pushKV("feerate", 0.01);
-    result.pushKV("blocks", chainman.ActiveChain().Height());
+    result.pushKV("feerate", ValueFromAmount(fee_estimator.EstimateFeePerK(conf_target, conservative)));
+    result.pushKV("blocks", (int)conf_target);
     return result;
 },
 };
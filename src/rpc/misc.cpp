@@ -3,7 +3,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <dbwrapper.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
 #include <index/txindex.h>
@@ -23,8 +25,10 @@
 #include <util/check.h>
 #include <util/message.h> // For MessageSign(), MessageVerify()
 #include <util/strencodings.h>
+#include <util/string.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <validation.h>
 
 #include <optional>
 #include <stdint.h>
@@ -800,6 +804,89 @@ static RPCHelpMan getindexinfo()
     };
 }
 
+static UniValue DBInfoToJSON(const CDBWrapper& db)
+{
+    const DBOptions& options = db.GetOptions();
+    UniValue entry(UniValue::VOBJ);
+    entry.pushKV("engine", DBEngineToString(options.engine));
+    entry.pushKV("cache_size", (uint64_t)options.cache_size);
+    if (options.engine == DBEngine::LEVELDB) {
+        entry.pushKV("block_cache_size", (uint64_t)options.block_cache_size);
+        entry.pushKV("write_buffer_size", (uint64_t)options.write_buffer_size);
+        entry.pushKV("bloom_bits", options.bloom_bits);
+        entry.pushKV("compression", options.compression);
+    }
+    entry.pushKV("memory_usage", (uint64_t)db.DynamicMemoryUsage());
+    entry.pushKV("stats", db.GetStats());
+    return entry;
+}
+
+static RPCHelpMan getdbinfo()
+{
+    return RPCHelpMan{"getdbinfo",
+                "\nReturns the configuration, memory usage and engine statistics of the node's databases.\n",
+                {
+                    {"db_name", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "Filter results for a database with a specific name (" + Join(SelectableDBNames(), ", ") + ")."},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ_DYN, "", "", {
+                        {
+                            RPCResult::Type::OBJ, "name", "The name of the database",
+                            {
+                                {RPCResult::Type::STR, "engine", "The storage engine (leveldb or mmap)"},
+                                {RPCResult::Type::NUM, "cache_size", "The memory budget of the database in bytes"},
+                                {RPCResult::Type::NUM, "block_cache_size", /*optional=*/true, "The size of the LevelDB block cache in bytes"},
+                                {RPCResult::Type::NUM, "write_buffer_size", /*optional=*/true, "The size of each LevelDB write buffer in bytes"},
+                                {RPCResult::Type::NUM, "bloom_bits", /*optional=*/true, "The bloom filter bits per key (0 if disabled)"},
+                                {RPCResult::Type::BOOL, "compression", /*optional=*/true, "Whether table blocks are compressed"},
+                                {RPCResult::Type::NUM, "memory_usage", "The approximate memory used by caches and write buffers in bytes"},
+                                {RPCResult::Type::STR, "stats", "The engine's statistics (leveldb.stats or mmapdb.stats)"},
+                            }
+                        },
+                    },
+                },
+                RPCExamples{
+                    HelpExampleCli("getdbinfo", "")
+                  + HelpExampleRpc("getdbinfo", "")
+                  + HelpExampleCli("getdbinfo", "chainstate")
+                  + HelpExampleRpc("getdbinfo", "chainstate")
+                },
+                [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    UniValue result(UniValue::VOBJ);
+    const std::string db_name = request.params[0].isNull() ? "" : request.params[0].get_str();
+    const auto add = [&](const std::string& name, const CDBWrapper& db) {
+        if (db_name.empty() || db_name == name) result.pushKV(name, DBInfoToJSON(db));
+    };
+
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    {
+        LOCK(cs_main);
+        add("chainstate", chainman.ActiveChainstate().CoinsDB().GetDB());
+        if (chainman.m_blockman.m_block_tree_db) add("blockindex", *chainman.m_blockman.m_block_tree_db);
+    }
+
+    if (g_txindex) {
+        add("txindex", g_txindex->GetDatabase());
+    }
+
+    if (g_coin_stats_index) {
+        add("coinstatsindex", g_coin_stats_index->GetDatabase());
+    }
+
+    if (g_address_index) {
+        add("addressindex", g_address_index->GetDatabase());
+    }
+
+    ForEachBlockFilterIndex([&](const BlockFilterIndex& index) {
+        add("blockfilterindex", index.GetDatabase());
+    });
+
+    return result;
+},
+    };
+}
+
 void RegisterMiscRPCCommands(CRPCTable &t)
 {
 // clang-format off
@@ -815,6 +902,7 @@ static const CRPCCommand commands[] =
     { "util",               &verifymessage,           },
     { "util",               &signmessagewithprivkey,  },
     { "util",               &getindexinfo,            },
+    { "util",               &getdbinfo,               },
 
     /* Not shown in help */
     { "hidden",             &setmocktime,             },
@@ -29,6 +29,8 @@ private:
      //! Entries are SHA256(nonce || 'E' or 'S' || 31 zero bytes || signature hash || public key || signature):
     CSHA256 m_salted_hasher_ecdsa;
     CSHA256 m_salted_hasher_schnorr;
+    //! peercoin: block signatures use 'B' so they never collide with transaction signatures
+    CSHA256 m_salted_hasher_block;
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
     std::shared_mutex cs_sigcache;
@@ -40,13 +42,16 @@ public:
         // We want the nonce to be 64 bytes long to force the hasher to process
         // this chunk, which makes later hash computations more efficient. We
         // just write our 32-byte entropy, and then pad with 'E' for ECDSA and
-        // 'S' for Schnorr (followed by 0 bytes).
+        // 'S' for Schnorr (followed by 0 bytes), or 'B' for block signatures.
         static constexpr unsigned char PADDING_ECDSA[32] = {'E'};
         static constexpr unsigned char PADDING_SCHNORR[32] = {'S'};
+        static constexpr unsigned char PADDING_BLOCK[32] = {'B'};
         m_salted_hasher_ecdsa.Write(nonce.begin(), 32);
         m_salted_hasher_ecdsa.Write(PADDING_ECDSA, 32);
         m_salted_hasher_schnorr.Write(nonce.begin(), 32);
         m_salted_hasher_schnorr.Write(PADDING_SCHNORR, 32);
+        m_salted_hasher_block.Write(nonce.begin(), 32);
+        m_salted_hasher_block.Write(PADDING_BLOCK, 32);
     }
 
     void
@@ -63,6 +68,13 @@ public:
         hasher.Write(hash.begin(), 32).Write(pubkey.data(), pubkey.size()).Write(sig.data(), sig.size()).Finalize(entry.begin());
     }
 
+    void
+    ComputeEntryBlock(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+    {
+        CSHA256 hasher = m_salted_hasher_block;
+        hasher.Write(hash.begin(), 32).Write(pubkey.data(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
     bool
     Get(const uint256& entry, const bool erase)
     {
@@ -124,3 +136,13 @@ bool CachingTransactionSignatureChecker::VerifySchnorrSignature(Span<const unsig
     if (store) signatureCache.Set(entry);
     return true;
 }
+
+bool VerifyBlockSignature(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    uint256 entry;
+    signatureCache.ComputeEntryBlock(entry, hash, vchSig, pubkey);
+    if (signatureCache.Get(entry, /*erase=*/false)) return true;
+    if (!pubkey.Verify(hash, vchSig)) return false;
+    signatureCache.Set(entry);
+    return true;
+}
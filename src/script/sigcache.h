@@ -35,4 +35,12 @@ public:
 
 void InitSignatureCache();
 
+/**
+ * peercoin: verify a block signature over the block hash, consulting the
+ * signature cache first. Valid signatures are added to the cache, so a block
+ * that is checked again (relayed by several peers, reconstructed from a
+ * compact block, or tested as a template) is only verified once.
+ */
+bool VerifyBlockSignature(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,118 @@
+// Copyright (c) 2020-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/addressindex.h>
+#include <node/blockstorage.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+
+using node::ReadBlockFromDisk;
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(addressindex_initial_sync, SyntheticChainSetup)
+{
+    const CScript coinbase_script{CScript() << OP_TRUE};
+    const CScript spend_script{CScript() << OP_2};
+    const CBlockIndex* fork{nullptr};
+    for (int i = 0; i < 10; ++i) {
+        fork = AppendBlock({}, coinbase_script);
+    }
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    spend.vout.emplace_back(49 * COIN, spend_script);
+    AppendBlock({spend}, coinbase_script);
+
+    AddressIndex address_index{1 << 20, true};
+    std::vector<AddressHistoryEntry> entries;
+
+    // BlockUntilSyncedToCurrentChain should return false before AddressIndex
+    // is started.
+    BOOST_CHECK(!address_index.BlockUntilSyncedToCurrentChain());
+
+    BOOST_REQUIRE(address_index.Start(m_chainstate));
+
+    // Allow the AddressIndex to catch up with the block index that is syncing
+    // in a background thread.
+    const auto timeout = GetTime<std::chrono::seconds>() + 120s;
+    while (!address_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(timeout > GetTime<std::chrono::milliseconds>());
+        UninterruptibleSleep(100ms);
+    }
+
+    // Every coinbase pays to the coinbase script, in height order. The first
+    // one is spent by the last block.
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 0, 1000, false, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        BOOST_CHECK(entries[i].txid == m_coinbase_txns[i]->GetHash());
+        BOOST_CHECK_EQUAL(entries[i].vout, 0U);
+        BOOST_CHECK_EQUAL(entries[i].value, 50 * COIN);
+        BOOST_CHECK_EQUAL(entries[i].spent.has_value(), i == 0);
+        if (i > 0) BOOST_CHECK(entries[i - 1].height < entries[i].height);
+    }
+    BOOST_REQUIRE(entries[0].spent);
+    BOOST_CHECK(entries[0].spent->txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(entries[0].spent->vin, 0U);
+    BOOST_CHECK_EQUAL(entries[0].spent->height, fork->nHeight + 1);
+
+    // Pagination returns the same outputs.
+    std::vector<AddressHistoryEntry> page;
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 2, 3, false, page));
+    BOOST_REQUIRE_EQUAL(page.size(), 3U);
+    BOOST_CHECK(page[0].txid == entries[2].txid);
+
+    // The spent coinbase is left out of the unspent outputs.
+    std::vector<AddressHistoryEntry> unspent;
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 0, 1000, true, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), entries.size() - 1);
+
+    std::vector<AddressHistoryEntry> spent_to;
+    BOOST_REQUIRE(address_index.FindScriptHistory(spend_script, 0, 1000, false, spent_to));
+    BOOST_REQUIRE_EQUAL(spent_to.size(), 1U);
+    BOOST_CHECK(spent_to[0].txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(spent_to[0].value, 49 * COIN);
+
+    // Replace the last block. The index rewinds it when it is told about the
+    // new one, erasing its outputs and spends.
+    {
+        LOCK2(::cs_main, m_node.mempool->cs);
+        BlockValidationState state;
+        BOOST_REQUIRE(m_chainstate.DisconnectTips(state, fork, nullptr));
+    }
+    const CScript fork_script{CScript() << OP_3};
+    const CBlockIndex* tip = AppendBlock({}, fork_script);
+    auto block{std::make_shared<CBlock>()};
+    BOOST_REQUIRE(ReadBlockFromDisk(*block, tip, Params().GetConsensus()));
+    GetMainSignals().BlockConnected(block, tip);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+
+    spent_to.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(spend_script, 0, 1000, false, spent_to));
+    BOOST_CHECK(spent_to.empty());
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 0, 1000, false, entries));
+    BOOST_CHECK_EQUAL(entries.size(), unspent.size());
+    for (const AddressHistoryEntry& entry : entries) {
+        BOOST_CHECK(!entry.spent);
+    }
+    std::vector<AddressHistoryEntry> fork_entries;
+    BOOST_REQUIRE(address_index.FindScriptHistory(fork_script, 0, 1000, false, fork_entries));
+    BOOST_REQUIRE_EQUAL(fork_entries.size(), 1U);
+    BOOST_CHECK(fork_entries[0].txid == block->vtx[0]->GetHash());
+    BOOST_CHECK_EQUAL(fork_entries[0].height, tip->nHeight);
+
+    // Shutdown sequence (c.f. Shutdown() in init.cpp)
+    address_index.Stop();
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include <serialize.h>
 #include <streams.h>
 #include <univalue.h>
+#include <util/golombrice.h>
 #include <util/strencodings.h>
 
 #include <boost/test/unit_test.hpp>
@@ -39,6 +40,36 @@ BOOST_AUTO_TEST_CASE(gcsfilter_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(golombrice_writer_reader)
+{
+    for (uint8_t P : {0, 1, 19, 63}) {
+        std::vector<uint64_t> values;
+        for (int i = 0; i < 200; ++i) {
+            // Mostly small quotients, with a few spanning several words.
+            const uint64_t quotient = i % 50 == 0 ? InsecureRandRange(200) : InsecureRandRange(4);
+            values.push_back((quotient << P) | InsecureRandBits(P));
+        }
+
+        std::vector<unsigned char> expected, encoded;
+        {
+            CVectorWriter stream(SER_NETWORK, 0, expected, 0);
+            BitStreamWriter<CVectorWriter> bitwriter(stream);
+            for (uint64_t value : values) GolombRiceEncode(bitwriter, P, value);
+        }
+        {
+            GolombRiceWriter writer(encoded);
+            for (uint64_t value : values) writer.Encode(P, value);
+        }
+        BOOST_CHECK(encoded == expected);
+
+        GolombRiceReader reader{encoded};
+        for (uint64_t value : values) {
+            BOOST_CHECK_EQUAL(reader.Decode(P), value);
+        }
+        BOOST_CHECK_EQUAL(reader.BytesConsumed(), encoded.size());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
 {
     GCSFilter filter;
@@ -54,7 +54,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -65,7 +65,11 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (erase) {
+                mapCoins.erase(it++);
+            } else {
+                ++it;
+            }
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -81,7 +85,7 @@ public:
     void SelfTest() const
     {
         // Manually recompute the dynamic usage of the whole data, and compare it.
-        size_t ret = memusage::DynamicUsage(cacheCoins);
+        size_t ret = memusage::DynamicUsage(cacheCoins) - m_cache_coins_memory_resource.FreeListBytes();
         size_t count = 0;
         for (const auto& entry : cacheCoins) {
             ret += entry.second.coin.DynamicMemoryUsage();
@@ -609,7 +613,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -878,4 +883,46 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_sync_trim)
+{
+    CCoinsViewTest base;
+    CCoinsViewCache cache{&base};
+    cache.SetBestBlock(InsecureRand256());
+
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        cache.AddCoin(outpoints.back(), Coin{CTxOut{i + 1, CScript() << OP_TRUE}, 1, false, false, 0}, false);
+    }
+    for (uint32_t i = 0; i < 100; ++i) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+
+    // Sync writes the changes but keeps the unspent coins resident and clean.
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 900U);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(base.GetCoin(outpoints[i], coin), i >= 100);
+        BOOST_CHECK_EQUAL(cache.HaveCoinInCache(outpoints[i]), i >= 100);
+    }
+
+    // Touch the last coins so that they are the most recently used, then
+    // trim the cache and check that they survived.
+    for (uint32_t i = 900; i < 1000; ++i) {
+        BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+    }
+    const size_t usage_before_trim = cache.DynamicMemoryUsage();
+    cache.Trim(usage_before_trim / 4);
+    BOOST_CHECK(cache.GetCacheSize() < 900U);
+    // The memory of the evicted entries stays in the pool for reuse, but is
+    // no longer counted as used.
+    BOOST_CHECK(cache.DynamicMemoryUsage() < usage_before_trim);
+    for (uint32_t i = 900; i < 1000; ++i) {
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[i]));
+    }
+    // Evicted coins can still be fetched from the base.
+    BOOST_CHECK(cache.HaveCoin(outpoints[100]));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chainparams.h>
 #include <index/coinstatsindex.h>
+#include <node/blockstorage.h>
 #include <test/util/setup_common.h>
 #include <util/time.h>
 #include <validation.h>
@@ -13,6 +15,7 @@
 
 using node::CCoinsStats;
 using node::CoinStatsHashType;
+using node::ReadBlockFromDisk;
 
 BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
 
@@ -78,4 +81,75 @@ BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
     // Rest of shutdown sequence and destructors happen in ~TestingSetup()
 }
 
+static void WaitUntilSynced(const CoinStatsIndex& index)
+{
+    const auto timeout = GetTime<std::chrono::seconds>() + 120s;
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(timeout > GetTime<std::chrono::milliseconds>());
+        UninterruptibleSleep(100ms);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_stake_ages_reorg, SyntheticChainSetup)
+{
+    const CScript op_true{CScript() << OP_TRUE};
+    constexpr int64_t day{24 * 60 * 60};
+    const CBlockIndex* first = AppendBlock({}, op_true);
+    // Coins old enough to stake, which the blocks after the fork spend. Only
+    // transactions before version 3 carry the time their outputs age from.
+    CMutableTransaction fan_out;
+    fan_out.nVersion = 1;
+    fan_out.nTime = first->nTime - 20 * day;
+    fan_out.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    fan_out.vout.assign(4, CTxOut{12 * COIN, op_true});
+    const CBlockIndex* fork = AppendBlock({fan_out}, op_true);
+    // Spend them into coins of other ages, so that the blocks after the fork
+    // move amounts between several age buckets.
+    for (uint32_t i = 0; i < 4; ++i) {
+        CMutableTransaction spend;
+        spend.nVersion = 1;
+        spend.nTime = fork->nTime - (i + 1) * 3 * day;
+        spend.vin.emplace_back(COutPoint(fan_out.GetHash(), i));
+        spend.vout.emplace_back(11 * COIN, op_true);
+        AppendBlock({spend}, op_true);
+    }
+
+    CoinStatsIndex reorged_index{1 << 20, true};
+    BOOST_REQUIRE(reorged_index.Start(m_chainstate));
+    WaitUntilSynced(reorged_index);
+
+    // Replace the blocks after the fork with one that spends nothing. The
+    // index rewinds them when it is told about the new block.
+    {
+        LOCK2(::cs_main, m_node.mempool->cs);
+        BlockValidationState state;
+        BOOST_REQUIRE(m_chainstate.DisconnectTips(state, fork, nullptr));
+    }
+    const CBlockIndex* tip = AppendBlock({}, CScript() << OP_2);
+    auto block{std::make_shared<CBlock>()};
+    BOOST_REQUIRE(ReadBlockFromDisk(*block, tip, Params().GetConsensus()));
+    GetMainSignals().BlockConnected(block, tip);
+    SyncWithValidationInterfaceQueue();
+
+    // Disconnecting the blocks must have undone their age bucket changes
+    // exactly, so the stake statistics match an index synced without them.
+    CoinStatsIndex synced_index{1 << 20, true};
+    BOOST_REQUIRE(synced_index.Start(m_chainstate));
+    WaitUntilSynced(synced_index);
+
+    CCoinsStats reorged_stats{CoinStatsHashType::MUHASH};
+    CCoinsStats synced_stats{CoinStatsHashType::MUHASH};
+    BOOST_REQUIRE(reorged_index.LookUpStats(tip, reorged_stats));
+    BOOST_REQUIRE(synced_index.LookUpStats(tip, synced_stats));
+    BOOST_CHECK_EQUAL(reorged_stats.hashSerialized, synced_stats.hashSerialized);
+    BOOST_CHECK(reorged_stats.total_amount == synced_stats.total_amount);
+    BOOST_CHECK_EQUAL(reorged_stats.stakeable_amount, synced_stats.stakeable_amount);
+    BOOST_CHECK_EQUAL(reorged_stats.stake_coin_days, synced_stats.stake_coin_days);
+    BOOST_CHECK(synced_stats.stake_coin_days > 0);
+
+    reorged_index.Stop();
+    synced_index.Stop();
+    SyncWithValidationInterfaceQueue();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <dbwrapper.h>
+#include <node/caches.h>
 #include <test/util/setup_common.h>
 #include <uint256.h>
 
@@ -278,42 +279,44 @@ BOOST_AUTO_TEST_CASE(existing_data_reindex)
 
 BOOST_AUTO_TEST_CASE(iterator_ordering)
 {
-    fs::path ph = m_args.GetDataDirBase() / "iterator_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
-    for (int x=0x00; x<256; ++x) {
-        uint8_t key = x;
-        uint32_t value = x*x;
-        if (!(x & 1)) BOOST_CHECK(dbw.Write(key, value));
-    }
+    for (const DBEngine engine : {DBEngine::LEVELDB, DBEngine::MMAP}) {
+        fs::path ph = m_args.GetDataDirBase() / "iterator_ordering";
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, engine);
+        for (int x=0x00; x<256; ++x) {
+            uint8_t key = x;
+            uint32_t value = x*x;
+            if (!(x & 1)) BOOST_CHECK(dbw.Write(key, value));
+        }
 
-    // Check that creating an iterator creates a snapshot
-    std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
+        // Check that creating an iterator creates a snapshot
+        std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
 
-    for (unsigned int x=0x00; x<256; ++x) {
-        uint8_t key = x;
-        uint32_t value = x*x;
-        if (x & 1) BOOST_CHECK(dbw.Write(key, value));
-    }
+        for (unsigned int x=0x00; x<256; ++x) {
+            uint8_t key = x;
+            uint32_t value = x*x;
+            if (x & 1) BOOST_CHECK(dbw.Write(key, value));
+        }
 
-    for (const int seek_start : {0x00, 0x80}) {
-        it->Seek((uint8_t)seek_start);
-        for (unsigned int x=seek_start; x<255; ++x) {
-            uint8_t key;
-            uint32_t value;
-            BOOST_CHECK(it->Valid());
-            if (!it->Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
-                break;
-            BOOST_CHECK(it->GetKey(key));
-            if (x & 1) {
-                BOOST_CHECK_EQUAL(key, x + 1);
-                continue;
+        for (const int seek_start : {0x00, 0x80}) {
+            it->Seek((uint8_t)seek_start);
+            for (unsigned int x=seek_start; x<255; ++x) {
+                uint8_t key;
+                uint32_t value;
+                BOOST_CHECK(it->Valid());
+                if (!it->Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
+                    break;
+                BOOST_CHECK(it->GetKey(key));
+                if (x & 1) {
+                    BOOST_CHECK_EQUAL(key, x + 1);
+                    continue;
+                }
+                BOOST_CHECK(it->GetValue(value));
+                BOOST_CHECK_EQUAL(key, x);
+                BOOST_CHECK_EQUAL(value, x*x);
+                it->Next();
             }
-            BOOST_CHECK(it->GetValue(value));
-            BOOST_CHECK_EQUAL(key, x);
-            BOOST_CHECK_EQUAL(value, x*x);
-            it->Next();
+            BOOST_CHECK(!it->Valid());
         }
-        BOOST_CHECK(!it->Valid());
     }
 }
 
@@ -358,46 +361,165 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 {
     char buf[10];
 
-    fs::path ph = m_args.GetDataDirBase() / "iterator_string_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
-    for (int x=0x00; x<10; ++x) {
-        for (int y = 0; y < 10; y++) {
-            snprintf(buf, sizeof(buf), "%d", x);
-            StringContentsSerializer key(buf);
-            for (int z = 0; z < y; z++)
-                key += key;
-            uint32_t value = x*x;
-            BOOST_CHECK(dbw.Write(key, value));
-        }
-    }
-
-    std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
-    for (const int seek_start : {0, 5}) {
-        snprintf(buf, sizeof(buf), "%d", seek_start);
-        StringContentsSerializer seek_key(buf);
-        it->Seek(seek_key);
-        for (unsigned int x=seek_start; x<10; ++x) {
+    for (const DBEngine engine : {DBEngine::LEVELDB, DBEngine::MMAP}) {
+        fs::path ph = m_args.GetDataDirBase() / "iterator_string_ordering";
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, engine);
+        for (int x=0x00; x<10; ++x) {
             for (int y = 0; y < 10; y++) {
                 snprintf(buf, sizeof(buf), "%d", x);
-                std::string exp_key(buf);
+                StringContentsSerializer key(buf);
                 for (int z = 0; z < y; z++)
-                    exp_key += exp_key;
-                StringContentsSerializer key;
-                uint32_t value;
-                BOOST_CHECK(it->Valid());
-                if (!it->Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
-                    break;
-                BOOST_CHECK(it->GetKey(key));
-                BOOST_CHECK(it->GetValue(value));
-                BOOST_CHECK_EQUAL(key.str, exp_key);
-                BOOST_CHECK_EQUAL(value, x*x);
-                it->Next();
+                    key += key;
+                uint32_t value = x*x;
+                BOOST_CHECK(dbw.Write(key, value));
             }
         }
-        BOOST_CHECK(!it->Valid());
+
+        std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
+        for (const int seek_start : {0, 5}) {
+            snprintf(buf, sizeof(buf), "%d", seek_start);
+            StringContentsSerializer seek_key(buf);
+            it->Seek(seek_key);
+            for (unsigned int x=seek_start; x<10; ++x) {
+                for (int y = 0; y < 10; y++) {
+                    snprintf(buf, sizeof(buf), "%d", x);
+                    std::string exp_key(buf);
+                    for (int z = 0; z < y; z++)
+                        exp_key += exp_key;
+                    StringContentsSerializer key;
+                    uint32_t value;
+                    BOOST_CHECK(it->Valid());
+                    if (!it->Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
+                        break;
+                    BOOST_CHECK(it->GetKey(key));
+                    BOOST_CHECK(it->GetValue(value));
+                    BOOST_CHECK_EQUAL(key.str, exp_key);
+                    BOOST_CHECK_EQUAL(value, x*x);
+                    it->Next();
+                }
+            }
+            BOOST_CHECK(!it->Valid());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mmap_engine_persistence)
+{
+    fs::path ph = m_args.GetDataDirBase() / "mmap_engine_persistence";
+    // Enough data to merge the buffered writes into the table several times.
+    const uint32_t count = 40000;
+    {
+        CDBWrapper dbw(ph, 0, false, true, true, DBEngine::MMAP);
+        for (uint32_t i = 0; i < count; i += 1000) {
+            CDBBatch batch(dbw);
+            for (uint32_t j = i; j < i + 1000; ++j) batch.Write(j, InsecureRand256());
+            BOOST_CHECK(dbw.WriteBatch(batch));
+        }
+        BOOST_CHECK(fs::exists(ph / "table.dat"));
+        // Leave some deletions and overwrites in the log only.
+        for (uint32_t i = 0; i < count; i += 3) BOOST_CHECK(dbw.Erase(i));
+        BOOST_CHECK(dbw.Write(uint32_t{1}, uint256::ONE));
+
+        // A snapshot keeps seeing the state at the time it was taken.
+        const auto snapshot = dbw.NewSnapshot();
+        BOOST_CHECK(dbw.Write(uint32_t{1}, uint256::ZERO));
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator(*snapshot));
+        it->Seek(uint32_t{1});
+        uint256 value;
+        BOOST_REQUIRE(it->Valid());
+        BOOST_CHECK(it->GetValue(value));
+        BOOST_CHECK_EQUAL(value, uint256::ONE);
+    }
+    // A torn write at the end of the log is dropped on reopen.
+    {
+        FILE* log = fsbridge::fopen(ph / "log.dat", "ab");
+        BOOST_REQUIRE(log);
+        fputs("torn", log);
+        fclose(log);
+    }
+    CDBWrapper dbw(ph, 0, false, false, true, DBEngine::MMAP);
+    uint256 value;
+    BOOST_CHECK(dbw.Read(uint32_t{1}, value));
+    BOOST_CHECK_EQUAL(value, uint256::ZERO);
+    for (uint32_t i = 2; i < count; ++i) {
+        BOOST_CHECK_EQUAL(dbw.Read(i, value), i % 3 != 0);
+    }
+    BOOST_CHECK(dbw.Write(uint32_t{0}, uint256::ONE));
+
+    // Iteration merges the table and the buffered writes, skipping deletions.
+    std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+    size_t seen = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) ++seen;
+    size_t expected = 2; // the obfuscation key and the rewritten key 0
+    for (uint32_t i = 1; i < count; ++i) expected += i % 3 != 0;
+    BOOST_CHECK_EQUAL(seen, expected);
+
+    std::string stats;
+    BOOST_CHECK(dbw.GetProperty("mmapdb.stats", stats));
+    BOOST_CHECK(!dbw.GetProperty("leveldb.stats", stats));
+}
+
+BOOST_AUTO_TEST_CASE(async_writes)
+{
+    for (const DBEngine engine : {DBEngine::LEVELDB, DBEngine::MMAP}) {
+        fs::path ph = m_args.GetDataDirBase() / ("dbwrapper_async_" + DBEngineToString(engine));
+        DBWriter writer;
+        SetDBWriter(&writer);
+        CDBWrapper dbw(ph, (1 << 20), false, true, true, engine);
+        SetDBWriter(nullptr);
+
+        // Queued batches are applied in order and visible to the next read.
+        for (uint32_t i = 0; i < 100; ++i) {
+            CDBBatch batch(dbw);
+            batch.Write(uint8_t{'k'}, i);
+            batch.Write(std::make_pair(uint8_t{'i'}, i), i);
+            BOOST_CHECK(dbw.WriteBatchAsync(batch));
+            BOOST_CHECK_EQUAL(batch.SizeEstimate(), 0U);
+        }
+        uint32_t res;
+        BOOST_CHECK(dbw.Read(uint8_t{'k'}, res));
+        BOOST_CHECK_EQUAL(res, 99U);
+
+        // A synchronous write after queued ones keeps their order.
+        CDBBatch batch(dbw);
+        batch.Erase(uint8_t{'k'});
+        BOOST_CHECK(dbw.WriteBatchAsync(batch));
+        BOOST_CHECK(dbw.Write(uint8_t{'k'}, uint32_t{1000}));
+        BOOST_CHECK(dbw.Read(uint8_t{'k'}, res));
+        BOOST_CHECK_EQUAL(res, 1000U);
+
+        BOOST_CHECK(dbw.SyncAsyncWrites());
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+        uint32_t count = 0;
+        for (it->Seek(std::make_pair(uint8_t{'i'}, uint32_t{0})); it->Valid(); it->Next()) {
+            std::pair<uint8_t, uint32_t> key;
+            if (!it->GetKey(key) || key.first != 'i') break;
+            BOOST_CHECK_EQUAL(key.second, count++);
+        }
+        BOOST_CHECK_EQUAL(count, 100U);
     }
 }
 
+BOOST_AUTO_TEST_CASE(db_options)
+{
+    BOOST_CHECK(node::IsValidDBOption("txindex:blockcache=80"));
+    BOOST_CHECK(node::IsValidDBOption("chainstate:compression=1"));
+    BOOST_CHECK(!node::IsValidDBOption("txindex:blockcache=101"));
+    BOOST_CHECK(!node::IsValidDBOption("txindex:nosuchoption=1"));
+    BOOST_CHECK(!node::IsValidDBOption("nosuchdb:bloombits=10"));
+    BOOST_CHECK(!node::IsValidDBOption("txindex"));
+
+    ArgsManager args;
+    args.ForceSetArg("-dboption", "txindex:blockcache=80");
+    const DBOptions txindex = node::GetDBOptions(args, "txindex", 1000);
+    BOOST_CHECK_EQUAL(txindex.block_cache_size, 800U);
+    BOOST_CHECK_EQUAL(txindex.write_buffer_size, 150U);
+    BOOST_CHECK_EQUAL(txindex.bloom_bits, 10);
+    const DBOptions chainstate = node::GetDBOptions(args, "chainstate", 1000);
+    BOOST_CHECK_EQUAL(chainstate.block_cache_size, 500U);
+    BOOST_CHECK_EQUAL(chainstate.write_buffer_size, 250U);
+}
+
 BOOST_AUTO_TEST_CASE(unicodepath)
 {
     // Attempt to create a database with a UTF8 character in the path.
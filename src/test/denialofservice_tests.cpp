@@ -23,6 +23,7 @@
 #include <validation.h>
 
 #include <array>
+#include <limits>
 #include <stdint.h>
 
 #include <boost/test/unit_test.hpp>
@@ -445,6 +446,8 @@ public:
     }
 };
 
+static constexpr size_t NO_ORPHAN_SIZE_LIMIT{std::numeric_limits<size_t>::max()};
+
 static void MakeNewKeyWithFastRandomContext(CKey& key)
 {
     std::vector<unsigned char> keydata;
@@ -536,11 +539,11 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 
     // Test LimitOrphanTxSize() function:
-    orphanage.LimitOrphans(40);
+    orphanage.LimitOrphans(40, NO_ORPHAN_SIZE_LIMIT, NO_ORPHAN_SIZE_LIMIT);
     BOOST_CHECK(orphanage.CountOrphans() <= 40);
-    orphanage.LimitOrphans(10);
+    orphanage.LimitOrphans(10, NO_ORPHAN_SIZE_LIMIT, NO_ORPHAN_SIZE_LIMIT);
     BOOST_CHECK(orphanage.CountOrphans() <= 10);
-    orphanage.LimitOrphans(0);
+    orphanage.LimitOrphans(0, NO_ORPHAN_SIZE_LIMIT, NO_ORPHAN_SIZE_LIMIT);
     BOOST_CHECK(orphanage.CountOrphans() == 0);
 }
 
@@ -123,4 +123,86 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_map)
+{
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "a", 16 * 1024);
+
+    std::string line1("first line");
+    std::string line2("second line");
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0)), SER_DISK, CLIENT_VERSION);
+        file << LIMITED_STRING(line1, 256) << LIMITED_STRING(line2, 256);
+    }
+
+    // Missing and empty files are not mapped.
+    BOOST_CHECK(!seq.Map(FlatFilePos()));
+    BOOST_CHECK(!seq.Map(FlatFilePos(1, 0)));
+    fclose(seq.Open(FlatFilePos(2, 0)));
+    BOOST_CHECK(!seq.Map(FlatFilePos(2, 0)));
+
+#ifndef WIN32
+    const auto mapping{seq.Map(FlatFilePos(0, 0))};
+    BOOST_REQUIRE(mapping);
+    BOOST_CHECK_EQUAL(mapping->Data().size(), fs::file_size(seq.FileName(FlatFilePos(0, 0))));
+
+    // Skip the first line and read the second one straight from the mapping.
+    std::string text;
+    SpanReader reader{SER_DISK, CLIENT_VERSION, mapping->Data()};
+    reader.ignore(GetSerializeSize(line1, CLIENT_VERSION));
+    reader >> LIMITED_STRING(text, 256);
+    BOOST_CHECK_EQUAL(text, line2);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader.ignore(1), std::ios_base::failure);
+#endif
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(flatfile_compressed)
+{
+    const auto data_dir = m_args.GetDataDirBase();
+    const fs::path path = data_dir / "compressed.dat";
+
+    // Repetitive text followed by random bytes, which are stored uncompressed.
+    std::vector<unsigned char> data;
+    for (int i = 0; i < 1000; ++i) {
+        const std::string line = strprintf("line %d of a rather repetitive file\n", i);
+        data.insert(data.end(), line.begin(), line.end());
+    }
+    const size_t text_size = data.size();
+    const std::vector<unsigned char> noise = g_insecure_rand_ctx.randbytes(5000);
+    data.insert(data.end(), noise.begin(), noise.end());
+
+    // Frame boundaries must be increasing and cover the data.
+    BOOST_CHECK(!CompressedFlatFile::Write(path, data, {100, 100, data.size()}));
+    BOOST_CHECK(!CompressedFlatFile::Write(path, data, {100}));
+
+    const std::vector<size_t> frame_ends{100, text_size, data.size()};
+    BOOST_REQUIRE(CompressedFlatFile::Write(path, data, frame_ends));
+    const auto file = CompressedFlatFile::Open(path);
+    BOOST_REQUIRE(file);
+    BOOST_CHECK_EQUAL(file->Size(), data.size());
+    BOOST_CHECK(file->DataSize() < data.size());
+
+    std::vector<unsigned char> frame;
+    uint64_t frame_pos;
+    size_t start = 0;
+    for (const size_t end : frame_ends) {
+        // Any position within a frame decodes the whole frame.
+        for (const size_t pos : {start, (start + end) / 2, end - 1}) {
+            BOOST_REQUIRE(file->ReadFrame(pos, frame, frame_pos));
+            BOOST_CHECK_EQUAL(frame_pos, start);
+            BOOST_CHECK(frame == std::vector<unsigned char>(data.begin() + start, data.begin() + end));
+        }
+        start = end;
+    }
+    BOOST_CHECK(!file->ReadFrame(data.size(), frame, frame_pos));
+
+    // Missing, truncated or corrupt files are rejected.
+    BOOST_CHECK(!CompressedFlatFile::Open(data_dir / "missing.dat"));
+    fs::resize_file(path, fs::file_size(path) - 1);
+    BOOST_CHECK(!CompressedFlatFile::Open(path));
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
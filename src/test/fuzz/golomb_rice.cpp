@@ -15,6 +15,7 @@
 #include <cassert>
 #include <cstdint>
 #include <iosfwd>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
@@ -78,6 +79,25 @@ FUZZ_TARGET(golomb_rice)
 
     assert(encoded_deltas == decoded_deltas);
 
+    {
+        std::vector<uint8_t> word_encoded;
+        CVectorWriter stream(SER_NETWORK, 0, word_encoded, 0);
+        WriteCompactSize(stream, static_cast<uint32_t>(encoded_deltas.size()));
+        GolombRiceWriter writer(word_encoded);
+        for (const uint64_t delta : encoded_deltas) {
+            writer.Encode(BASIC_FILTER_P, delta);
+        }
+        writer.Flush();
+        assert(word_encoded == golomb_rice_data);
+
+        SpanReader size_stream{SER_NETWORK, 0, golomb_rice_data};
+        (void)ReadCompactSize(size_stream);
+        GolombRiceReader reader{Span{golomb_rice_data}.last(size_stream.size())};
+        for (const uint64_t delta : encoded_deltas) {
+            assert(reader.Decode(BASIC_FILTER_P) == delta);
+        }
+    }
+
     {
         const std::vector<uint8_t> random_bytes = ConsumeRandomLengthByteVector(fuzzed_data_provider, 1024);
         SpanReader stream{SER_NETWORK, 0, random_bytes};
@@ -88,11 +108,20 @@ FUZZ_TARGET(golomb_rice)
             return;
         }
         BitStreamReader<SpanReader> bitreader{stream};
+        GolombRiceReader reader{Span{random_bytes}.last(stream.size())};
         for (uint32_t i = 0; i < std::min<uint32_t>(n, 1024); ++i) {
+            std::optional<uint64_t> expected;
+            try {
+                expected = GolombRiceDecode(bitreader, BASIC_FILTER_P);
+            } catch (const std::ios_base::failure&) {
+            }
+            std::optional<uint64_t> decoded;
             try {
-                (void)GolombRiceDecode(bitreader, BASIC_FILTER_P);
+                decoded = reader.Decode(BASIC_FILTER_P);
             } catch (const std::ios_base::failure&) {
             }
+            assert(decoded == expected);
+            if (!expected) break;
         }
     }
 }
@@ -107,6 +107,7 @@ const std::vector<std::string> RPC_COMMANDS_SAFE_FOR_FUZZING{
     "generate",
     "generateblock",
     "getaddednodeinfo",
+    "getaddresshistory",
     "getbestblockhash",
     "getblock",
     "getblockchaininfo",
@@ -120,6 +121,7 @@ const std::vector<std::string> RPC_COMMANDS_SAFE_FOR_FUZZING{
     "getchaintips",
     "getchaintxstats",
     "getconnectioncount",
+    "getdbinfo",
     "getdeploymentinfo",
     "getdescriptorinfo",
     "getdifficulty",
@@ -138,6 +140,7 @@ const std::vector<std::string> RPC_COMMANDS_SAFE_FOR_FUZZING{
     "getrawmempool",
     "getrawtransaction",
     "getrpcinfo",
+    "getsupplyinfo",
     "gettxout",
     "gettxoutsetinfo",
     "help",
@@ -5,6 +5,7 @@
 #include <clientversion.h>
 #include <crypto/siphash.h>
 #include <hash.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <util/strencodings.h>
 
@@ -120,6 +121,20 @@ BOOST_AUTO_TEST_CASE(siphash)
         hasher3.Write(uint64_t(x)|(uint64_t(x+1)<<8)|(uint64_t(x+2)<<16)|(uint64_t(x+3)<<24)|
                      (uint64_t(x+4)<<32)|(uint64_t(x+5)<<40)|(uint64_t(x+6)<<48)|(uint64_t(x+7)<<56));
     }
+    // Check test vectors from spec, all prefixes at once
+    unsigned char data[std::size(siphash_4_2_testvec)];
+    std::vector<Span<const unsigned char>> prefixes;
+    for (uint8_t x=0; x<std::size(siphash_4_2_testvec); ++x)
+    {
+        data[x] = x;
+        prefixes.emplace_back(data, x);
+    }
+    uint64_t hashes[std::size(siphash_4_2_testvec)];
+    SipHashMany(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, prefixes, hashes);
+    for (uint8_t x=0; x<std::size(siphash_4_2_testvec); ++x)
+    {
+        BOOST_CHECK_EQUAL(hashes[x], siphash_4_2_testvec[x]);
+    }
 
     CHashWriter ss(SER_DISK, CLIENT_VERSION);
     CMutableTransaction tx;
@@ -148,4 +163,31 @@ BOOST_AUTO_TEST_CASE(siphash)
     }
 }
 
+BOOST_AUTO_TEST_CASE(hashed_writer)
+{
+    const std::vector<unsigned char> data{ParseHex("00112233445566778899aabbccddeeff")};
+    const std::string text{"mempool.dat"};
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    CHashedWriter<CDataStream> writer(&stream);
+    writer << uint64_t{2} << data << text;
+    const uint256 written{writer.GetHash()};
+
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    hasher << uint64_t{2} << data << text;
+    BOOST_CHECK_EQUAL(written, hasher.GetHash());
+
+    // Reading the data back through a CHashVerifier gives the same hash
+    CHashVerifier<CDataStream> verifier(&stream);
+    uint64_t version;
+    std::vector<unsigned char> data_read;
+    std::string text_read;
+    verifier >> version >> data_read >> text_read;
+    BOOST_CHECK_EQUAL(version, 2U);
+    BOOST_CHECK(data_read == data);
+    BOOST_CHECK_EQUAL(text_read, text);
+    BOOST_CHECK(stream.empty());
+    BOOST_CHECK_EQUAL(verifier.GetHash(), written);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
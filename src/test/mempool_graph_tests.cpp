@@ -0,0 +1,152 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <txmempool.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+
+BOOST_FIXTURE_TEST_SUITE(mempool_graph_tests, BasicTestingSetup)
+
+static constexpr uint64_t NO_LIMIT{std::numeric_limits<uint64_t>::max()};
+
+static CTransactionRef MakeTransaction(const std::vector<COutPoint>& prevouts, size_t num_outputs)
+{
+    CMutableTransaction tx;
+    for (const COutPoint& prevout : prevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptSig = CScript() << OP_11;
+    }
+    tx.vout.resize(num_outputs);
+    for (CTxOut& out : tx.vout) {
+        out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        out.nValue = COIN;
+    }
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(Links)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+    const size_t empty_usage{pool.DynamicMemoryUsage()};
+
+    // One parent with more children than the links keep inline.
+    const CTransactionRef parent{MakeTransaction({COutPoint{uint256::ONE, 0}}, 5)};
+    pool.addUnchecked(entry.FromTx(parent));
+    std::vector<CTransactionRef> block{parent};
+    for (uint32_t n = 0; n < 5; ++n) {
+        const CTransactionRef child{MakeTransaction({COutPoint{parent->GetHash(), n}}, 1)};
+        pool.addUnchecked(entry.FromTx(child));
+        block.push_back(child);
+    }
+    const auto parent_it{*pool.GetIter(parent->GetHash())};
+    const CTxMemPoolEntry::Children& children{parent_it->GetMemPoolChildrenConst()};
+    BOOST_CHECK_EQUAL(children.size(), 5U);
+    BOOST_CHECK(std::is_sorted(children.begin(), children.end(), [](const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) {
+        return a.GetTx().GetHash() < b.GetTx().GetHash();
+    }));
+    for (size_t i = 1; i < block.size(); ++i) {
+        const auto child_it{*pool.GetIter(block[i]->GetHash())};
+        BOOST_CHECK(children.contains(*child_it));
+        BOOST_CHECK_EQUAL(child_it->GetMemPoolParentsConst().size(), 1U);
+        BOOST_CHECK(child_it->GetMemPoolParentsConst().contains(*parent_it));
+    }
+    BOOST_CHECK_EQUAL(parent_it->GetCountWithDescendants(), 6U);
+
+    // The link memory is accounted for as it grows and shrinks. vTxHashes keeps its capacity.
+    pool.removeForBlock(block, 1);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage() - memusage::DynamicUsage(pool.vTxHashes), empty_usage);
+}
+
+BOOST_AUTO_TEST_CASE(LongChain)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    std::vector<CTransactionRef> chain;
+    COutPoint prevout{uint256::ONE, 0};
+    for (int i = 0; i < 200; ++i) {
+        chain.push_back(MakeTransaction({prevout}, 1));
+        pool.addUnchecked(entry.FromTx(chain.back()));
+        prevout = COutPoint{chain.back()->GetHash(), 0};
+    }
+
+    const auto head{*pool.GetIter(chain.front()->GetHash())};
+    const auto tail{*pool.GetIter(chain.back()->GetHash())};
+    BOOST_CHECK_EQUAL(head->GetCountWithDescendants(), 200U);
+    BOOST_CHECK_EQUAL(tail->GetCountWithAncestors(), 200U);
+
+    CTxMemPool::setEntries ancestors;
+    std::string err;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(*tail, ancestors, NO_LIMIT, NO_LIMIT, NO_LIMIT, NO_LIMIT, err, false));
+    BOOST_CHECK_EQUAL(ancestors.size(), 199U);
+    BOOST_CHECK(!ancestors.count(tail));
+
+    // Limits are still enforced while walking.
+    ancestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(*tail, ancestors, 100, NO_LIMIT, NO_LIMIT, NO_LIMIT, err, false));
+    BOOST_CHECK_EQUAL(err, "too many unconfirmed ancestors [limit: 100]");
+
+    CTxMemPool::setEntries descendants;
+    pool.CalculateDescendants(head, descendants);
+    BOOST_CHECK_EQUAL(descendants.size(), 200U);
+
+    // Mining the first half updates the ancestor state of the rest.
+    pool.removeForBlock({chain.begin(), chain.begin() + 100}, 1);
+    BOOST_CHECK_EQUAL(pool.size(), 100U);
+    BOOST_CHECK_EQUAL(tail->GetCountWithAncestors(), 100U);
+}
+
+BOOST_AUTO_TEST_CASE(DiamondFromBlock)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    // top is spent by left and right, which are both spent by bottom.
+    const CTransactionRef top{MakeTransaction({COutPoint{uint256::ONE, 0}}, 2)};
+    const CTransactionRef left{MakeTransaction({COutPoint{top->GetHash(), 0}}, 1)};
+    const CTransactionRef right{MakeTransaction({COutPoint{top->GetHash(), 1}}, 1)};
+    const CTransactionRef bottom{MakeTransaction({COutPoint{left->GetHash(), 0}, COutPoint{right->GetHash(), 0}}, 1)};
+
+    // top comes back from a disconnected block after its descendants entered the mempool.
+    pool.addUnchecked(entry.FromTx(left));
+    pool.addUnchecked(entry.FromTx(right));
+    pool.addUnchecked(entry.FromTx(bottom));
+    pool.addUnchecked(entry.FromTx(top));
+    pool.UpdateTransactionsFromBlock({top->GetHash()}, NO_LIMIT, NO_LIMIT);
+
+    const auto top_it{*pool.GetIter(top->GetHash())};
+    const auto bottom_it{*pool.GetIter(bottom->GetHash())};
+    BOOST_CHECK_EQUAL(top_it->GetMemPoolChildrenConst().size(), 2U);
+    BOOST_CHECK_EQUAL(top_it->GetCountWithDescendants(), 4U);
+    BOOST_CHECK_EQUAL(bottom_it->GetCountWithAncestors(), 4U);
+    BOOST_CHECK_EQUAL(bottom_it->GetMemPoolParentsConst().size(), 2U);
+
+    CTxMemPool::setEntries ancestors;
+    std::string err;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(*bottom_it, ancestors, NO_LIMIT, NO_LIMIT, NO_LIMIT, NO_LIMIT, err));
+    BOOST_CHECK_EQUAL(ancestors.size(), 3U);
+    BOOST_CHECK(ancestors.count(top_it));
+
+    size_t num_ancestors, num_descendants;
+    pool.GetTransactionAncestry(bottom->GetHash(), num_ancestors, num_descendants);
+    BOOST_CHECK_EQUAL(num_ancestors, 4U);
+    BOOST_CHECK_EQUAL(num_descendants, 4U);
+
+    // A package spending bottom counts each ancestor once.
+    const Package package{MakeTransaction({COutPoint{bottom->GetHash(), 0}}, 1)};
+    BOOST_CHECK(pool.CheckPackageLimits(package, 5, NO_LIMIT, NO_LIMIT, NO_LIMIT, err));
+    BOOST_CHECK(!pool.CheckPackageLimits(package, 4, NO_LIMIT, NO_LIMIT, NO_LIMIT, err));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
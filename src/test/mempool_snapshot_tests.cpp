@@ -0,0 +1,114 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txmempool.h>
+#include <util/time.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mempool_snapshot_tests, BasicTestingSetup)
+
+static CTransactionRef MakeTransaction(const COutPoint& prevout)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = COIN;
+    tx.vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[1].nValue = COIN;
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(PublishAndAge)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    SetMockTime(1000s);
+
+    // Nothing is published until a reader asks for it.
+    pool.PublishSnapshot();
+    BOOST_CHECK(!pool.GetSnapshot(1h));
+
+    const CTransactionRef parent{MakeTransaction(COutPoint{uint256::ONE, 0})};
+    const CTransactionRef child{MakeTransaction(COutPoint{parent->GetHash(), 1})};
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(10000).FromTx(parent));
+        pool.addUnchecked(entry.Fee(20000).FromTx(child));
+    }
+    pool.AddUnbroadcastTx(child->GetHash());
+    pool.PublishSnapshot();
+
+    const auto snapshot{pool.GetSnapshot(0ms)};
+    BOOST_REQUIRE(snapshot);
+    BOOST_CHECK_EQUAL(snapshot->entries.size(), 2U);
+    BOOST_CHECK(snapshot->entries[0].txid == parent->GetHash());
+    BOOST_CHECK_EQUAL(snapshot->total_fee, 30000);
+    BOOST_CHECK_EQUAL(snapshot->unbroadcast_count, 1U);
+    {
+        LOCK(pool.cs);
+        BOOST_CHECK_EQUAL(snapshot->bytes, pool.GetTotalTxSize());
+        BOOST_CHECK_EQUAL(snapshot->sequence, pool.GetSequence());
+    }
+
+    const MempoolEntrySummary* parent_summary{snapshot->Find(parent->GetHash())};
+    BOOST_REQUIRE(parent_summary);
+    BOOST_CHECK(parent_summary->depends.empty());
+    BOOST_REQUIRE_EQUAL(parent_summary->spent_by.size(), 1U);
+    BOOST_CHECK(parent_summary->spent_by[0] == child->GetHash());
+    BOOST_CHECK_EQUAL(parent_summary->descendant_count, 2U);
+    BOOST_CHECK_EQUAL(parent_summary->descendant_fees, 30000);
+    BOOST_CHECK(!parent_summary->unbroadcast);
+
+    const MempoolEntrySummary* child_summary{snapshot->Find(child->GetHash())};
+    BOOST_REQUIRE(child_summary);
+    BOOST_REQUIRE_EQUAL(child_summary->depends.size(), 1U);
+    BOOST_CHECK(child_summary->depends[0] == parent->GetHash());
+    BOOST_CHECK_EQUAL(child_summary->ancestor_count, 2U);
+    BOOST_CHECK(child_summary->unbroadcast);
+    BOOST_CHECK(!snapshot->Find(uint256::ONE));
+
+    // Publishing an unchanged mempool keeps the snapshot.
+    pool.PublishSnapshot();
+    BOOST_CHECK(pool.GetSnapshot(0ms) == snapshot);
+
+    // Once the mempool changes, the snapshot is only returned while young enough.
+    pool.PrioritiseTransaction(child->GetHash(), 5000);
+    SetMockTime(1001s);
+    BOOST_CHECK(pool.GetSnapshot(1000ms) == snapshot);
+    BOOST_CHECK(!pool.GetSnapshot(999ms));
+
+    // Readers holding the old snapshot keep it while a new one replaces it.
+    pool.PublishSnapshot();
+    const auto updated{pool.GetSnapshot(0ms)};
+    BOOST_REQUIRE(updated && updated != snapshot);
+    BOOST_CHECK_EQUAL(updated->Find(child->GetHash())->modified_fee, 25000);
+    BOOST_CHECK_EQUAL(snapshot->Find(child->GetHash())->modified_fee, 20000);
+
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.removeForBlock({parent, child}, 1);
+    }
+    pool.RemoveUnbroadcastTx(child->GetHash());
+    pool.PublishSnapshot();
+    BOOST_CHECK(pool.GetSnapshot(0ms)->entries.empty());
+    BOOST_CHECK_EQUAL(pool.GetSnapshot(0ms)->unbroadcast_count, 0U);
+
+    // Changes are only published once a reader asked again since the last
+    // publication.
+    pool.PublishSnapshot();
+    pool.SetIsLoaded(true);
+    pool.PublishSnapshot();
+    BOOST_CHECK(!pool.GetSnapshot(0ms)->loaded);
+    pool.PublishSnapshot();
+    BOOST_CHECK(pool.GetSnapshot(0ms)->loaded);
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
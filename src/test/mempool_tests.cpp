@@ -292,6 +292,75 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
     pool.removeRecursive(pool.mapTx.find(tx8.GetHash())->GetTx(), REMOVAL_REASON_DUMMY);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolTxTimeIndexTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // tx1 (old) <- tx2 (old, child of tx1)
+    // tx3 (new) <- tx4 (old, child of tx3)
+    // tx5 (at the cutoff)
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.nTime = 1000;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.nTime = 1000;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 9 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx2));
+
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.nTime = 3000;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 8 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx3));
+
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.nTime = 1000;
+    tx4.vin.resize(1);
+    tx4.vin[0].prevout = COutPoint(tx3.GetHash(), 0);
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 7 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx4));
+
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.nTime = 2000;
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx5));
+
+    // The timestamp index is ordered by transaction time
+    const auto& index = pool.mapTx.get<tx_time>();
+    BOOST_CHECK_EQUAL(index.begin()->GetTx().nTime, 1000U);
+    BOOST_CHECK_EQUAL(index.rbegin()->GetTx().GetHash(), tx3.GetHash());
+
+    // Transactions after the cutoff and their descendants are returned
+    CTxMemPool::setEntries newer;
+    pool.CalculateTxsNewerThan(2000, newer);
+    BOOST_CHECK_EQUAL(newer.size(), 2U);
+    BOOST_CHECK(newer.count(pool.mapTx.find(tx3.GetHash())));
+    BOOST_CHECK(newer.count(pool.mapTx.find(tx4.GetHash())));
+
+    newer.clear();
+    pool.CalculateTxsNewerThan(999, newer);
+    BOOST_CHECK_EQUAL(newer.size(), 5U);
+
+    newer.clear();
+    pool.CalculateTxsNewerThan(3000, newer);
+    BOOST_CHECK(newer.empty());
+}
+
 BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
 {
     CTxMemPool pool;
@@ -24,6 +24,7 @@
 #include <boost/test/unit_test.hpp>
 
 using node::BlockAssembler;
+using node::BlockTemplateCache;
 using node::CBlockTemplate;
 
 namespace miner_tests {
@@ -514,4 +515,72 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_FIXTURE_TEST_CASE(block_template_cache, SyntheticChainSetup)
+{
+    const CScript op_true{CScript() << OP_TRUE};
+    for (int i = 0; i < 4; ++i) {
+        AppendBlock({}, op_true);
+    }
+    const int64_t now{GetTime()};
+    SetMockTime(now);
+
+    m_node.template_cache = std::make_unique<BlockTemplateCache>(*m_node.mempool);
+    RegisterValidationInterface(m_node.template_cache.get());
+
+    // Transactions are added to the mempool without telling the cache, so
+    // that a template made from the cached selection leaves them out.
+    std::vector<CTransactionRef> txs;
+    const auto add_tx = [&](bool notify) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.nTime = now;
+        tx.vin.emplace_back(COutPoint(m_coinbase_txns[txs.size()]->GetHash(), 0));
+        tx.vout.emplace_back(49 * COIN, op_true);
+        txs.push_back(MakeTransactionRef(tx));
+        LOCK2(::cs_main, m_node.mempool->cs);
+        m_node.mempool->addUnchecked(TestMemPoolEntryHelper().Fee(COIN).Time(now).FromTx(txs.back()));
+        if (notify) GetMainSignals().TransactionAddedToMempool(txs.back(), m_node.mempool->GetAndIncrementSequence());
+    };
+    const auto create_template = [&] {
+        SyncWithValidationInterfaceQueue();
+        auto tmpl{BlockAssembler{m_chainstate, *m_node.mempool, Params()}.CreateNewBlock(op_true, nullptr, nullptr, &m_node)};
+        BOOST_REQUIRE(tmpl);
+        BOOST_CHECK_EQUAL(tmpl->vTxFees.size(), tmpl->block.vtx.size());
+        BOOST_CHECK_EQUAL(tmpl->vTxSigOpsCost.size(), tmpl->block.vtx.size());
+        return tmpl;
+    };
+
+    add_tx(/*notify=*/true);
+    BOOST_CHECK_EQUAL(create_template()->block.vtx.size(), 2U);
+
+    // Hit: the selection is reused, with the additions the cache was told about.
+    add_tx(/*notify=*/false);
+    BOOST_CHECK_EQUAL(create_template()->block.vtx.size(), 2U);
+    GetMainSignals().TransactionAddedToMempool(txs.back(), WITH_LOCK(m_node.mempool->cs, return m_node.mempool->GetAndIncrementSequence()));
+    auto tmpl{create_template()};
+    BOOST_REQUIRE_EQUAL(tmpl->block.vtx.size(), 3U);
+    BOOST_CHECK(tmpl->block.vtx[1] == txs[0]);
+    BOOST_CHECK(tmpl->block.vtx[2] == txs[1]);
+    BOOST_CHECK_EQUAL(tmpl->vTxFees[0], -2 * COIN);
+
+    // Invalidation: a new tip drops the selection, so all of the mempool is
+    // looked at again.
+    add_tx(/*notify=*/false);
+    GetMainSignals().UpdatedBlockTip(WITH_LOCK(::cs_main, return m_chainstate.m_chain.Tip()), nullptr, false);
+    BOOST_CHECK_EQUAL(create_template()->block.vtx.size(), 4U);
+
+    // Rollback: once the cached transactions are too new for the block, the
+    // partly assembled block is undone and a full selection made, which
+    // leaves them all out.
+    SetMockTime(now - 100);
+    tmpl = create_template();
+    BOOST_CHECK_EQUAL(tmpl->block.vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(tmpl->vTxFees[0], 0);
+
+    UnregisterValidationInterface(m_node.template_cache.get());
+    SyncWithValidationInterfaceQueue();
+    m_node.template_cache.reset();
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,182 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <core_memusage.h>
+#include <txorphanage.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+
+BOOST_FIXTURE_TEST_SUITE(orphanage_tests, BasicTestingSetup)
+
+static constexpr size_t NO_LIMIT{std::numeric_limits<size_t>::max()};
+
+class TxOrphanageTest : public TxOrphanage
+{
+public:
+    size_t CountOutpoints() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) { return m_outpoint_to_orphan_it.size(); }
+    size_t CountPeers() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) { return m_peer_orphans.size(); }
+    size_t CountByPeer(NodeId peer) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+    {
+        const auto it = m_peer_orphans.find(peer);
+        return it == m_peer_orphans.end() ? 0 : it->second.orphans.size();
+    }
+};
+
+static CTransactionRef MakeTransaction(const std::vector<COutPoint>& prevouts, size_t num_outputs = 1)
+{
+    CMutableTransaction tx;
+    for (const COutPoint& prevout : prevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptSig = CScript() << OP_1;
+    }
+    tx.vout.resize(num_outputs);
+    for (CTxOut& out : tx.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = CENT;
+    }
+    return MakeTransactionRef(tx);
+}
+
+static COutPoint RandomOutpoint()
+{
+    return COutPoint{InsecureRand256(), 0};
+}
+
+BOOST_AUTO_TEST_CASE(Usage)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    const CTransactionRef a{MakeTransaction({RandomOutpoint(), RandomOutpoint()})};
+    const CTransactionRef b{MakeTransaction({RandomOutpoint()}, 10)};
+    BOOST_CHECK(orphanage.AddTx(a, 0));
+    BOOST_CHECK(orphanage.AddTx(b, 1));
+    BOOST_CHECK(!orphanage.AddTx(b, 0));
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 3U);
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(0), RecursiveDynamicUsage(a));
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(1), RecursiveDynamicUsage(b));
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), RecursiveDynamicUsage(a) + RecursiveDynamicUsage(b));
+
+    BOOST_CHECK_EQUAL(orphanage.EraseTx(a->GetHash()), 1);
+    BOOST_CHECK_EQUAL(orphanage.EraseTx(a->GetHash()), 0);
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(0), 0U);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), RecursiveDynamicUsage(b));
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 1U);
+    BOOST_CHECK_EQUAL(orphanage.CountPeers(), 1U);
+
+    orphanage.EraseForPeer(1);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.CountPeers(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(PeerBudget)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    size_t usage{0};
+    for (int i = 0; i < 10; ++i) {
+        const CTransactionRef tx{MakeTransaction({RandomOutpoint()})};
+        usage = RecursiveDynamicUsage(tx);
+        BOOST_CHECK(orphanage.AddTx(tx, 0));
+    }
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(orphanage.AddTx(MakeTransaction({RandomOutpoint()}), 1));
+    }
+
+    // Only the peer over its budget loses orphans.
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(100, NO_LIMIT, 3 * usage), 7U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(0), 3U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(1), 2U);
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(0), 3 * usage);
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(100, NO_LIMIT, 3 * usage), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(EvictFromLargestPeer)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    for (int i = 0; i < 5; ++i) {
+        BOOST_CHECK(orphanage.AddTx(MakeTransaction({RandomOutpoint()}), 0));
+    }
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(orphanage.AddTx(MakeTransaction({RandomOutpoint()}, 20), 1));
+    }
+
+    // Over the count limit, the peer with the most orphans is evicted from.
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(4, NO_LIMIT, NO_LIMIT), 3U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(0), 2U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(1), 2U);
+
+    // Over the memory limit, the peer using the most memory is.
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(4, orphanage.TotalUsage() - 1, NO_LIMIT), 1U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(0), 2U);
+    BOOST_CHECK_EQUAL(orphanage.CountByPeer(1), 1U);
+
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(0, NO_LIMIT, NO_LIMIT), 3U);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.CountPeers(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(EraseForBlock)
+{
+    TxOrphanageTest orphanage;
+    const COutPoint spent{RandomOutpoint()};
+    const CTransactionRef conflicted{MakeTransaction({spent, RandomOutpoint()})};
+    const CTransactionRef mined{MakeTransaction({RandomOutpoint()})};
+    const CTransactionRef kept{MakeTransaction({RandomOutpoint()})};
+    {
+        LOCK(g_cs_orphans);
+        BOOST_CHECK(orphanage.AddTx(conflicted, 0));
+        BOOST_CHECK(orphanage.AddTx(mined, 0));
+        BOOST_CHECK(orphanage.AddTx(kept, 1));
+    }
+
+    CBlock block;
+    block.vtx.push_back(MakeTransaction({spent}));
+    block.vtx.push_back(mined);
+    orphanage.EraseForBlock(block);
+
+    LOCK(g_cs_orphans);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 1U);
+    BOOST_CHECK(orphanage.GetTx(kept->GetHash()).first == kept);
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 1U);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), RecursiveDynamicUsage(kept));
+}
+
+BOOST_AUTO_TEST_CASE(ChildrenWorkSet)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    const CTransactionRef parent{MakeTransaction({RandomOutpoint()}, 2)};
+    const CTransactionRef first{MakeTransaction({COutPoint{parent->GetHash(), 0}})};
+    const CTransactionRef second{MakeTransaction({COutPoint{parent->GetHash(), 0}, RandomOutpoint()})};
+    const CTransactionRef both{MakeTransaction({COutPoint{parent->GetHash(), 0}, COutPoint{parent->GetHash(), 1}})};
+    BOOST_CHECK(orphanage.AddTx(first, 0));
+    BOOST_CHECK(orphanage.AddTx(second, 1));
+    BOOST_CHECK(orphanage.AddTx(both, 2));
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 3U);
+
+    std::set<uint256> work_set;
+    orphanage.AddChildrenToWorkSet(*parent, work_set);
+    BOOST_CHECK(work_set == std::set<uint256>({first->GetHash(), second->GetHash(), both->GetHash()}));
+
+    // Orphans spending the same outpoint stay indexed while any of them is left.
+    orphanage.EraseTx(both->GetHash());
+    orphanage.EraseTx(first->GetHash());
+    work_set.clear();
+    orphanage.AddChildrenToWorkSet(*parent, work_set);
+    BOOST_CHECK(work_set == std::set<uint256>({second->GetHash()}));
+    BOOST_CHECK_EQUAL(orphanage.CountOutpoints(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
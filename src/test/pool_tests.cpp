@@ -0,0 +1,92 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating)
+{
+    auto resource = PoolResource<8, 8>(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // first chunk is already allocated
+    void* block = resource.Allocate(8, 8);
+    BOOST_CHECK(block != nullptr);
+
+    // a freed block is handed out again for the same size
+    BOOST_CHECK_EQUAL(resource.FreeListBytes(), 0U);
+    resource.Deallocate(block, 8, 8);
+    BOOST_CHECK_EQUAL(resource.FreeListBytes(), 8U);
+    void* b = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(b, block);
+    BOOST_CHECK_EQUAL(resource.FreeListBytes(), 0U);
+    resource.Deallocate(b, 8, 8);
+
+    // too large or overaligned allocations are forwarded to operator new
+    void* big = resource.Allocate(16, 8);
+    void* aligned = resource.Allocate(8, 16);
+    BOOST_CHECK(big != nullptr && aligned != nullptr);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 16, 0U);
+    resource.Deallocate(big, 16, 8);
+    resource.Deallocate(aligned, 8, 16);
+
+    // exhausting the chunk allocates a new one
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 1024 / 8 + 1; ++i) {
+        blocks.push_back(resource.Allocate(8, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    for (void* p : blocks) {
+        resource.Deallocate(p, 8, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.FreeListBytes(), blocks.size() * 8);
+}
+
+BOOST_AUTO_TEST_CASE(allocator_in_unordered_map)
+{
+    using Map = std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                   PoolAllocator<std::pair<const uint64_t, uint64_t>, 64>>;
+    Map::allocator_type::ResourceType resource(4096);
+    {
+        Map map{0, Map::hasher{}, Map::key_equal{}, &resource};
+        for (uint64_t i = 0; i < 10000; ++i) {
+            map[i] = i * 2;
+        }
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 5000U);
+        for (const auto& [k, v] : map) {
+            BOOST_CHECK_EQUAL(v, k * 2);
+        }
+        // memory usage accounts for the whole chunks held by the resource
+        BOOST_CHECK(memusage::DynamicUsage(map) >= resource.NumAllocatedChunks() * resource.ChunkSizeBytes());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coins_map_uses_pool)
+{
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
+    const size_t chunks_before = resource.NumAllocatedChunks();
+    for (uint32_t i = 0; i < 100; ++i) {
+        map.emplace(COutPoint{uint256::ONE, i}, CCoinsCacheEntry{});
+    }
+    // a hundred entries fit into the first chunk
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks_before);
+    BOOST_CHECK_EQUAL(map.size(), 100U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -75,4 +75,37 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
     SyncWithValidationInterfaceQueue();
 }
 
+BOOST_FIXTURE_TEST_CASE(txindex_parallel_sync, SyntheticChainSetup)
+{
+    // More blocks than fit in one batch of the initial sync
+    for (int i = 0; i < 150; ++i) {
+        AppendBlock({}, CScript() << OP_TRUE);
+    }
+
+    TxIndex txindex(1 << 20, true);
+    txindex.SetSyncThreads(4);
+    BOOST_REQUIRE(txindex.Start(m_chainstate));
+
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!txindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+    BOOST_CHECK_EQUAL(txindex.GetSummary().best_block_height, 150);
+
+    CTransactionRef tx_disk;
+    uint256 block_hash;
+    for (const auto& txn : m_coinbase_txns) {
+        if (!txindex.FindTx(txn->GetHash(), block_hash, tx_disk)) {
+            BOOST_ERROR("FindTx failed");
+        } else if (tx_disk->GetHash() != txn->GetHash()) {
+            BOOST_ERROR("Read incorrect tx");
+        }
+    }
+
+    txindex.Stop();
+    SyncWithValidationInterfaceQueue();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,13 +2,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chainparams.h>
 #include <consensus/validation.h>
 #include <key.h>
+#include <policy/packages.h>
+#include <policy/policy.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
 #include <txmempool.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
@@ -22,6 +26,7 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
                        std::vector<CScriptCheck>* pvChecks) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
 
 BOOST_AUTO_TEST_SUITE(txvalidationcache_tests)
 
@@ -384,4 +389,85 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, Dersig100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(parallel_script_checks, SyntheticChainSetup)
+{
+    // The scripts of packages and of bursts of orphans are verified on the
+    // script check threads. Only the executions under the consensus flags
+    // may be recorded in the script execution cache, and only if all of the
+    // transactions pass.
+    const CScript op_true{CScript() << OP_TRUE};
+    for (int i = 0; i < Params().GetConsensus().nCoinbaseMaturity + 7; ++i) {
+        AppendBlock({}, op_true);
+    }
+    const int64_t now{GetTime()};
+    SetMockTime(now);
+    CTxMemPool& pool{*m_node.mempool};
+    const unsigned int consensus_flags{WITH_LOCK(::cs_main, return GetBlockScriptFlags(m_chainstate.m_chain.Tip(), Params().GetConsensus()))};
+
+    // Outputs are padded to the minimum standard transaction size.
+    const CScript padded_true{CScript() << ToByteVector(uint256::ONE) << OP_DROP << OP_TRUE};
+    const CScript padded_false{CScript() << ToByteVector(uint256::ONE) << OP_DROP << OP_FALSE};
+    const auto spend = [&](const CTransactionRef& prev, CAmount value, const CScript& script_pub_key, const CScript& script_sig = {}) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.nTime = now;
+        tx.vin.emplace_back(COutPoint(prev->GetHash(), 0), script_sig);
+        tx.vout.emplace_back(value, script_pub_key);
+        return MakeTransactionRef(tx);
+    };
+    const auto is_cached = [&](const CTransactionRef& tx, unsigned int flags) {
+        LOCK2(::cs_main, pool.cs);
+        CCoinsViewMemPool view_mempool(&m_chainstate.CoinsTip(), pool);
+        CCoinsViewCache view(&view_mempool);
+        TxValidationState state;
+        PrecomputedTransactionData txdata;
+        std::vector<CScriptCheck> scriptchecks;
+        BOOST_CHECK(CheckInputScripts(*tx, state, view, flags, true, true, txdata, &scriptchecks));
+        return scriptchecks.empty();
+    };
+
+    // Package
+    const CTransactionRef parent{spend(m_coinbase_txns[0], 49 * COIN, padded_true)};
+    const CTransactionRef child{spend(parent, 48 * COIN, padded_true)};
+    {
+        LOCK(::cs_main);
+        const auto result{ProcessNewPackage(m_chainstate, pool, {parent, child}, /*test_accept=*/false)};
+        BOOST_CHECK_MESSAGE(result.m_state.IsValid(), result.m_state.ToString());
+    }
+    for (const CTransactionRef& tx : {parent, child}) {
+        BOOST_CHECK(is_cached(tx, consensus_flags));
+        BOOST_CHECK(!is_cached(tx, STANDARD_SCRIPT_VERIFY_FLAGS));
+    }
+
+    // A package whose child fails leaves nothing cached for the parent.
+    const CTransactionRef bad_parent{spend(m_coinbase_txns[1], 49 * COIN, padded_false)};
+    const CTransactionRef bad_child{spend(bad_parent, 48 * COIN, padded_true)};
+    {
+        LOCK(::cs_main);
+        BOOST_CHECK(!ProcessNewPackage(m_chainstate, pool, {bad_parent, bad_child}, /*test_accept=*/false).m_state.IsValid());
+    }
+    BOOST_CHECK(!is_cached(bad_parent, consensus_flags));
+
+    // Orphan burst
+    const std::vector<CTransactionRef> orphans{spend(m_coinbase_txns[2], 49 * COIN, padded_true),
+                                               spend(m_coinbase_txns[3], 49 * COIN, padded_true)};
+    WITH_LOCK(::cs_main, m_node.chainman->PreVerifyTransactions(orphans));
+    for (const CTransactionRef& tx : orphans) {
+        BOOST_CHECK(is_cached(tx, consensus_flags));
+        BOOST_CHECK(!is_cached(tx, STANDARD_SCRIPT_VERIFY_FLAGS));
+        LOCK(::cs_main);
+        BOOST_CHECK(AcceptToMemoryPool(m_chainstate, tx, now, /*bypass_limits=*/false, /*test_accept=*/false).m_result_type == MempoolAcceptResult::ResultType::VALID);
+    }
+
+    // A burst with a transaction failing the policy flags leaves nothing
+    // cached: its extra stack element only breaks CLEANSTACK.
+    const std::vector<CTransactionRef> bad_orphans{spend(m_coinbase_txns[4], 49 * COIN, padded_true),
+                                                   spend(m_coinbase_txns[5], 49 * COIN, padded_true, CScript() << OP_0)};
+    WITH_LOCK(::cs_main, m_node.chainman->PreVerifyTransactions(bad_orphans));
+    BOOST_CHECK(!is_cached(bad_orphans[0], consensus_flags));
+    BOOST_CHECK(!is_cached(bad_orphans[1], consensus_flags));
+
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,9 +5,11 @@
 #include <test/util/setup_common.h>
 
 #include <addrman.h>
+#include <arith_uint256.h>
 #include <banman.h>
 #include <chainparams.h>
 #include <consensus/consensus.h>
+#include <consensus/merkle.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
@@ -19,6 +21,8 @@
 #include <noui.h>
 #include <node/blockstorage.h>
 #include <node/chainstate.h>
+#include <policy/fees.h>
+#include <policy/policy.h>
 #include <pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
@@ -28,6 +32,7 @@
 #include <shutdown.h>
 #include <streams.h>
 #include <txdb.h>
+#include <undo.h>
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/thread.h>
@@ -154,7 +159,8 @@ ChainTestingSetup::ChainTestingSetup(const std::string& chainName, const std::ve
     m_node.scheduler->m_service_thread = std::thread(util::TraceThread, "scheduler", [&] { m_node.scheduler->serviceQueue(); });
     GetMainSignals().RegisterBackgroundSignalScheduler(*m_node.scheduler);
 
-    m_node.mempool = std::make_unique<CTxMemPool>(1);
+    m_node.fee_estimator = std::make_unique<FeeEstimator>(DEFAULT_BLOCK_MAX_WEIGHT / WITNESS_SCALE_FACTOR);
+    m_node.mempool = std::make_unique<CTxMemPool>(m_node.fee_estimator.get(), 1);
 
     m_cache_sizes = CalculateCacheSizes(m_args);
 
@@ -179,6 +185,7 @@ ChainTestingSetup::~ChainTestingSetup()
     m_node.args = nullptr;
     UnloadBlockIndex(m_node.mempool.get(), *m_node.chainman);
     m_node.mempool.reset();
+    m_node.fee_estimator.reset();
     m_node.scheduler.reset();
     m_node.chainman->Reset();
     m_node.chainman.reset();
@@ -351,6 +358,79 @@ CMutableTransaction TestChain100Setup::CreateValidMempoolTransaction(CTransactio
     return mempool_txn;
 }
 
+SyntheticChainSetup::SyntheticChainSetup(const std::vector<const char*>& extra_args)
+    : ChainTestingSetup{CBaseChainParams::REGTEST, extra_args},
+      m_chainstate{[&]() -> CChainState& {
+          LOCK(::cs_main);
+          return m_node.chainman->InitializeChainstate(m_node.mempool.get());
+      }()}
+{
+    LOCK(::cs_main);
+    m_chainstate.InitCoinsDB(/*cache_size_bytes=*/1 << 23, /*in_memory=*/true, /*should_wipe=*/false);
+    m_chainstate.InitCoinsCache(1 << 23);
+    // The regtest genesis block does not pass the proof of work check when it
+    // is read back from disk, so start from a block of our own.
+    AppendBlock({}, CScript() << OP_TRUE);
+}
+
+CBlockIndex* SyntheticChainSetup::AppendBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
+{
+    LOCK(::cs_main);
+    const CChainParams& chainparams = Params();
+    CBlockIndex* prev = m_chainstate.m_chain.Tip();
+    const int height = prev ? prev->nHeight + 1 : 0;
+
+    CBlock block;
+    block.hashPrevBlock = prev ? prev->GetBlockHash() : uint256();
+    block.nTime = prev ? prev->nTime + 1 : chainparams.GenesisBlock().nTime;
+    block.nBits = UintToArith256(chainparams.GetConsensus().powLimit).GetCompact();
+
+    CMutableTransaction coinbase;
+    coinbase.nTime = block.nTime;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << height << OP_0;
+    coinbase.vout.emplace_back(50 * COIN, scriptPubKey);
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    for (const CMutableTransaction& tx : txns) {
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+
+    CBlockIndex* pindex = Assert(m_chainstate.m_blockman.AddToBlockIndex(block));
+    const FlatFilePos pos = m_chainstate.m_blockman.SaveBlockToDisk(block, height, m_chainstate.m_chain, chainparams, nullptr);
+    Assert(!pos.IsNull());
+    pindex->nFile = pos.nFile;
+    pindex->nDataPos = pos.nPos;
+    pindex->nTx = block.vtx.size();
+    pindex->nChainTx = (prev ? prev->nChainTx : 0) + pindex->nTx;
+    pindex->nStatus |= BLOCK_HAVE_DATA;
+    pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+
+    // Like ConnectBlock, leave the outputs of the genesis block out of the
+    // UTXO set.
+    if (prev) {
+        CCoinsViewCache& view = m_chainstate.CoinsTip();
+        CBlockUndo blockundo;
+        for (const CTransactionRef& tx : block.vtx) {
+            if (!tx->IsCoinBase()) {
+                CTxUndo& txundo = blockundo.vtxundo.emplace_back();
+                for (const CTxIn& txin : tx->vin) {
+                    Assert(view.SpendCoin(txin.prevout, &txundo.vprevout.emplace_back()));
+                }
+            }
+            AddCoins(view, *tx, height);
+        }
+        BlockValidationState state;
+        Assert(m_chainstate.m_blockman.WriteUndoDataForBlock(blockundo, state, pindex, chainparams));
+        m_coinbase_txns.push_back(block.vtx[0]);
+    }
+    m_chainstate.CoinsTip().SetBestBlock(pindex->GetBlockHash());
+    m_chainstate.m_chain.SetTip(pindex);
+    return pindex;
+}
+
 CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CMutableTransaction& tx) const
 {
     return FromTx(MakeTransactionRef(tx));
@@ -166,6 +166,28 @@ struct TestChain100Setup : public TestingSetup {
     CKey coinbaseKey; // private/public key needed to spend coinbase transactions
 };
 
+class CBlockIndex;
+class CChainState;
+
+/**
+ * Testing fixture with a REGTEST-mode active chainstate whose blocks are
+ * assembled and connected by hand, without validating them. Blocks and undo
+ * data are written to disk, so code that reads them back can be exercised.
+ */
+struct SyntheticChainSetup : public ChainTestingSetup {
+    SyntheticChainSetup(const std::vector<const char*>& extra_args = {});
+
+    /**
+     * Append a block with the given transactions and a coinbase paying to
+     * scriptPubKey to the active chain, updating the coins tip the way
+     * connecting the block would.
+     */
+    CBlockIndex* AppendBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey);
+
+    CChainState& m_chainstate;
+    std::vector<CTransactionRef> m_coinbase_txns; // For convenience, coinbase transactions
+};
+
 /**
  * Make a test setup that has disk access to the debug.log file disabled. Can
  * be used in "hot loops", for example fuzzing or benchmarking.
@@ -151,4 +151,33 @@ BOOST_FIXTURE_TEST_CASE(chainstate_update_tip, TestChain100Setup)
     BOOST_CHECK_EQUAL(curr_tip, ::g_best_block);
 }
 
+//! Test that DisconnectTips() rewinds several blocks read in parallel and
+//! restores the coins they spent.
+BOOST_FIXTURE_TEST_CASE(chainstate_disconnect_tips, SyntheticChainSetup)
+{
+    const CScript op_true{CScript() << OP_TRUE};
+    const CBlockIndex* fork = AppendBlock({}, op_true);
+    for (int i = 0; i < 4; ++i) {
+        CMutableTransaction spend;
+        spend.vin.emplace_back(COutPoint(m_coinbase_txns.back()->GetHash(), 0));
+        spend.vout.emplace_back(49 * COIN, op_true);
+        AppendBlock({spend}, op_true);
+    }
+
+    LOCK2(::cs_main, m_node.mempool->cs);
+    CCoinsViewCache& coins = m_chainstate.CoinsTip();
+    BOOST_CHECK_EQUAL(m_chainstate.m_chain.Height(), fork->nHeight + 4);
+    BOOST_CHECK(!coins.HaveCoin(COutPoint(m_coinbase_txns[0]->GetHash(), 0)));
+
+    BlockValidationState state;
+    BOOST_CHECK(m_chainstate.DisconnectTips(state, fork, nullptr));
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK_EQUAL(m_chainstate.m_chain.Tip(), fork);
+    BOOST_CHECK_EQUAL(coins.GetBestBlock(), fork->GetBlockHash());
+    BOOST_CHECK(coins.HaveCoin(COutPoint(m_coinbase_txns[0]->GetHash(), 0)));
+    for (size_t i = 1; i < m_coinbase_txns.size(); ++i) {
+        BOOST_CHECK(!coins.HaveCoin(COutPoint(m_coinbase_txns[i]->GetHash(), 0)));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
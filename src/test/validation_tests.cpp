@@ -4,9 +4,15 @@
 
 #include <chainparams.h>
 #include <consensus/amount.h>
+#include <fs.h>
+#include <key.h>
 #include <net.h>
+#include <random.h>
+#include <script/sigcache.h>
 #include <signet.h>
+#include <streams.h>
 #include <uint256.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <test/util/setup_common.h>
@@ -99,4 +105,118 @@ BOOST_AUTO_TEST_CASE(test_assumeutxo)
     BOOST_CHECK_EQUAL(out210.nChainTx, 200U);
 }
 
+//! Test that block signatures are verified through the signature cache.
+BOOST_AUTO_TEST_CASE(block_signature_cache)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    const uint256 hash = GetRandHash();
+    std::vector<unsigned char> sig;
+    BOOST_REQUIRE(key.Sign(hash, sig));
+
+    // A valid signature is accepted both when verified and when cached.
+    BOOST_CHECK(VerifyBlockSignature(pubkey, hash, sig));
+    BOOST_CHECK(VerifyBlockSignature(pubkey, hash, sig));
+
+    // The cache entry is bound to the hash, key and signature.
+    BOOST_CHECK(!VerifyBlockSignature(pubkey, GetRandHash(), sig));
+    CKey other;
+    other.MakeNewKey(true);
+    BOOST_CHECK(!VerifyBlockSignature(other.GetPubKey(), hash, sig));
+    std::vector<unsigned char> bad_sig{sig};
+    bad_sig.back() ^= 1;
+    BOOST_CHECK(!VerifyBlockSignature(pubkey, hash, bad_sig));
+}
+
+BOOST_FIXTURE_TEST_CASE(mempool_dump_load, SyntheticChainSetup)
+{
+    const CScript op_true{CScript() << OP_TRUE};
+    for (int i = 0; i < Params().GetConsensus().nCoinbaseMaturity + 3; ++i) {
+        AppendBlock({}, op_true);
+    }
+    const int64_t now{GetTime()};
+    SetMockTime(now);
+    CTxMemPool& pool{*m_node.mempool};
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 3; ++i) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.nTime = now;
+        tx.vin.emplace_back(COutPoint(m_coinbase_txns[i]->GetHash(), 0));
+        // Padded to the minimum standard transaction size
+        tx.vout.emplace_back(49 * COIN, CScript() << ToByteVector(uint256::ONE) << OP_DROP << OP_TRUE);
+        txs.push_back(MakeTransactionRef(tx));
+        LOCK(::cs_main);
+        const auto result{AcceptToMemoryPool(m_chainstate, txs.back(), now, /*bypass_limits=*/false, /*test_accept=*/false)};
+        BOOST_REQUIRE_MESSAGE(result.m_result_type == MempoolAcceptResult::ResultType::VALID, result.m_state.ToString());
+    }
+    // A delta for a transaction that isn't in the mempool is kept in the
+    // file's own map, which is only applied when the checksum matches.
+    const uint256 absent_txid{InsecureRand256()};
+    pool.PrioritiseTransaction(absent_txid, COIN);
+    pool.PrioritiseTransaction(txs[0]->GetHash(), COIN);
+    pool.AddUnbroadcastTx(txs[1]->GetHash());
+
+    const fs::path path{gArgs.GetDataDirNet() / "mempool.dat"};
+    const auto reset_mempool = [&] {
+        pool.clear();
+        LOCK(pool.cs);
+        pool.ClearPrioritisation(absent_txid);
+        pool.ClearPrioritisation(txs[0]->GetHash());
+        pool.RemoveUnbroadcastTx(txs[1]->GetHash(), /*unchecked=*/true);
+    };
+    const auto get_delta = [&](const uint256& txid) {
+        CAmount delta{0};
+        LOCK(pool.cs);
+        pool.ApplyDelta(txid, delta);
+        return delta;
+    };
+
+    BOOST_REQUIRE(DumpMempool(pool, fsbridge::fopen, /*skip_file_commit=*/true));
+    {
+        CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+        uint64_t version;
+        file >> version;
+        BOOST_CHECK_EQUAL(version, 2U);
+    }
+
+    reset_mempool();
+    BOOST_CHECK(LoadMempool(pool, m_chainstate));
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK_EQUAL(get_delta(txs[0]->GetHash()), COIN);
+    BOOST_CHECK_EQUAL(get_delta(absent_txid), COIN);
+    BOOST_CHECK(pool.GetUnbroadcastTxs() == std::set<uint256>{txs[1]->GetHash()});
+
+    // Expired transactions are left out, but their fee deltas still apply.
+    reset_mempool();
+    SetMockTime(now + DEFAULT_MEMPOOL_EXPIRY * 60 * 60 + 1);
+    BOOST_CHECK(LoadMempool(pool, m_chainstate));
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(get_delta(txs[0]->GetHash()), COIN);
+    SetMockTime(now);
+
+    // With a corrupt checksum, the transactions are still validated and
+    // accepted, but the fee deltas and unbroadcast set are dropped.
+    {
+        FILE* file{fsbridge::fopen(path, "r+b")};
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, -1, SEEK_END), 0);
+        const int last{fgetc(file)};
+        BOOST_REQUIRE(last != EOF);
+        BOOST_REQUIRE_EQUAL(fseek(file, -1, SEEK_END), 0);
+        fputc(last ^ 1, file);
+        fclose(file);
+    }
+    reset_mempool();
+    BOOST_CHECK(!LoadMempool(pool, m_chainstate));
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK_EQUAL(get_delta(txs[0]->GetHash()), COIN);
+    BOOST_CHECK_EQUAL(get_delta(absent_txid), 0);
+    BOOST_CHECK(pool.GetUnbroadcastTxs().empty());
+
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -62,15 +62,21 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     std::unique_ptr<CCoinsViewCursor> Cursor() const override;
 
+    //! Make the batches written by BatchWrite durable, see CDBWrapper::SyncAsyncWrites().
+    bool SyncAsyncWrites() { return m_db->SyncAsyncWrites(); }
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
 
     //! Dynamically alter the underlying leveldb cache size.
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    //! The underlying database, e.g. for reporting its statistics.
+    const CDBWrapper& GetDB() const { return *m_db; }
 };
 
 /** Access to the block database (blocks/index/) */
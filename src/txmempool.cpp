@@ -11,6 +11,7 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <kernel.h>
+#include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <reverse_iterator.h>
@@ -101,6 +102,36 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& tx, CAmount fee,
       nModFeesWithAncestors{nFee},
       nSigOpCostWithAncestors{sigOpCost} {}
 
+namespace {
+/** Orders links by the txid of the entry they refer to. */
+bool LinkBefore(const CTxMemPoolEntryLinks::Link& link, const CTxMemPoolEntry& entry)
+{
+    return link.get().GetTx().GetHash() < entry.GetTx().GetHash();
+}
+} // namespace
+
+bool CTxMemPoolEntryLinks::insert(const CTxMemPoolEntry& entry)
+{
+    const auto it{std::lower_bound(m_links.begin(), m_links.end(), entry, LinkBefore)};
+    if (it != m_links.end() && it->m_entry == &entry) return false;
+    m_links.insert(it, Link{&entry});
+    return true;
+}
+
+bool CTxMemPoolEntryLinks::erase(const CTxMemPoolEntry& entry)
+{
+    const auto it{std::lower_bound(m_links.begin(), m_links.end(), entry, LinkBefore)};
+    if (it == m_links.end() || it->m_entry != &entry) return false;
+    m_links.erase(it);
+    return true;
+}
+
+bool CTxMemPoolEntryLinks::contains(const CTxMemPoolEntry& entry) const
+{
+    const auto it{std::lower_bound(m_links.begin(), m_links.end(), entry, LinkBefore)};
+    return it != m_links.end() && it->m_entry == &entry;
+}
+
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
     nModFeesWithDescendants += newFeeDelta - feeDelta;
@@ -122,25 +153,34 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendan
                                       const std::set<uint256>& setExclude, std::set<uint256>& descendants_to_remove,
                                       uint64_t ancestor_size_limit, uint64_t ancestor_count_limit)
 {
-    CTxMemPoolEntry::Children stageEntries, descendants;
-    stageEntries = updateIt->GetMemPoolChildrenConst();
-
-    while (!stageEntries.empty()) {
-        const CTxMemPoolEntry& descendant = *stageEntries.begin();
-        descendants.insert(descendant);
-        stageEntries.erase(descendant);
-        const CTxMemPoolEntry::Children& children = descendant.GetMemPoolChildrenConst();
-        for (const CTxMemPoolEntry& childEntry : children) {
-            cacheMap::iterator cacheIt = cachedDescendants.find(mapTx.iterator_to(childEntry));
-            if (cacheIt != cachedDescendants.end()) {
-                // We've already calculated this one, just add the entries for this set
-                // but don't traverse again.
-                for (txiter cacheEntry : cacheIt->second) {
-                    descendants.insert(*cacheEntry);
+    std::vector<txiter> descendants;
+    {
+        WITH_FRESH_EPOCH(m_epoch);
+        std::vector<txiter> stage;
+        for (const CTxMemPoolEntry& child : updateIt->GetMemPoolChildrenConst()) {
+            const txiter childIt = mapTx.iterator_to(child);
+            visited(childIt);
+            stage.push_back(childIt);
+        }
+
+        while (!stage.empty()) {
+            const txiter descendantIt = stage.back();
+            stage.pop_back();
+            descendants.push_back(descendantIt);
+            const CTxMemPoolEntry::Children& children = descendantIt->GetMemPoolChildrenConst();
+            for (const CTxMemPoolEntry& childEntry : children) {
+                const txiter childIt = mapTx.iterator_to(childEntry);
+                cacheMap::iterator cacheIt = cachedDescendants.find(childIt);
+                if (cacheIt != cachedDescendants.end()) {
+                    // We've already calculated this one, just add the entries for this set
+                    // but don't traverse again.
+                    for (txiter cacheEntry : cacheIt->second) {
+                        if (!visited(cacheEntry)) descendants.push_back(cacheEntry);
+                    }
+                } else if (!visited(childIt)) {
+                    // Schedule for later processing
+                    stage.push_back(childIt);
                 }
-            } else if (!descendants.count(childEntry)) {
-                // Schedule for later processing
-                stageEntries.insert(childEntry);
             }
         }
     }
@@ -149,14 +189,15 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendan
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (const CTxMemPoolEntry& descendant : descendants) {
+    for (const txiter descendantIt : descendants) {
+        const CTxMemPoolEntry& descendant = *descendantIt;
         if (!setExclude.count(descendant.GetTx().GetHash())) {
             modifySize += descendant.GetTxSize();
             modifyFee += descendant.GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(mapTx.iterator_to(descendant));
+            cachedDescendants[updateIt].insert(descendantIt);
             // Update ancestor state for each descendant
-            mapTx.modify(mapTx.iterator_to(descendant), update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
+            mapTx.modify(descendantIt, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
             // Don't directly remove the transaction here -- doing so would
             // invalidate iterators in cachedDescendants. Mark it for removal
             // by inserting into descendants_to_remove.
@@ -226,7 +267,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 bool CTxMemPool::CalculateAncestorsAndCheckLimits(size_t entry_size,
                                                   size_t entry_count,
                                                   setEntries& setAncestors,
-                                                  CTxMemPoolEntry::Parents& staged_ancestors,
+                                                  std::vector<txiter>& staged_ancestors,
                                                   uint64_t limitAncestorCount,
                                                   uint64_t limitAncestorSize,
                                                   uint64_t limitDescendantCount,
@@ -236,11 +277,10 @@ bool CTxMemPool::CalculateAncestorsAndCheckLimits(size_t entry_size,
     size_t totalSizeWithAncestors = entry_size;
 
     while (!staged_ancestors.empty()) {
-        const CTxMemPoolEntry& stage = staged_ancestors.begin()->get();
-        txiter stageit = mapTx.iterator_to(stage);
+        const txiter stageit = staged_ancestors.back();
+        staged_ancestors.pop_back();
 
         setAncestors.insert(stageit);
-        staged_ancestors.erase(stage);
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry_size > limitDescendantSize) {
@@ -259,8 +299,8 @@ bool CTxMemPool::CalculateAncestorsAndCheckLimits(size_t entry_size,
             txiter parent_it = mapTx.iterator_to(parent);
 
             // If this is a new ancestor, add it.
-            if (setAncestors.count(parent_it) == 0) {
-                staged_ancestors.insert(parent);
+            if (!visited(parent_it)) {
+                staged_ancestors.push_back(parent_it);
             }
             if (staged_ancestors.size() + setAncestors.size() + entry_count > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
@@ -279,14 +319,15 @@ bool CTxMemPool::CheckPackageLimits(const Package& package,
                                     uint64_t limitDescendantSize,
                                     std::string &errString) const
 {
-    CTxMemPoolEntry::Parents staged_ancestors;
+    WITH_FRESH_EPOCH(m_epoch);
+    std::vector<txiter> staged_ancestors;
     size_t total_size = 0;
     for (const auto& tx : package) {
         total_size += GetVirtualTransactionSize(*tx);
         for (const auto& input : tx->vin) {
             std::optional<txiter> piter = GetIter(input.prevout.hash);
-            if (piter) {
-                staged_ancestors.insert(**piter);
+            if (piter && !visited(*piter)) {
+                staged_ancestors.push_back(*piter);
                 if (staged_ancestors.size() + package.size() > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -316,7 +357,12 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry,
                                            std::string &errString,
                                            bool fSearchForParents /* = true */) const
 {
-    CTxMemPoolEntry::Parents staged_ancestors;
+    WITH_FRESH_EPOCH(m_epoch);
+    // Ancestors already in the output are not walked again.
+    for (txiter it : setAncestors) {
+        visited(it);
+    }
+    std::vector<txiter> staged_ancestors;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -325,8 +371,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry,
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             std::optional<txiter> piter = GetIter(tx.vin[i].prevout.hash);
-            if (piter) {
-                staged_ancestors.insert(**piter);
+            if (piter && !visited(*piter)) {
+                staged_ancestors.push_back(*piter);
                 if (staged_ancestors.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -337,7 +383,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry,
         // If we're not searching for parents, we require this to already be an
         // entry in the mempool and use the entry's cached parents.
         txiter it = mapTx.iterator_to(entry);
-        staged_ancestors = it->GetMemPoolParentsConst();
+        for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+            txiter parent_it = mapTx.iterator_to(parent);
+            if (!visited(parent_it)) staged_ancestors.push_back(parent_it);
+        }
     }
 
     return CalculateAncestorsAndCheckLimits(entry.GetTxSize(), /* entry_count */ 1,
@@ -463,8 +512,8 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
     assert(int(nSigOpCostWithAncestors) >= 0);
 }
 
-CTxMemPool::CTxMemPool(int check_ratio)
-    : m_check_ratio(check_ratio)
+CTxMemPool::CTxMemPool(FeeEstimator* estimator, int check_ratio)
+    : m_check_ratio(check_ratio), minerPolicyEstimator(estimator)
 {
     _clear(); //lock free clear
 }
@@ -528,9 +577,14 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    m_total_fee += entry.GetFee();
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
+
+    if (minerPolicyEstimator) {
+        minerPolicyEstimator->processTransaction(entry);
+    }
 }
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
@@ -562,7 +616,10 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     totalTxSize -= it->GetTxSize();
     m_total_fee -= it->GetFee();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    cachedInnerUsage -= it->GetMemPoolParentsConst().DynamicMemoryUsage() + it->GetMemPoolChildrenConst().DynamicMemoryUsage();
+    if (minerPolicyEstimator) {
+        minerPolicyEstimator->removeTx(*it);
+    }
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -575,28 +632,37 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries& setDescendants) const
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
-    }
+    if (setDescendants.count(entryit) != 0) return;
+    std::vector<txiter> stage{entryit};
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
-    // already been walked, or will be walked in this iteration).
+    // already been walked, or will be walked in this iteration). A child reached
+    // through two parents is staged twice, but only walked once.
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
+        txiter it = stage.back();
+        stage.pop_back();
+        if (!setDescendants.insert(it).second) continue;
 
         const CTxMemPoolEntry::Children& children = it->GetMemPoolChildrenConst();
         for (const CTxMemPoolEntry& child : children) {
             txiter childiter = mapTx.iterator_to(child);
             if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+                stage.push_back(childiter);
             }
         }
     }
 }
 
+void CTxMemPool::CalculateTxsNewerThan(int64_t nTime, setEntries& setNewer) const
+{
+    AssertLockHeld(cs);
+    if (nTime >= std::numeric_limits<uint32_t>::max()) return;
+    const auto& index = mapTx.get<tx_time>();
+    for (auto it = index.upper_bound(static_cast<uint32_t>(std::max<int64_t>(nTime, 0))); it != index.end(); ++it) {
+        CalculateDescendants(mapTx.project<0>(it), setNewer);
+    }
+}
+
 void CTxMemPool::removeRecursive(const CTransaction &origTx, MemPoolRemovalReason reason)
 {
     // Remove transaction from memory pool
@@ -690,6 +756,9 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
+    if (minerPolicyEstimator) {
+        minerPolicyEstimator->processBlock(nBlockHeight);
+    }
 }
 
 void CTxMemPool::_clear()
@@ -700,6 +769,9 @@ void CTxMemPool::_clear()
     m_total_fee = 0;
     cachedInnerUsage = 0;
     ++nTransactionsUpdated;
+    if (minerPolicyEstimator) {
+        minerPolicyEstimator->ClearBacklog();
+    }
 }
 
 void CTxMemPool::clear()
@@ -730,7 +802,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         check_total_fee += it->GetFee();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
-        innerUsage += memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+        innerUsage += it->GetMemPoolParentsConst().DynamicMemoryUsage() + it->GetMemPoolChildrenConst().DynamicMemoryUsage();
         CTxMemPoolEntry::Parents setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
@@ -786,7 +858,7 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         for (; iter != mapNextTx.end() && iter->first->hash == it->GetTx().GetHash(); ++iter) {
             txiter childit = mapTx.find(iter->second->GetHash());
             assert(childit != mapTx.end()); // mapNextTx points to in-mempool transactions
-            if (setChildrenCheck.insert(*childit).second) {
+            if (setChildrenCheck.insert(*childit)) {
                 child_sizes += childit->GetTxSize();
             }
         }
@@ -892,6 +964,84 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+MempoolEntrySummary CTxMemPool::SummarizeEntry(const CTxMemPoolEntry& entry) const
+{
+    AssertLockHeld(cs);
+    const CTransaction& tx{entry.GetTx()};
+    MempoolEntrySummary summary;
+    summary.txid = tx.GetHash();
+    summary.wtxid = tx.GetWitnessHash();
+    summary.vsize = entry.GetTxSize();
+    summary.weight = entry.GetTxWeight();
+    summary.fee = entry.GetFee();
+    summary.modified_fee = entry.GetModifiedFee();
+    summary.time = entry.GetTime();
+    summary.height = entry.GetHeight();
+    summary.descendant_count = entry.GetCountWithDescendants();
+    summary.descendant_size = entry.GetSizeWithDescendants();
+    summary.descendant_fees = entry.GetModFeesWithDescendants();
+    summary.ancestor_count = entry.GetCountWithAncestors();
+    summary.ancestor_size = entry.GetSizeWithAncestors();
+    summary.ancestor_fees = entry.GetModFeesWithAncestors();
+    summary.unbroadcast = IsUnbroadcastTx(tx.GetHash());
+    for (const CTxIn& txin : tx.vin) {
+        if (mapTx.count(txin.prevout.hash)) summary.depends.push_back(txin.prevout.hash);
+    }
+    std::sort(summary.depends.begin(), summary.depends.end());
+    summary.depends.erase(std::unique(summary.depends.begin(), summary.depends.end()), summary.depends.end());
+    summary.spent_by.reserve(entry.GetMemPoolChildrenConst().size());
+    for (const CTxMemPoolEntry& child : entry.GetMemPoolChildrenConst()) {
+        summary.spent_by.push_back(child.GetTx().GetHash());
+    }
+    return summary;
+}
+
+void CTxMemPool::PublishSnapshot()
+{
+    if (!m_snapshot_requested.exchange(false)) return;
+
+    auto snapshot{std::make_shared<MempoolSnapshot>()};
+    {
+        LOCK(cs);
+        const auto current{std::atomic_load(&m_snapshot)};
+        if (current && current->transactions_updated == nTransactionsUpdated &&
+            current->loaded == m_is_loaded && current->unbroadcast_count == m_unbroadcast_txids.size()) {
+            return;
+        }
+        snapshot->loaded = m_is_loaded;
+        snapshot->bytes = totalTxSize;
+        snapshot->usage = DynamicMemoryUsage();
+        snapshot->total_fee = m_total_fee;
+        snapshot->unbroadcast_count = m_unbroadcast_txids.size();
+        snapshot->sequence = m_sequence_number;
+        snapshot->transactions_updated = nTransactionsUpdated;
+        snapshot->time = GetTime<std::chrono::milliseconds>();
+        snapshot->entries.reserve(mapTx.size());
+        for (const auto& it : GetSortedDepthAndScore()) {
+            snapshot->entries.push_back(SummarizeEntry(*it));
+        }
+    }
+
+    // Index the copy after releasing the lock.
+    snapshot->index.reserve(snapshot->entries.size());
+    for (size_t i = 0; i < snapshot->entries.size(); ++i) {
+        snapshot->index.emplace(snapshot->entries[i].txid, i);
+    }
+    std::atomic_store(&m_snapshot, std::shared_ptr<const MempoolSnapshot>{std::move(snapshot)});
+}
+
+std::shared_ptr<const MempoolSnapshot> CTxMemPool::GetSnapshot(std::chrono::milliseconds max_age) const
+{
+    m_snapshot_requested = true;
+    auto snapshot{std::atomic_load(&m_snapshot)};
+    if (!snapshot) return nullptr;
+    if (snapshot->transactions_updated != nTransactionsUpdated &&
+        GetTime<std::chrono::milliseconds>() - snapshot->time > max_age) {
+        return nullptr;
+    }
+    return snapshot;
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -1021,8 +1171,8 @@ void CCoinsViewMemPool::PackageAddTransaction(const CTransactionRef& tx)
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    // Estimate the overhead of mapTx to be 18 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 18 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1071,22 +1221,22 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry)
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
 {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Children s;
-    if (add && entry->GetMemPoolChildren().insert(*child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolChildren().erase(*child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Children& links = entry->GetMemPoolChildren();
+    const size_t usage_before{links.DynamicMemoryUsage()};
+    if (add ? links.insert(*child) : links.erase(*child)) {
+        cachedInnerUsage += links.DynamicMemoryUsage();
+        cachedInnerUsage -= usage_before;
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Parents s;
-    if (add && entry->GetMemPoolParents().insert(*parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && entry->GetMemPoolParents().erase(*parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Parents& links = entry->GetMemPoolParents();
+    const size_t usage_before{links.DynamicMemoryUsage()};
+    if (add ? links.insert(*parent) : links.erase(*parent)) {
+        cachedInnerUsage += links.DynamicMemoryUsage();
+        cachedInnerUsage -= usage_before;
     }
 }
 
@@ -1121,14 +1271,14 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
+    WITH_FRESH_EPOCH(m_epoch);
     std::vector<txiter> candidates;
-    setEntries counted;
     candidates.push_back(entry);
     uint64_t maximum = 0;
     while (candidates.size()) {
         txiter candidate = candidates.back();
         candidates.pop_back();
-        if (!counted.insert(candidate).second) continue;
+        if (visited(candidate)) continue;
         const CTxMemPoolEntry::Parents& parents = candidate->GetMemPoolParentsConst();
         if (parents.size() == 0) {
             maximum = std::max(maximum, candidate->GetCountWithDescendants());
@@ -7,17 +7,22 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <coins.h>
 #include <consensus/amount.h>
 #include <indirectmap.h>
+#include <memusage.h>
 #include <policy/packages.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <sync.h>
@@ -32,6 +37,7 @@
 class CBlockIndex;
 class CChain;
 class CChainState;
+class FeeEstimator;
 extern RecursiveMutex cs_main;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
@@ -69,6 +75,43 @@ struct CompareIteratorByHash {
     }
 };
 
+class CTxMemPoolEntry;
+
+/**
+ * The in-mempool parents or children of a CTxMemPoolEntry, as a set ordered by
+ * txid. Most transactions only have one or two, so the set is a sorted
+ * prevector that keeps them inline and only allocates for larger sets.
+ */
+class CTxMemPoolEntryLinks
+{
+public:
+    /** A reference to a linked entry. Unlike std::reference_wrapper, default constructible, as
+     *  prevector requires. */
+    struct Link {
+        const CTxMemPoolEntry* m_entry{nullptr};
+
+        const CTxMemPoolEntry& get() const { return *m_entry; }
+        operator const CTxMemPoolEntry&() const { return *m_entry; }
+    };
+    using const_iterator = prevector<2, Link>::const_iterator;
+
+    const_iterator begin() const { return m_links.begin(); }
+    const_iterator end() const { return m_links.end(); }
+    size_t size() const { return m_links.size(); }
+    bool empty() const { return m_links.empty(); }
+
+    /** @returns whether entry was added, i.e. not in the set already. */
+    bool insert(const CTxMemPoolEntry& entry);
+    /** @returns whether entry was removed, i.e. in the set. */
+    bool erase(const CTxMemPoolEntry& entry);
+    bool contains(const CTxMemPoolEntry& entry) const;
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(m_links); }
+
+private:
+    prevector<2, Link> m_links;
+};
+
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well
@@ -86,8 +129,8 @@ class CTxMemPoolEntry
 public:
     typedef std::reference_wrapper<const CTxMemPoolEntry> CTxMemPoolEntryRef;
     // two aliases, should the types ever diverge
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorByHash> Parents;
-    typedef std::set<CTxMemPoolEntryRef, CompareIteratorByHash> Children;
+    typedef CTxMemPoolEntryLinks Parents;
+    typedef CTxMemPoolEntryLinks Children;
 
 private:
     const CTransactionRef tx;
@@ -161,6 +204,7 @@ public:
     Children& GetMemPoolChildren() const { return m_children; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint32_t m_block_slot{0}; //!< Index in the package selection state of the last BlockAssembler to look at it
     mutable Epoch::Marker m_epoch_marker; //!< epoch when last touched, useful for graph algorithms
 };
 
@@ -194,6 +238,15 @@ struct mempoolentry_wtxid
     }
 };
 
+// peercoin: extracts the transaction timestamp from CTxMemPoolEntry
+struct mempoolentry_txtime
+{
+    typedef uint32_t result_type;
+    result_type operator() (const CTxMemPoolEntry &entry) const
+    {
+        return entry.GetTx().nTime;
+    }
+};
 
 /** \class CompareTxMemPoolEntryByDescendantScore
  *
@@ -316,6 +369,7 @@ struct descendant_score {};
 struct entry_time {};
 struct ancestor_score {};
 struct index_by_wtxid {};
+struct tx_time {};
 
 /**
  * Information about a mempool transaction.
@@ -350,6 +404,63 @@ enum class MemPoolRemovalReason {
     REPLACED,    //!< Removed for replacement
 };
 
+/** Default for -mempoolsnapshotinterval, in milliseconds. Off, so that RPC sees its own writes. */
+static constexpr int64_t DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL{0};
+
+/** What RPC reports about a mempool entry, copied out of the mempool. */
+struct MempoolEntrySummary {
+    uint256 txid;
+    uint256 wtxid;
+    int32_t vsize;
+    int32_t weight;
+    CAmount fee;
+    CAmount modified_fee;
+    std::chrono::seconds time;
+    unsigned int height;
+    uint64_t descendant_count;
+    uint64_t descendant_size;
+    CAmount descendant_fees;
+    uint64_t ancestor_count;
+    uint64_t ancestor_size;
+    CAmount ancestor_fees;
+    /** In-mempool parents, sorted by txid. */
+    std::vector<uint256> depends;
+    /** In-mempool children. */
+    std::vector<uint256> spent_by;
+    bool unbroadcast;
+};
+
+/**
+ * An immutable copy of the mempool as RPC and REST report it, published by
+ * CTxMemPool::PublishSnapshot() so that readers do not hold the mempool lock
+ * while they walk and serialize the whole mempool.
+ */
+struct MempoolSnapshot {
+    /** Entries in the order of CTxMemPool::queryHashes(). */
+    std::vector<MempoolEntrySummary> entries;
+    /** Position of each txid in entries. */
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> index;
+
+    bool loaded{false};
+    uint64_t bytes{0};
+    size_t usage{0};
+    CAmount total_fee{0};
+    size_t unbroadcast_count{0};
+    uint64_t sequence{0};
+
+    /** Value of CTxMemPool::GetTransactionsUpdated() the snapshot was taken at. */
+    unsigned int transactions_updated{0};
+    /** When the snapshot was taken (mockable time). */
+    std::chrono::milliseconds time{0};
+
+    /** @returns the entry of txid, or nullptr if it was not in the mempool. */
+    const MempoolEntrySummary* Find(const uint256& txid) const
+    {
+        const auto it{index.find(txid)};
+        return it == index.end() ? nullptr : &entries[it->second];
+    }
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -425,6 +536,7 @@ class CTxMemPool
 protected:
     const int m_check_ratio; //!< Value n means that 1 times in n we check.
     std::atomic<unsigned int> nTransactionsUpdated{0}; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
+    FeeEstimator* const minerPolicyEstimator;
 
     uint64_t totalTxSize GUARDED_BY(cs);      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     CAmount m_total_fee GUARDED_BY(cs);       //!< sum of all mempool tx's fees (NOT modified fee)
@@ -470,6 +582,11 @@ public:
                 boost::multi_index::tag<ancestor_score>,
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFee
+            >,
+            // peercoin: sorted by transaction timestamp
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::tag<tx_time>,
+                mempoolentry_txtime
             >
         >
     > indexed_transaction_set;
@@ -509,7 +626,7 @@ public:
 
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
-    uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
@@ -524,24 +641,30 @@ private:
      */
     std::set<uint256> m_unbroadcast_txids GUARDED_BY(cs);
 
+    /** Last published snapshot. Only accessed through std::atomic_load and std::atomic_store. */
+    std::shared_ptr<const MempoolSnapshot> m_snapshot;
+    /** Whether GetSnapshot() was called since the last PublishSnapshot(). */
+    mutable std::atomic<bool> m_snapshot_requested{false};
+
 
     /**
      * Helper function to calculate all in-mempool ancestors of staged_ancestors and apply ancestor
      * and descendant limits (including staged_ancestors thsemselves, entry_size and entry_count).
      * param@[in]   entry_size          Virtual size to include in the limits.
      * param@[in]   entry_count         How many entries to include in the limits.
-     * param@[in]   staged_ancestors    Should contain entries in the mempool.
+     * param@[in]   staged_ancestors    Should contain entries in the mempool, each visited in the
+     *                                  current epoch, as are the entries already in setAncestors.
      * param@[out]  setAncestors        Will be populated with all mempool ancestors.
      */
     bool CalculateAncestorsAndCheckLimits(size_t entry_size,
                                           size_t entry_count,
                                           setEntries& setAncestors,
-                                          CTxMemPoolEntry::Parents &staged_ancestors,
+                                          std::vector<txiter>& staged_ancestors,
                                           uint64_t limitAncestorCount,
                                           uint64_t limitAncestorSize,
                                           uint64_t limitDescendantCount,
                                           uint64_t limitDescendantSize,
-                                          std::string &errString) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+                                          std::string &errString) const EXCLUSIVE_LOCKS_REQUIRED(cs, m_epoch);
 
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
@@ -555,7 +678,7 @@ public:
      * @param[in] estimator is used to estimate appropriate transaction fees.
      * @param[in] check_ratio is the ratio used to determine how often sanity checks will run.
      */
-    explicit CTxMemPool(int check_ratio = 0);
+    explicit CTxMemPool(FeeEstimator* estimator = nullptr, int check_ratio = 0);
 
     /**
      * If sanity-checking is turned on, check makes sure the pool is
@@ -653,7 +776,7 @@ public:
      *  fSearchForParents = whether to search a tx's vin for in-mempool parents, or
      *    look up parents from mapLinks. Must be true for entries not in the mempool
      */
-    bool CalculateMemPoolAncestors(const CTxMemPoolEntry& entry, setEntries& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString, bool fSearchForParents = true) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    bool CalculateMemPoolAncestors(const CTxMemPoolEntry& entry, setEntries& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString, bool fSearchForParents = true) const EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
 
     /** Calculate all in-mempool ancestors of a set of transactions not already in the mempool and
      * check ancestor and descendant limits. Heuristics are used to estimate the ancestor and
@@ -675,13 +798,18 @@ public:
                             uint64_t limitAncestorSize,
                             uint64_t limitDescendantCount,
                             uint64_t limitDescendantSize,
-                            std::string &errString) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+                            std::string &errString) const EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
 
     /** Populate setDescendants with all in-mempool descendants of hash.
      *  Assumes that setDescendants includes all in-mempool descendants of anything
      *  already in it.  */
     void CalculateDescendants(txiter it, setEntries& setDescendants) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** peercoin: Populate setNewer with the in-mempool transactions timestamped
+     *  after nTime, and all their in-mempool descendants. Only the entries
+     *  past nTime in the timestamp index are visited. */
+    void CalculateTxsNewerThan(int64_t nTime, setEntries& setNewer) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
@@ -778,6 +906,27 @@ public:
         return m_sequence_number;
     }
 
+    /** Summarize an entry as MempoolSnapshot does. */
+    MempoolEntrySummary SummarizeEntry(const CTxMemPoolEntry& entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /**
+     * Take a new snapshot of the mempool and publish it to GetSnapshot(), unless
+     * nothing changed since the last one or no reader asked for one since the last
+     * call, so that the mempool is not copied while nobody polls it. The mempool
+     * lock is only held while the entries are copied; readers keep using the
+     * previous snapshot meanwhile.
+     */
+    void PublishSnapshot();
+
+    /**
+     * Get the last published snapshot without taking the mempool lock, and ask for
+     * the next PublishSnapshot() to take a new one if the mempool changed.
+     *
+     * @param[in] max_age  How old a snapshot may be if the mempool changed since it was taken.
+     * @returns the snapshot, or nullptr if none was published or it is too old.
+     */
+    std::shared_ptr<const MempoolSnapshot> GetSnapshot(std::chrono::milliseconds max_age) const;
+
 private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
      *  the descendants for a single transaction that has been added to the
@@ -813,7 +962,7 @@ private:
      */
     void UpdateForDescendants(txiter updateIt, cacheMap& cachedDescendants,
                               const std::set<uint256>& setExclude, std::set<uint256>& descendants_to_remove,
-                              uint64_t ancestor_size_limit, uint64_t ancestor_count_limit) EXCLUSIVE_LOCKS_REQUIRED(cs);
+                              uint64_t ancestor_size_limit, uint64_t ancestor_count_limit) EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
     void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Set ancestor state for an entry */
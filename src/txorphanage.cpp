@@ -5,9 +5,12 @@
 #include <txorphanage.h>
 
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <logging.h>
 #include <policy/policy.h>
+#include <random.h>
 
+#include <algorithm>
 #include <cassert>
 
 /** Expiration time for orphan transactions in seconds */
@@ -39,17 +42,21 @@ bool TxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer)
         return false;
     }
 
-    auto ret = m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, m_orphan_list.size()});
+    PeerOrphans& peer_orphans = m_peer_orphans[peer];
+    const size_t usage = RecursiveDynamicUsage(tx);
+    auto ret = m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, peer_orphans.orphans.size(), usage});
     assert(ret.second);
-    m_orphan_list.push_back(ret.first);
+    peer_orphans.orphans.push_back(ret.first);
+    peer_orphans.usage += usage;
+    m_total_usage += usage;
     // Allow for lookups in the orphan pool by wtxid, as well as txid
     m_wtxid_to_orphan_it.emplace(tx->GetWitnessHash(), ret.first);
     for (const CTxIn& txin : tx->vin) {
-        m_outpoint_to_orphan_it[txin.prevout].insert(ret.first);
+        m_outpoint_to_orphan_it[txin.prevout].push_back(ret.first);
     }
 
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             m_orphans.size(), m_outpoint_to_orphan_it.size());
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u usage %u)\n", hash.ToString(),
+             m_orphans.size(), m_outpoint_to_orphan_it.size(), m_total_usage);
     return true;
 }
 
@@ -64,21 +71,35 @@ int TxOrphanage::EraseTx(const uint256& txid)
         auto itPrev = m_outpoint_to_orphan_it.find(txin.prevout);
         if (itPrev == m_outpoint_to_orphan_it.end())
             continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
+        std::vector<OrphanMap::iterator>& spenders = itPrev->second;
+        const auto spender = std::find(spenders.begin(), spenders.end(), it);
+        if (spender == spenders.end())
+            continue;
+        *spender = spenders.back();
+        spenders.pop_back();
+        if (spenders.empty())
             m_outpoint_to_orphan_it.erase(itPrev);
     }
 
-    size_t old_pos = it->second.list_pos;
-    assert(m_orphan_list[old_pos] == it);
-    if (old_pos + 1 != m_orphan_list.size()) {
-        // Unless we're deleting the last entry in m_orphan_list, move the last
+    auto peer_it = m_peer_orphans.find(it->second.fromPeer);
+    assert(peer_it != m_peer_orphans.end());
+    PeerOrphans& peer_orphans = peer_it->second;
+    size_t old_pos = it->second.peer_pos;
+    assert(peer_orphans.orphans[old_pos] == it);
+    if (old_pos + 1 != peer_orphans.orphans.size()) {
+        // Unless we're deleting the last entry of the peer, move its last
         // entry to the position we're deleting.
-        auto it_last = m_orphan_list.back();
-        m_orphan_list[old_pos] = it_last;
-        it_last->second.list_pos = old_pos;
+        auto it_last = peer_orphans.orphans.back();
+        peer_orphans.orphans[old_pos] = it_last;
+        it_last->second.peer_pos = old_pos;
+    }
+    peer_orphans.orphans.pop_back();
+    peer_orphans.usage -= it->second.usage;
+    m_total_usage -= it->second.usage;
+    if (peer_orphans.orphans.empty()) {
+        assert(peer_orphans.usage == 0);
+        m_peer_orphans.erase(peer_it);
     }
-    m_orphan_list.pop_back();
     m_wtxid_to_orphan_it.erase(it->second.tx->GetWitnessHash());
 
     m_orphans.erase(it);
@@ -89,20 +110,23 @@ void TxOrphanage::EraseForPeer(NodeId peer)
 {
     AssertLockHeld(g_cs_orphans);
 
+    const auto peer_it = m_peer_orphans.find(peer);
+    if (peer_it == m_peer_orphans.end()) return;
+
+    // Copy the txids, the peer's entry goes away with its last orphan
+    std::vector<uint256> txids;
+    txids.reserve(peer_it->second.orphans.size());
+    for (const auto& it : peer_it->second.orphans) {
+        txids.push_back(it->first);
+    }
     int nErased = 0;
-    std::map<uint256, OrphanTx>::iterator iter = m_orphans.begin();
-    while (iter != m_orphans.end())
-    {
-        std::map<uint256, OrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseTx(maybeErase->second.tx->GetHash());
-        }
+    for (const uint256& txid : txids) {
+        nErased += EraseTx(txid);
     }
     if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
-unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
+unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans, size_t max_usage, size_t max_peer_usage)
 {
     AssertLockHeld(g_cs_orphans);
 
@@ -128,12 +152,33 @@ unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
         if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
     }
     FastRandomContext rng;
-    while (m_orphans.size() > max_orphans)
-    {
-        // Evict a random orphan:
-        size_t randompos = rng.randrange(m_orphan_list.size());
-        EraseTx(m_orphan_list[randompos]->first);
+    const auto evict_random = [&](const PeerOrphans& peer_orphans) {
+        const uint256 txid = peer_orphans.orphans[rng.randrange(peer_orphans.orphans.size())]->first;
+        EraseTx(txid);
         ++nEvicted;
+    };
+
+    // Peers over their own budget pay for it first, so that one peer cannot
+    // push out the orphans of everyone else
+    std::vector<NodeId> over_budget;
+    for (const auto& [peer, peer_orphans] : m_peer_orphans) {
+        if (peer_orphans.usage > max_peer_usage) over_budget.push_back(peer);
+    }
+    for (const NodeId peer : over_budget) {
+        for (auto it = m_peer_orphans.find(peer); it != m_peer_orphans.end() && it->second.usage > max_peer_usage; it = m_peer_orphans.find(peer)) {
+            evict_random(it->second);
+        }
+    }
+
+    // Evict from the peer holding the most orphans (or memory, once within the count limit)
+    while (m_orphans.size() > max_orphans || m_total_usage > max_usage)
+    {
+        const bool over_count = m_orphans.size() > max_orphans;
+        const auto largest = std::max_element(m_peer_orphans.begin(), m_peer_orphans.end(), [over_count](const auto& a, const auto& b) {
+            return over_count ? a.second.orphans.size() < b.second.orphans.size() : a.second.usage < b.second.usage;
+        });
+        assert(largest != m_peer_orphans.end());
+        evict_random(largest->second);
     }
     return nEvicted;
 }
@@ -161,6 +206,14 @@ bool TxOrphanage::HaveTx(const GenTxid& gtxid) const
     }
 }
 
+size_t TxOrphanage::UsageByPeer(NodeId peer) const
+{
+    AssertLockHeld(g_cs_orphans);
+
+    const auto it = m_peer_orphans.find(peer);
+    return it == m_peer_orphans.end() ? 0 : it->second.usage;
+}
+
 std::pair<CTransactionRef, NodeId> TxOrphanage::GetTx(const uint256& txid) const
 {
     AssertLockHeld(g_cs_orphans);
@@ -173,6 +226,7 @@ std::pair<CTransactionRef, NodeId> TxOrphanage::GetTx(const uint256& txid) const
 void TxOrphanage::EraseForBlock(const CBlock& block)
 {
     LOCK(g_cs_orphans);
+    if (m_orphans.empty()) return;
 
     std::vector<uint256> vOrphanErase;
 
@@ -9,6 +9,9 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <sync.h>
+#include <util/hasher.h>
+
+#include <unordered_map>
 
 /** Guards orphan transactions and extra txs for compact blocks */
 extern RecursiveMutex g_cs_orphans;
@@ -16,7 +19,7 @@ extern RecursiveMutex g_cs_orphans;
 /** A class to track orphan transactions (failed on TX_MISSING_INPUTS)
  * Since we cannot distinguish orphans from bad transactions with
  * non-existent inputs, we heavily limit the number of orphans
- * we keep and the duration we keep them for.
+ * we keep, the memory they use and the duration we keep them for.
  */
 class TxOrphanage {
 public:
@@ -40,8 +43,11 @@ public:
     /** Erase all orphans included in or invalidated by a new block */
     void EraseForBlock(const CBlock& block) LOCKS_EXCLUDED(::g_cs_orphans);
 
-    /** Limit the orphanage to the given maximum */
-    unsigned int LimitOrphans(unsigned int max_orphans) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    /** Limit the orphanage to the given maximum number of orphans and memory usage, and the
+     *  orphans of each peer to max_peer_usage. Peers over their budget lose random orphans of
+     *  their own first; beyond that, random orphans of the peer using the most memory are evicted.
+     *  @returns the number of orphans evicted */
+    unsigned int LimitOrphans(unsigned int max_orphans, size_t max_usage, size_t max_peer_usage) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 
     /** Add any orphans that list a particular tx as a parent into a peer's work set
      * (ie orphans that may have found their final missing parent, and so should be reconsidered for the mempool) */
@@ -54,35 +60,48 @@ public:
         return m_orphans.size();
     }
 
+    /** Return the memory usage of all orphans */
+    size_t TotalUsage() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) { return m_total_usage; }
+
+    /** Return the memory usage of the orphans announced by a peer */
+    size_t UsageByPeer(NodeId peer) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
 protected:
     struct OrphanTx {
         CTransactionRef tx;
         NodeId fromPeer;
         int64_t nTimeExpire;
-        size_t list_pos;
+        /** Position in the announcing peer's PeerOrphans::orphans */
+        size_t peer_pos;
+        /** Memory usage of tx, counted against the limits */
+        size_t usage;
     };
 
     /** Map from txid to orphan transaction record. Limited by
-     *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS */
+     *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS and
+     *  -maxorphansize/DEFAULT_MAX_ORPHAN_SIZE */
     std::map<uint256, OrphanTx> m_orphans GUARDED_BY(g_cs_orphans);
 
     using OrphanMap = decltype(m_orphans);
 
-    struct IteratorComparator
-    {
-        template<typename I>
-        bool operator()(const I& a, const I& b) const
-        {
-            return &(*a) < &(*b);
-        }
+    /** The orphans announced by one peer */
+    struct PeerOrphans {
+        /** Sum of OrphanTx::usage */
+        size_t usage{0};
+        /** Orphans in vector for quick random eviction */
+        std::vector<OrphanMap::iterator> orphans;
     };
 
-    /** Index from the parents' COutPoint into the m_orphans. Used
-     *  to remove orphan transactions from the m_orphans */
-    std::map<COutPoint, std::set<OrphanMap::iterator, IteratorComparator>> m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
+    /** Orphans by announcing peer. Peers without orphans have no entry. */
+    std::map<NodeId, PeerOrphans> m_peer_orphans GUARDED_BY(g_cs_orphans);
+
+    /** Memory usage of all orphans */
+    size_t m_total_usage GUARDED_BY(g_cs_orphans){0};
 
-    /** Orphan transactions in vector for quick random eviction */
-    std::vector<OrphanMap::iterator> m_orphan_list GUARDED_BY(g_cs_orphans);
+    /** Index from the parents' COutPoint into the m_orphans, so that a block or an accepted
+     *  transaction only costs a lookup per input or output. Most outpoints are spent by a
+     *  single orphan. */
+    std::unordered_map<COutPoint, std::vector<OrphanMap::iterator>, SaltedOutpointHasher> m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
 
     /** Index from wtxid into the m_orphans to lookup orphan
      *  transactions using their witness ids. */
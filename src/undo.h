@@ -39,7 +39,7 @@ struct TxInUndoFormatter
         ::Unserialize(s, VARINT(nCode));
         txout.nHeight = nCode >> 2;
         txout.fCoinBase = nCode & 1;
-        txout.fCoinStake = nCode & 2;
+        txout.fCoinStake = (nCode & 2) != 0;
         ::Unserialize(s, VARINT(txout.nTime));
         if (txout.nHeight > 0) {
             // Old versions stored the version number for the last spend of
@@ -7,9 +7,14 @@
 
 #include <util/fastrange.h>
 
+#include <crypto/common.h>
+#include <span.h>
 #include <streams.h>
 
 #include <cstdint>
+#include <ios>
+#include <stdexcept>
+#include <vector>
 
 template <typename OStream>
 void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uint64_t x)
@@ -42,4 +47,177 @@ uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
     return (q << P) + r;
 }
 
+/**
+ * Golomb-Rice encoder producing the same bits as GolombRiceEncode with a
+ * BitStreamWriter, but collecting them in a 64-bit word that is appended to
+ * the output once full, instead of a byte at a time.
+ */
+class GolombRiceWriter
+{
+private:
+    std::vector<unsigned char>& m_out;
+
+    /// Pending bits, from the most significant bit down.
+    uint64_t m_buffer{0};
+
+    /// Number of pending bits in m_buffer.
+    int m_bits{0};
+
+    /** Write the nbits (0 to 64) least significant bits of data. */
+    void Put(uint64_t data, int nbits)
+    {
+        if (nbits == 0) return;
+        if (nbits < 64) data &= (uint64_t{1} << nbits) - 1;
+        const int free = 64 - m_bits;
+        if (nbits < free) {
+            m_buffer |= data << (free - nbits);
+            m_bits += nbits;
+            return;
+        }
+        const int rest = nbits - free;
+        m_buffer |= data >> rest;
+        unsigned char word[8];
+        WriteBE64(word, m_buffer);
+        m_out.insert(m_out.end(), word, word + 8);
+        m_buffer = rest > 0 ? data << (64 - rest) : 0;
+        m_bits = rest;
+    }
+
+public:
+    explicit GolombRiceWriter(std::vector<unsigned char>& out) : m_out(out) {}
+
+    ~GolombRiceWriter()
+    {
+        Flush();
+    }
+
+    void Encode(uint8_t P, uint64_t x)
+    {
+        if (P > 64) {
+            throw std::out_of_range("P must be between 0 and 64");
+        }
+        // Write quotient as unary-encoded: q 1's followed by one 0.
+        uint64_t q = P < 64 ? x >> P : 0;
+        while (q >= 64) {
+            Put(~uint64_t{0}, 64);
+            q -= 64;
+        }
+        // The remaining 1's, the 0 and the remainder usually fit in a single write.
+        const int nbits = static_cast<int>(q) + 1;
+        const uint64_t unary = ((uint64_t{1} << q) - 1) << 1;
+        if (nbits + P <= 64) {
+            Put((unary << P) | (x & ((uint64_t{1} << P) - 1)), nbits + P);
+        } else {
+            Put(unary, nbits);
+            Put(x, P);
+        }
+    }
+
+    /** Write any pending bits, padding with 0's to the next byte boundary. */
+    void Flush()
+    {
+        for (int i = 0; i < m_bits; i += 8) {
+            m_out.push_back(static_cast<unsigned char>(m_buffer >> (56 - i)));
+        }
+        m_buffer = 0;
+        m_bits = 0;
+    }
+};
+
+/**
+ * Golomb-Rice decoder reading the output of GolombRiceEncode from a byte span.
+ * Bits are loaded eight bytes at a time and the unary quotient is decoded by
+ * counting leading 1's, instead of reading one bit at a time.
+ */
+class GolombRiceReader
+{
+private:
+    Span<const unsigned char> m_data;
+
+    /// Offset of the next byte of m_data to load.
+    size_t m_pos{0};
+
+    /// Loaded bits, from the most significant bit down. The bits after the
+    /// first m_bits are either 0 or the next bits of the data.
+    uint64_t m_buffer{0};
+
+    /// Number of loaded bits not yet returned.
+    int m_bits{0};
+
+    void Refill()
+    {
+        if (m_pos + 8 <= m_data.size()) {
+            m_buffer |= ReadBE64(m_data.data() + m_pos) >> m_bits;
+            const int bytes = (64 - m_bits) / 8;
+            m_pos += bytes;
+            m_bits += 8 * bytes;
+            return;
+        }
+        while (m_bits <= 56 && m_pos < m_data.size()) {
+            m_buffer |= uint64_t{m_data[m_pos++]} << (56 - m_bits);
+            m_bits += 8;
+        }
+    }
+
+    void Consume(int nbits)
+    {
+        m_buffer = nbits < 64 ? m_buffer << nbits : 0;
+        m_bits -= nbits;
+    }
+
+public:
+    explicit GolombRiceReader(Span<const unsigned char> data) : m_data(data) {}
+
+    /** Read the specified number of bits, returned in the nbits least significant bits. */
+    uint64_t Read(int nbits)
+    {
+        if (nbits < 0 || nbits > 64) {
+            throw std::out_of_range("nbits must be between 0 and 64");
+        }
+        if (nbits == 0) return 0;
+        if (nbits > 56) {
+            const uint64_t high = Read(nbits - 32);
+            return (high << 32) | Read(32);
+        }
+        if (m_bits < nbits) {
+            Refill();
+            if (m_bits < nbits) {
+                throw std::ios_base::failure("GolombRiceReader::Read(): end of data");
+            }
+        }
+        const uint64_t data = m_buffer >> (64 - nbits);
+        Consume(nbits);
+        return data;
+    }
+
+    uint64_t Decode(uint8_t P)
+    {
+        // Read unary-encoded quotient: q 1's followed by one 0.
+        uint64_t q = 0;
+        while (true) {
+            if (m_bits == 0) {
+                Refill();
+                if (m_bits == 0) {
+                    throw std::ios_base::failure("GolombRiceReader::Decode(): end of data");
+                }
+            }
+            const int ones = 64 - static_cast<int>(CountBits(~m_buffer));
+            if (ones < m_bits) {
+                q += ones;
+                Consume(ones + 1);
+                break;
+            }
+            q += m_bits;
+            Consume(m_bits);
+        }
+
+        const uint64_t r = Read(P);
+
+        return (q << P) + r;
+    }
+
+    /** Number of bytes of the data read so far, counting a partly read byte. */
+    size_t BytesConsumed() const { return m_pos - m_bits / 8; }
+};
+
 #endif // BITCOIN_UTIL_GOLOMBRICE_H
@@ -16,6 +16,7 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <cuckoocache.h>
+#include <dbwrapper.h>
 #include <flatfile.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
@@ -38,6 +39,7 @@
 #include <script/sigcache.h>
 #include <shutdown.h>
 #include <signet.h>
+#include <threadinterrupt.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -49,6 +51,7 @@
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <util/trace.h>
 #include <util/translation.h>
 #include <validationinterface.h>
@@ -72,8 +75,8 @@ using node::CBlockIndexWorkComparator;
 using node::CCoinsStats;
 using node::CoinStatsHashType;
 using node::GetUTXOStats;
-using node::OpenBlockFile;
 using node::ReadBlockFromDisk;
+using node::ReadTxFromDisk;
 using node::SnapshotMetadata;
 using node::UNDOFILE_CHUNK_SIZE;
 using node::UndoReadFromDisk;
@@ -95,6 +98,8 @@ static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 /** Time to wait between flushing chainstate to disk. */
 static constexpr std::chrono::hours DATABASE_FLUSH_INTERVAL{24};
+/** Share of the coins cache budget kept resident after a size-triggered flush. */
+static constexpr size_t COINS_CACHE_RETAIN_PERCENT{50};
 /** Maximum age of our tip for us to be considered current for fee estimation */
 static constexpr std::chrono::hours MAX_FEE_ESTIMATION_TIP_AGE{3};
 const std::vector<std::string> CHECKLEVEL_DOC {
@@ -282,7 +287,10 @@ bool CheckSequenceLocks(CBlockIndex* tip,
 }
 
 // Returns the script flags which should be checked for a given block
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
+
+static bool CacheScriptChecksInParallel(const std::vector<std::pair<const CTransaction*, PrecomputedTransactionData*>>& txs,
+                                        Span<const unsigned int> flags, unsigned int consensus_flags) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 static void LimitMempoolSize(CTxMemPool& pool, CCoinsViewCache& coins_cache, size_t limit, std::chrono::seconds age)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs)
@@ -536,6 +544,13 @@ public:
      */
     PackageMempoolAcceptResult AcceptPackage(const Package& package, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Verify the scripts of the transactions that pass PreChecks() on the script check threads,
+     * ahead of accepting them one by one. Transactions spending outputs of the others fail
+     * PreChecks() until those are in the mempool and are left to their acceptance.
+     */
+    void PreVerifyScripts(const std::vector<CTransactionRef>& txns, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 private:
     // All the intermediate state that gets passed between the various levels
     // of checking a given transaction.
@@ -600,6 +615,13 @@ private:
     // utxo set or in the mempool.
     bool ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Run the script checks of several transactions that passed PreChecks() on the script check
+    // threads, under the policy flags and, unless only testing acceptance, the consensus flags.
+    // PolicyScriptChecks() then finds their signatures cached and, if they all pass,
+    // ConsensusScriptChecks() only looks up the cached executions; otherwise those tell which
+    // transaction failed.
+    bool ParallelScriptChecks(const ATMPArgs& args, std::vector<Workspace>& workspaces) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Try to add the transaction to the mempool, removing any conflicts first.
     // Returns true if the transaction is in the mempool after any size
     // limiting is performed, false otherwise.
@@ -897,6 +919,30 @@ bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+bool MemPoolAccept::ParallelScriptChecks(const ATMPArgs& args, std::vector<Workspace>& workspaces)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+    if (!g_parallel_script_checks || workspaces.size() < 2) return false;
+
+    const unsigned int consensus_flags{GetBlockScriptFlags(m_active_chainstate.m_chain.Tip(), args.m_chainparams.GetConsensus())};
+    const unsigned int flags[]{STANDARD_SCRIPT_VERIFY_FLAGS, consensus_flags};
+    std::vector<std::pair<const CTransaction*, PrecomputedTransactionData*>> txs;
+    txs.reserve(workspaces.size());
+    for (Workspace& ws : workspaces) {
+        const CTransaction& tx = *ws.m_ptx;
+        // PreChecks() brought the coins spent by the transaction into m_view.
+        std::vector<CTxOut> spent_outputs;
+        spent_outputs.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            spent_outputs.emplace_back(m_view.AccessCoin(txin.prevout).out);
+        }
+        ws.m_precomputed_txdata.Init(tx, std::move(spent_outputs));
+        txs.emplace_back(&tx, &ws.m_precomputed_txdata);
+    }
+    return CacheScriptChecksInParallel(txs, Span{flags}.first(args.m_test_accept ? 1 : 2), consensus_flags);
+}
+
 bool MemPoolAccept::Finalize(const ATMPArgs& args, Workspace& ws)
 {
     AssertLockHeld(cs_main);
@@ -1064,6 +1110,11 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         return PackageMempoolAcceptResult(package_state, std::move(results));
     }
 
+    // Verify the scripts of the whole package on the script check threads first, so that the
+    // per-transaction script checks below and in SubmitPackage() find their signatures, and
+    // their executions under the consensus flags, cached.
+    ParallelScriptChecks(args, workspaces);
+
     for (Workspace& ws : workspaces) {
         if (!PolicyScriptChecks(args, ws)) {
             // Exit early to avoid doing pointless work. Update the failed tx result; the rest are unfinished.
@@ -1090,6 +1141,19 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
     return PackageMempoolAcceptResult(package_state, std::move(results));
 }
 
+void MemPoolAccept::PreVerifyScripts(const std::vector<CTransactionRef>& txns, ATMPArgs& args)
+{
+    AssertLockHeld(cs_main);
+    LOCK(m_pool.cs);
+
+    std::vector<Workspace> workspaces;
+    workspaces.reserve(txns.size());
+    for (const CTransactionRef& tx : txns) {
+        if (!PreChecks(args, workspaces.emplace_back(tx))) workspaces.pop_back();
+    }
+    ParallelScriptChecks(args, workspaces);
+}
+
 PackageMempoolAcceptResult MemPoolAccept::AcceptPackage(const Package& package, ATMPArgs& args)
 {
     AssertLockHeld(cs_main);
@@ -1495,6 +1559,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
 }
 
 bool CScriptCheck::operator()() {
+    if (pblock) return CheckBlockSignature(*pblock);
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
     return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), &error);
@@ -1519,6 +1584,15 @@ void InitScriptExecutionCache() {
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+/** Return the script execution cache entry for the input scripts of a transaction verified with the given flags */
+static uint256 ScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 entry;
+    CSHA256 hasher = g_scriptExecutionCacheHasher;
+    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(entry.begin());
+    return entry;
+}
+
 /**
  * Check whether all of this transaction's input scripts succeed.
  *
@@ -1554,9 +1628,7 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
     // correct (ie that the transaction hash which is in tx's prevouts
     // properly commits to the scriptPubKey in the inputs view of that
     // transaction).
-    uint256 hashCacheEntry;
-    CSHA256 hasher = g_scriptExecutionCacheHasher;
-    hasher.Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    const uint256 hashCacheEntry{ScriptExecutionCacheEntry(tx, flags)};
     AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
     if (g_scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
         return true;
@@ -1674,7 +1746,6 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
 {
     AssertLockHeld(::cs_main);
-    bool fClean = true;
 
     CBlockUndo blockUndo;
     if (!UndoReadFromDisk(blockUndo, pindex)) {
@@ -1682,6 +1753,14 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
+    return DisconnectBlock(block, blockUndo, pindex, view);
+}
+
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, CBlockUndo& blockUndo, const CBlockIndex* pindex, CCoinsViewCache& view)
+{
+    AssertLockHeld(::cs_main);
+    bool fClean = true;
+
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
         error("DisconnectBlock(): block and undo data inconsistent");
         return DISCONNECT_FAILED;
@@ -1745,7 +1824,44 @@ void StopScriptCheckWorkerThreads()
     scriptcheckqueue.StopWorkerThreads();
 }
 
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams)
+/**
+ * Verify the input scripts of transactions, whose txdata holds their spent outputs, under each of
+ * the given flags on the script check threads, storing their signatures in the signature cache.
+ * If all scripts pass, the executions under consensus_flags are recorded in the script execution
+ * cache, so that CheckInputScripts() with those flags does not verify them again; executions under
+ * other flags are never recorded, like in ConsensusScriptChecks(). If any fails, nothing is
+ * recorded. Returns false without verifying anything if parallel script checks are disabled.
+ */
+static bool CacheScriptChecksInParallel(const std::vector<std::pair<const CTransaction*, PrecomputedTransactionData*>>& txs,
+                                        Span<const unsigned int> flags, unsigned int consensus_flags)
+{
+    AssertLockHeld(cs_main);
+    if (!g_parallel_script_checks) return false;
+
+    std::vector<uint256> cache_entries;
+    std::vector<CScriptCheck> checks;
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    for (const auto& [tx, txdata] : txs) {
+        for (const unsigned int flag : flags) {
+            const uint256 cache_entry{ScriptExecutionCacheEntry(*tx, flag)};
+            if (g_scriptExecutionCache.contains(cache_entry, /*erase=*/false)) continue;
+            for (unsigned int n = 0; n < tx->vin.size(); ++n) {
+                checks.emplace_back(txdata->m_spent_outputs[n], *tx, n, flag, /*cacheIn=*/true, txdata);
+            }
+            control.Add(checks);
+            checks.clear();
+            if (flag == consensus_flags) cache_entries.push_back(cache_entry);
+        }
+    }
+    if (!control.Wait()) return false;
+
+    for (const uint256& cache_entry : cache_entries) {
+        g_scriptExecutionCache.insert(cache_entry);
+    }
+    return true;
+}
+
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams)
 {
     unsigned int flags = SCRIPT_VERIFY_NONE;
 
@@ -1788,6 +1904,16 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consens
 
 
 
+/** The block signature is verified on the script check queue together with the input scripts, so
+ *  when the queue fails it is checked again to keep the bad-blk-sign reject reason. */
+static bool BlockChecksFailed(const CBlock& block, BlockValidationState& state, bool fBlockSigQueued)
+{
+    if (fBlockSigQueued && !CheckBlockSignature(block)) {
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-sign", strprintf("%s : bad block signature", __func__));
+    }
+    return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "block-validation-failed");
+}
+
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
 static int64_t nTimeVerify = 0;
@@ -1797,19 +1923,29 @@ static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
 // These checks can only be done when all previous block have been added.
-bool PeercoinContextualBlockChecks(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex, bool fJustCheck, CChainState& chainstate)
+// If fParallel is set, the coinstake signature is verified on the script
+// check threads while the kernel and stake modifier are computed. The check
+// uses its own control, so the caller must not hold one on scriptcheckqueue.
+bool PeercoinContextualBlockChecks(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex, bool fJustCheck, CChainState& chainstate, bool fParallel = false)
 {
     uint256 hashProofOfStake = uint256();
     // peercoin: verify hash target and signature of coinstake tx
-    if (block.IsProofOfStake() && !CheckProofOfStake(state, pindex->pprev, block.vtx[1], block.nBits, hashProofOfStake, block.vtx[1]->nTime ? block.vtx[1]->nTime : block.nTime, chainstate)) {
+    // coinstake_txdata must outlive control, which waits for the check on every return path
+    PrecomputedTransactionData coinstake_txdata;
+    CCheckQueueControl<CScriptCheck> control(fParallel ? &scriptcheckqueue : nullptr);
+    std::vector<CScriptCheck> vChecks;
+    if (block.IsProofOfStake() && !CheckProofOfStake(state, pindex->pprev, block.vtx[1], block.nBits, hashProofOfStake, block.vtx[1]->nTime ? block.vtx[1]->nTime : block.nTime, chainstate, fParallel ? &vChecks : nullptr, &coinstake_txdata)) {
         LogPrintf("WARNING: %s: check proof-of-stake failed for block %s\n", __func__, block.GetHash().ToString());
         return false; // do not error here as we expect this during initial block download
     }
+    control.Add(vChecks);
 
     // peercoin: check for duplicity of stake
     if (block.IsProofOfStake()) {
         std::pair<COutPoint, unsigned int> proofOfStake = block.GetProofOfStake();
         if (pindex->IsProofOfStake() && proofOfStake.first == pindex->prevoutStake) {
+            if (!control.Wait())
+                return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "invalid-pos-script", strprintf("%s: VerifyScript failed on coinstake %s", __func__, block.vtx[1]->GetHash().ToString()));
             LogPrintf("WARNING: %s: duplicate proof-of-stake in block %s, invalidating tip\n", __func__, block.GetHash().ToString());
             chainstate.InvalidateBlock(state, pindex);
             return error("ConnectBlock() : Duplicate coinstake found");
@@ -1850,6 +1986,10 @@ bool PeercoinContextualBlockChecks(const CBlock& block, BlockValidationState& st
     if (!CheckStakeModifierCheckpoints(pindex->nHeight, nStakeModifierChecksum))
         return error("ConnectBlock() : Rejected by stake modifier checkpoint height=%d, modifier=0x%016llx", pindex->nHeight, nStakeModifier);
 
+    // the stake must not be recorded before its coinstake signature is known to be valid
+    if (!control.Wait())
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "invalid-pos-script", strprintf("%s: VerifyScript failed on coinstake %s", __func__, block.vtx[1]->GetHash().ToString()));
+
     if (fJustCheck)
         return true;
 
@@ -1884,9 +2024,19 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
 
     int64_t nTimeStart = GetTimeMicros();
 
-    if (pindex->nStakeModifier == 0 && pindex->nStakeModifierChecksum == 0 && !PeercoinContextualBlockChecks(block, state, pindex, fJustCheck, m_chainman.ActiveChainstate()))
+    // Precomputed transaction data pointers must not be invalidated
+    // until after `control` has run the script checks (potentially
+    // in multiple threads). Preallocate the vector size so a new allocation
+    // doesn't invalidate pointers into the vector, and keep txsdata in scope
+    // for as long as `control`.
+    // peercoin: the block signature check is queued on the same control as
+    // the input scripts. The coinstake is checked before, on its own control.
+    if (pindex->nStakeModifier == 0 && pindex->nStakeModifierChecksum == 0 && !PeercoinContextualBlockChecks(block, state, pindex, fJustCheck, m_chainman.ActiveChainstate(), g_parallel_script_checks))
         return error("%s: failed PoS check %s", __func__, state.ToString());
 
+    std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
+    CCheckQueueControl<CScriptCheck> control(g_parallel_script_checks ? &scriptcheckqueue : nullptr);
+
     // Check it again in case a previous version let a bad block in
     // NOTE: We don't currently (re-)invoke ContextualCheckBlock() or
     // ContextualCheckBlockHeader() here. This means that if we add a new
@@ -1900,7 +2050,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
-    if (!CheckBlock(block, state, m_params.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    std::vector<CScriptCheck> vBlockChecks;
+    if (!CheckBlock(block, state, m_params.GetConsensus(), !fJustCheck, !fJustCheck, true, g_parallel_script_checks ? &vBlockChecks : nullptr)) {
         if (state.GetResult() == BlockValidationResult::BLOCK_MUTATED) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -1909,6 +2060,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         }
         return error("%s: Consensus::CheckBlock: %s", __func__, state.ToString());
     }
+    // a failed block signature is reported as such, see BlockChecksFailed()
+    const bool fBlockSigQueued{!vBlockChecks.empty()};
+    control.Add(vBlockChecks);
 
     // verify that the view's current state corresponds to the previous block
     uint256 hashPrevBlock = pindex->pprev == nullptr ? uint256() : pindex->pprev->GetBlockHash();
@@ -1919,6 +2073,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block_hash == m_params.GetConsensus().hashGenesisBlock) {
+        if (!control.Wait())
+            return BlockChecksFailed(block, state, fBlockSigQueued);
         if (!fJustCheck)
             view.SetBestBlock(pindex->GetBlockHash());
         return true;
@@ -2058,14 +2214,6 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
 
     CBlockUndo blockundo;
 
-    // Precomputed transaction data pointers must not be invalidated
-    // until after `control` has run the script checks (potentially
-    // in multiple threads). Preallocate the vector size so a new allocation
-    // doesn't invalidate pointers into the vector, and keep txsdata in scope
-    // for as long as `control`.
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &scriptcheckqueue : nullptr);
-    std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
-
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int64_t nValueIn = 0;
@@ -2153,7 +2301,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
 
     if (!control.Wait()) {
         LogPrintf("ERROR: %s: CheckQueue failed\n", __func__);
-        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "block-validation-failed");
+        return BlockChecksFailed(block, state, fBlockSigQueued);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
@@ -2312,7 +2460,18 @@ bool CChainState::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Disk space is too low!"));
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
+            // Only an explicit flush empties the cache; otherwise the dirty
+            // coins are written and the rest stays warm, evicting the least
+            // recently used entries when the cache has reached its limit.
+            const bool empty_cache = mode == FlushStateMode::ALWAYS;
+            if (empty_cache ? !CoinsTip().Flush() : !CoinsTip().Sync())
+                return AbortNode(state, "Failed to write to coin database");
+            if (!empty_cache && (fCacheLarge || fCacheCritical)) {
+                CoinsTip().Trim(m_coinstip_cache_size_bytes / 100 * COINS_CACHE_RETAIN_PERCENT);
+            }
+            // Durability barrier for the coins batches queued on the database
+            // writer thread. Indexes sync their own databases when they commit.
+            if (!CoinsDB().SyncAsyncWrites())
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
@@ -2465,6 +2624,126 @@ bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTr
     return true;
 }
 
+/** Maximum number of blocks whose block and undo data are held in memory at
+ *  once while disconnecting several blocks in DisconnectTips. */
+static constexpr size_t MAX_DISCONNECT_BATCH = 32;
+
+/** Disconnect every block above pindexFork from m_chain.
+  * Block and undo data for up to MAX_DISCONNECT_BATCH blocks are read from
+  * disk on several threads while the caller keeps holding cs_main; the
+  * readers only use positions looked up beforehand. The whole batch is
+  * applied to a single CCoinsViewCache layer that is flushed once. Afterwards
+  * the tip is moved back one block at a time, with UpdateTip and the
+  * BlockDisconnected signal for each block, and the mempool is left in the
+  * same state as after repeated DisconnectTip calls.
+  */
+bool CChainState::DisconnectTips(BlockValidationState& state, const CBlockIndex* pindexFork, DisconnectedBlockTransactions* disconnectpool)
+{
+    AssertLockHeld(cs_main);
+    if (m_mempool) AssertLockHeld(m_mempool->cs);
+
+    while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
+        std::vector<CBlockIndex*> to_disconnect;
+        for (CBlockIndex* pindex = m_chain.Tip(); pindex && pindex != pindexFork && to_disconnect.size() < MAX_DISCONNECT_BATCH; pindex = pindex->pprev) {
+            to_disconnect.push_back(pindex);
+        }
+        // Nothing to gain for a single block, and the genesis block has no undo data.
+        if (to_disconnect.size() == 1 || !to_disconnect.back()->pprev) {
+            if (!DisconnectTip(state, disconnectpool)) return false;
+            continue;
+        }
+
+        // Read blocks and undo data in parallel. Positions are looked up here,
+        // under cs_main, so that the readers don't need it.
+        const size_t count = to_disconnect.size();
+        std::vector<FlatFilePos> block_pos(count), undo_pos(count);
+        std::vector<std::shared_ptr<CBlock>> blocks(count);
+        std::vector<CBlockUndo> undos(count);
+        for (size_t i = 0; i < count; ++i) {
+            block_pos[i] = to_disconnect[i]->GetBlockPos();
+            undo_pos[i] = to_disconnect[i]->GetUndoPos();
+            blocks[i] = std::make_shared<CBlock>();
+        }
+        std::atomic<size_t> next{0};
+        std::atomic<bool> read_ok{true};
+        const auto reader = [&] {
+            for (size_t i = next++; i < count && read_ok; i = next++) {
+                const CBlockIndex* pindex = to_disconnect[i];
+                try {
+                    if (!ReadBlockFromDisk(*blocks[i], block_pos[i], m_params.GetConsensus()) || blocks[i]->GetHash() != pindex->GetBlockHash()) {
+                        LogPrintf("ERROR: %s: Failed to read block %s\n", __func__, pindex->GetBlockHash().ToString());
+                        read_ok = false;
+                    } else if (!UndoReadFromDisk(undos[i], undo_pos[i], pindex->pprev->GetBlockHash())) {
+                        LogPrintf("ERROR: %s: Failed to read undo data for block %s\n", __func__, pindex->GetBlockHash().ToString());
+                        read_ok = false;
+                    }
+                } catch (const std::exception& e) {
+                    LogPrintf("ERROR: %s: Failed to read block %s: %s\n", __func__, pindex->GetBlockHash().ToString(), e.what());
+                    read_ok = false;
+                }
+            }
+        };
+        int64_t nStart = GetTimeMicros();
+        {
+            std::vector<std::thread> readers;
+            const size_t num_readers = std::min<size_t>(count, std::max(GetNumCores(), 1)) - 1;
+            for (size_t i = 0; i < num_readers; ++i) {
+                readers.emplace_back(&util::TraceThread, "disconnread", reader);
+            }
+            reader();
+            for (std::thread& t : readers) t.join();
+        }
+        if (!read_ok) {
+            return error("DisconnectTips(): Failed to read block or undo data");
+        }
+        LogPrint(BCLog::BENCH, "- Read %u blocks for disconnect: %.2fms\n", (unsigned)count, (GetTimeMicros() - nStart) * MILLI);
+
+        // Apply the whole batch atomically to the chain state.
+        nStart = GetTimeMicros();
+        {
+            CCoinsViewCache view(&CoinsTip());
+            for (size_t i = 0; i < count; ++i) {
+                assert(view.GetBestBlock() == to_disconnect[i]->GetBlockHash());
+                if (DisconnectBlock(*blocks[i], undos[i], to_disconnect[i], view) != DISCONNECT_OK)
+                    return error("DisconnectTips(): DisconnectBlock %s failed", to_disconnect[i]->GetBlockHash().ToString());
+            }
+            bool flushed = view.Flush();
+            assert(flushed);
+        }
+        LogPrint(BCLog::BENCH, "- Disconnect %u blocks: %.2fms\n", (unsigned)count, (GetTimeMicros() - nStart) * MILLI);
+        // Write the chain state to disk, if necessary.
+        if (!FlushStateToDisk(state, FlushStateMode::IF_NEEDED)) {
+            return false;
+        }
+
+        if (disconnectpool && m_mempool) {
+            // Save transactions to re-add to mempool at end of reorg, in the
+            // same order as disconnecting the blocks one at a time would
+            for (const auto& pblock : blocks) {
+                for (auto it = pblock->vtx.rbegin(); it != pblock->vtx.rend(); ++it) {
+                    disconnectpool->addTransaction(*it);
+                }
+                while (disconnectpool->DynamicMemoryUsage() > MAX_DISCONNECTED_TX_POOL_SIZE * 1000) {
+                    // Drop the earliest entry, and remove its children from the mempool.
+                    auto it = disconnectpool->queuedTx.get<insertion_order>().begin();
+                    m_mempool->removeRecursive(**it, MemPoolRemovalReason::REORG);
+                    disconnectpool->removeEntry(it);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            m_chain.SetTip(to_disconnect[i]->pprev);
+
+            UpdateTip(to_disconnect[i]->pprev);
+            // Let wallets know transactions went from 1-confirmed to
+            // 0-confirmed or conflicted:
+            GetMainSignals().BlockDisconnected(blocks[i], to_disconnect[i]);
+        }
+    }
+    return true;
+}
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
@@ -2671,8 +2950,8 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, CBlockIndex
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
-    while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, &disconnectpool)) {
+    if (m_chain.Tip() && m_chain.Tip() != pindexFork) {
+        if (!DisconnectTips(state, pindexFork, &disconnectpool)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             MaybeUpdateMempoolForReorg(disconnectpool, false);
@@ -3148,7 +3427,7 @@ static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& st
     return true;
 }
 
-bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSignature)
+bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSignature, std::vector<CScriptCheck>* pvChecks)
 {
     // These are checks that are independent of context.
 
@@ -3251,8 +3530,13 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
     // peercoin: check block signature
     // Only check block signature if check merkle root, c.f. commit 3cd01fdf
     // rfc6: validate signatures of proof of stake blocks only after 0.8 fork
-    if (fCheckMerkleRoot && fCheckSignature && (block.IsProofOfStake() || !IsBTC16BIPsEnabled(block.GetBlockTime())) && !CheckBlockSignature(block))
-        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-sign", strprintf("%s : bad block signature", __func__));
+    if (fCheckMerkleRoot && fCheckSignature && (block.IsProofOfStake() || !IsBTC16BIPsEnabled(block.GetBlockTime()))) {
+        if (pvChecks) {
+            pvChecks->emplace_back(block);
+        } else if (!CheckBlockSignature(block)) {
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-sign", strprintf("%s : bad block signature", __func__));
+        }
+    }
 
     return true;
 }
@@ -3635,11 +3919,14 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
         return error("%s: %s", __func__, state.ToString());
     }
 
-    // peercoin: check PoS
-    if (fCheckPoS && !PeercoinContextualBlockChecks(block, state, pindex, false, m_chainman.ActiveChainstate())) {
-        pindex->nStatus |= BLOCK_FAILED_VALID;
-        m_blockman.m_dirty_blockindex.insert(pindex);
-        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-pos", "proof of stake is incorrect");
+    // peercoin: check PoS, verifying the coinstake signature on the script
+    // check threads while the kernel and stake modifier are computed
+    if (fCheckPoS) {
+        if (!PeercoinContextualBlockChecks(block, state, pindex, false, m_chainman.ActiveChainstate(), g_parallel_script_checks)) {
+            pindex->nStatus |= BLOCK_FAILED_VALID;
+            m_blockman.m_dirty_blockindex.insert(pindex);
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-pos", "proof of stake is incorrect");
+        }
     }
 
     // Header is valid/has work, merkle tree and segwit merkle tree are good...RELAY NOW
@@ -3729,6 +4016,23 @@ MempoolAcceptResult ChainstateManager::ProcessTransaction(const CTransactionRef&
     return result;
 }
 
+void ChainstateManager::PreVerifyTransactions(const std::vector<CTransactionRef>& txns)
+{
+    AssertLockHeld(cs_main);
+    CChainState& active_chainstate = ActiveChainstate();
+    if (!g_parallel_script_checks || txns.size() < 2 || !active_chainstate.GetMempool()) return;
+
+    std::vector<COutPoint> coins_to_uncache;
+    auto args = MemPoolAccept::ATMPArgs::SingleAccept(active_chainstate.m_params, GetTime(), /*bypass_limits=*/false,
+                                                      coins_to_uncache, /*test_accept=*/false);
+    MemPoolAccept(*active_chainstate.GetMempool(), active_chainstate).PreVerifyScripts(txns, args);
+    // Leave the coins cache as it was; accepting the transactions fetches the coins again and
+    // uncaches them if the transactions are rejected.
+    for (const COutPoint& outpoint : coins_to_uncache) {
+        active_chainstate.CoinsTip().Uncache(outpoint);
+    }
+}
+
 bool TestBlockValidity(BlockValidationState& state,
                        const CChainParams& chainparams,
                        CChainState& chainstate,
@@ -4098,11 +4402,80 @@ bool CChainState::LoadGenesisBlock()
     return true;
 }
 
+//! Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
+
+bool CChainState::LoadExternalBlock(const std::shared_ptr<CBlock>& pblock, FlatFilePos* dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+    uint256 hash = block.GetHash();
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    block.hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+          BlockValidationState state;
+          if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
+              nLoaded++;
+          }
+          if (state.IsError()) {
+              return false;
+          }
+        } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == m_params.GetConsensus().hashGenesisBlock) {
+        BlockValidationState state;
+        if (!ActivateBestChain(state, nullptr)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip(*this);
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, m_params.GetConsensus())) {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                BlockValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr)) {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip(*this);
+        }
+    }
+    return true;
+}
+
 void CChainState::LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
 {
     AssertLockNotHeld(m_chainstate_mutex);
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
@@ -4145,67 +4518,31 @@ void CChainState::LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
                 blkdat >> block;
                 nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
-
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      BlockValidationState state;
-                      if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
+                if (!LoadExternalBlock(pblock, dbp, nLoaded)) {
+                    break;
                 }
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+}
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == m_params.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    if (!ActivateBestChain(state, nullptr)) {
-                        break;
-                    }
-                }
+void CChainState::LoadExternalBlocks(std::vector<std::pair<std::shared_ptr<CBlock>, FlatFilePos>>& blocks)
+{
+    AssertLockNotHeld(m_chainstate_mutex);
+    int64_t nStart = GetTimeMillis();
 
-                NotifyHeaderTip(*this);
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, m_params.GetConsensus())) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr)) {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip(*this);
-                    }
+    int nLoaded = 0;
+    try {
+        for (auto& [pblock, pos] : blocks) {
+            if (ShutdownRequested()) return;
+            try {
+                if (!LoadExternalBlock(pblock, &pos, nLoaded)) {
+                    break;
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
@@ -4214,7 +4551,7 @@ void CChainState::LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
-    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    LogPrintf("Loaded %i blocks from block file in %dms\n", nLoaded, GetTimeMillis() - nStart);
 }
 
 void CChainState::CheckBlockIndex()
@@ -4454,7 +4791,64 @@ bool CChainState::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     return ret;
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/** Version of mempool.dat without chunks or checksum, still loaded */
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_CHECKSUM = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+
+/** Number of transactions copied, and verified, at once when dumping and loading the mempool */
+static constexpr size_t MEMPOOL_DUMP_CHUNK_SIZE{1000};
+
+namespace {
+/** A transaction as stored in mempool.dat */
+struct MempoolDumpEntry {
+    CTransactionRef tx;
+    int64_t time;
+    int64_t fee_delta;
+};
+} // namespace
+
+/**
+ * Verify the input scripts of the transactions whose inputs are available,
+ * on the script check threads, with the flags AcceptToMemoryPool verifies
+ * them with. Their signatures are cached and, if they all pass, so are the
+ * executions under the consensus flags, so that accepting the transactions
+ * does not verify them again. If any fails, accepting the transactions tells
+ * which one.
+ */
+static void VerifyMempoolDumpScripts(const std::vector<MempoolDumpEntry>& entries, CChainState& active_chainstate, const CTxMemPool& pool)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    if (!g_parallel_script_checks) return;
+
+    LOCK(pool.cs);
+    CCoinsViewMemPool view_mempool(&active_chainstate.CoinsTip(), pool);
+    CCoinsViewCache view(&view_mempool);
+    const unsigned int consensus_flags{GetBlockScriptFlags(active_chainstate.m_chain.Tip(), Params().GetConsensus())};
+    const unsigned int flags[]{STANDARD_SCRIPT_VERIFY_FLAGS, consensus_flags};
+
+    std::vector<PrecomputedTransactionData> txdata(entries.size());
+    std::vector<std::pair<const CTransaction*, PrecomputedTransactionData*>> txs;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const CTransaction& tx = *entries[i].tx;
+        if (tx.IsCoinBase() || tx.IsCoinStake()) continue;
+
+        // Inputs spending transactions of the same chunk are not in the
+        // mempool yet; leave those transactions to AcceptToMemoryPool.
+        std::vector<CTxOut> spent_outputs;
+        spent_outputs.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            const Coin& coin = view.AccessCoin(txin.prevout);
+            if (coin.IsSpent()) break;
+            spent_outputs.emplace_back(coin.out);
+        }
+        if (spent_outputs.size() != tx.vin.size()) continue;
+
+        txdata[i].Init(tx, std::move(spent_outputs));
+        txs.emplace_back(&tx, &txdata[i]);
+    }
+    CacheScriptChecksInParallel(txs, flags, consensus_flags);
+}
 
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function)
 {
@@ -4473,58 +4867,114 @@ bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mocka
     int64_t unbroadcast = 0;
     int64_t nNow = GetTime();
 
-    try {
-        uint64_t version;
-        file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
+    // Verify the scripts of a chunk of transactions together, then accept
+    // them one by one. cs_main is taken for each transaction on its own, so
+    // that block processing is not held up for a whole chunk. Should the tip
+    // change in between, results cached for other flags are just not used.
+    const auto accept_chunk = [&](std::vector<MempoolDumpEntry>& chunk) {
+        std::vector<MempoolDumpEntry> unexpired;
+        unexpired.reserve(chunk.size());
+        for (MempoolDumpEntry& entry : chunk) {
+            if (entry.time > nNow - nExpiryTimeout) {
+                unexpired.push_back(std::move(entry));
+                continue;
+            }
+            if (entry.fee_delta) {
+                pool.PrioritiseTransaction(entry.tx->GetHash(), entry.fee_delta);
+            }
+            ++expired;
         }
-        uint64_t num;
-        file >> num;
-        while (num) {
-            --num;
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+        chunk.clear();
+
+        {
+            LOCK(cs_main);
+            VerifyMempoolDumpScripts(unexpired, active_chainstate, pool);
+        }
+        for (const MempoolDumpEntry& entry : unexpired) {
+            CAmount amountdelta = entry.fee_delta;
             if (amountdelta) {
-                pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+                pool.PrioritiseTransaction(entry.tx->GetHash(), amountdelta);
             }
-            if (nTime > nNow - nExpiryTimeout) {
+            const auto accepted = [&] {
                 LOCK(cs_main);
-                const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, nTime, /*bypass_limits=*/false, /*test_accept=*/false);
-                if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-                    ++count;
+                return AcceptToMemoryPool(active_chainstate, entry.tx, entry.time, /*bypass_limits=*/false, /*test_accept=*/false);
+            }();
+            if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(GenTxid::Txid(entry.tx->GetHash()))) {
+                    ++already_there;
                 } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
+                    ++failed;
                 }
-            } else {
-                ++expired;
             }
             if (ShutdownRequested())
                 return false;
         }
+        return true;
+    };
+
+    try {
+        CHashVerifier<CAutoFile> verifier(&file);
+        uint64_t version;
+        verifier >> version;
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_CHECKSUM) {
+            return false;
+        }
+
+        std::vector<MempoolDumpEntry> chunk;
+        chunk.reserve(MEMPOOL_DUMP_CHUNK_SIZE);
+        const auto read_entries = [&](uint64_t num) {
+            while (num) {
+                --num;
+                MempoolDumpEntry& entry = chunk.emplace_back();
+                verifier >> entry.tx;
+                verifier >> entry.time;
+                verifier >> entry.fee_delta;
+                if (chunk.size() == MEMPOOL_DUMP_CHUNK_SIZE && !accept_chunk(chunk)) return false;
+            }
+            return true;
+        };
+
+        if (version == MEMPOOL_DUMP_VERSION_NO_CHECKSUM) {
+            uint64_t num;
+            verifier >> num;
+            if (!read_entries(num)) return false;
+        } else {
+            // The transactions are written in chunks, ending with an empty one
+            while (const uint64_t num = ReadCompactSize(verifier)) {
+                if (!read_entries(num)) return false;
+            }
+        }
+        if (!accept_chunk(chunk)) return false;
+
         std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+        verifier >> mapDeltas;
+
+        std::set<uint256> unbroadcast_txids;
+        verifier >> unbroadcast_txids;
+
+        // The transactions were accepted like any other, so a corrupt file
+        // can't add invalid ones; only the fee deltas and unbroadcast set
+        // are left out.
+        if (version == MEMPOOL_DUMP_VERSION) {
+            const uint256 checksum{verifier.GetHash()};
+            uint256 expected;
+            file >> expected;
+            if (checksum != expected) {
+                LogPrintf("Checksum mismatch in mempool file. Continuing anyway.\n");
+                return false;
+            }
+        }
 
         for (const auto& i : mapDeltas) {
             pool.PrioritiseTransaction(i.first, i.second);
         }
 
-        std::set<uint256> unbroadcast_txids;
-        file >> unbroadcast_txids;
         unbroadcast = unbroadcast_txids.size();
         for (const auto& txid : unbroadcast_txids) {
             // Ensure transactions were accepted to mempool then add to
@@ -4545,7 +4995,7 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
     int64_t start = GetTimeMicros();
 
     std::map<uint256, CAmount> mapDeltas;
-    std::vector<TxMempoolInfo> vinfo;
+    std::vector<uint256> txids;
     std::set<uint256> unbroadcast_txids;
 
     static Mutex dump_mutex;
@@ -4556,7 +5006,8 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
         for (const auto &i : pool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
-        vinfo = pool.infoAll();
+        // Parents come before their children
+        pool.queryHashes(txids);
         unbroadcast_txids = pool.GetUnbroadcastTxs();
     }
 
@@ -4569,22 +5020,43 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
         }
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        CHashedWriter<CAutoFile> writer(&file);
 
         uint64_t version = MEMPOOL_DUMP_VERSION;
-        file << version;
-
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << int64_t{count_seconds(i.m_time)};
-            file << int64_t{i.nFeeDelta};
-            mapDeltas.erase(i.tx->GetHash());
+        writer << version;
+
+        // Copy the transactions a chunk at a time, so that the mempool is
+        // only locked briefly and the dump can be written in the background.
+        // Transactions removed in the meantime are left out.
+        std::vector<TxMempoolInfo> vinfo;
+        vinfo.reserve(MEMPOOL_DUMP_CHUNK_SIZE);
+        for (size_t i = 0; i < txids.size(); i += MEMPOOL_DUMP_CHUNK_SIZE) {
+            vinfo.clear();
+            {
+                LOCK(pool.cs);
+                for (size_t j = i; j < std::min(i + MEMPOOL_DUMP_CHUNK_SIZE, txids.size()); ++j) {
+                    TxMempoolInfo info{pool.info(GenTxid::Txid(txids[j]))};
+                    if (info.tx) vinfo.push_back(std::move(info));
+                }
+            }
+            if (vinfo.empty()) continue;
+
+            WriteCompactSize(writer, vinfo.size());
+            for (const auto& info : vinfo) {
+                writer << *(info.tx);
+                writer << int64_t{count_seconds(info.m_time)};
+                writer << int64_t{info.nFeeDelta};
+                mapDeltas.erase(info.tx->GetHash());
+            }
         }
+        WriteCompactSize(writer, 0);
 
-        file << mapDeltas;
+        writer << mapDeltas;
 
         LogPrintf("Writing %d unbroadcast transactions to disk.\n", unbroadcast_txids.size());
-        file << unbroadcast_txids;
+        writer << unbroadcast_txids;
+
+        file << writer.GetHash();
 
         if (!skip_file_commit && !FileCommit(file.Get()))
             throw std::runtime_error("FileCommit failed");
@@ -4601,6 +5073,43 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
     return true;
 }
 
+/** Background thread that saves the mempool periodically. */
+class MempoolDumper
+{
+private:
+    std::thread m_thread;
+    CThreadInterrupt m_interrupt;
+
+public:
+    void Start(const CTxMemPool& pool, std::chrono::minutes interval)
+    {
+        m_interrupt.reset();
+        m_thread = std::thread(&util::TraceThread, "mempooldump", [this, &pool, interval] {
+            while (m_interrupt.sleep_for(interval)) {
+                if (pool.IsLoaded()) DumpMempool(pool);
+            }
+        });
+    }
+
+    void Stop()
+    {
+        m_interrupt();
+        if (m_thread.joinable()) m_thread.join();
+    }
+};
+
+static MempoolDumper g_mempool_dumper;
+
+void StartMempoolDumpThread(const CTxMemPool& pool, std::chrono::minutes interval)
+{
+    g_mempool_dumper.Start(pool, interval);
+}
+
+void StopMempoolDumpThread()
+{
+    g_mempool_dumper.Stop();
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
@@ -4663,14 +5172,8 @@ bool GetCoinAge(const CTransaction& tx, const CCoinsViewCache &view, uint64_t& n
             txPrev = it->second.second;
         } else {
             if (g_txindex->FindTxPosition(prevout.hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txPrev;
-                } catch (std::exception &e) {
+                if (!ReadTxFromDisk(header, txPrev, postx, postx.nTxOffset))
                     return error("%s() : deserialize or I/O error in GetCoinAge()", __PRETTY_FUNCTION__);
-                }
             } else
                 return error("%s() : tx missing in tx index in GetCoinAge()", __PRETTY_FUNCTION__);
             g_txindex->cachedTxs[prevout.hash] = std::pair(header,txPrev);
@@ -4737,7 +5240,7 @@ bool CheckBlockSignature(const CBlock& block)
     CPubKey key(vchPubKey);
     if (block.vchBlockSig.empty())
         return false;
-    return key.Verify(block.GetHash(), block.vchBlockSig);
+    return VerifyBlockSignature(key, block.GetHash(), block.vchBlockSig);
 }
 
 std::optional<uint256> ChainstateManager::SnapshotBlockhash() const
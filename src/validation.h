@@ -87,9 +87,12 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = true;  // peercoin: txindex is required for PoS calculations (might change in the future)
 static constexpr bool DEFAULT_COINSTATSINDEX{false};
+static constexpr bool DEFAULT_ADDRESSINDEX{false};
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistmempoolinterval, in minutes */
+static constexpr int64_t DEFAULT_PERSIST_MEMPOOL_INTERVAL{15};
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ActiveChain().Tip() will not be pruned. */
@@ -315,12 +318,17 @@ bool CheckSequenceLocks(CBlockIndex* tip,
 /**
  * Closure representing one script verification
  * Note that this stores references to the spending transaction
+ *
+ * peercoin: a check constructed from a block verifies vchBlockSig instead of
+ * an input script, so that the block signature can share the script check
+ * queue with the transaction inputs.
  */
 class CScriptCheck
 {
 private:
     CTxOut m_tx_out;
     const CTransaction *ptxTo;
+    const CBlock *pblock;
     unsigned int nIn;
     unsigned int nFlags;
     bool cacheStore;
@@ -328,14 +336,17 @@ private:
     PrecomputedTransactionData *txdata;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
+    CScriptCheck(): ptxTo(nullptr), pblock(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
     CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+        m_tx_out(outIn), ptxTo(&txToIn), pblock(nullptr), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+    explicit CScriptCheck(const CBlock& blockIn) :
+        ptxTo(nullptr), pblock(&blockIn), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(nullptr) { }
 
     bool operator()();
 
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
+        std::swap(pblock, check.pblock);
         std::swap(m_tx_out, check.m_tx_out);
         std::swap(nIn, check.nIn);
         std::swap(nFlags, check.nFlags);
@@ -352,8 +363,12 @@ void InitScriptExecutionCache();
 
 /** Functions for validating blocks and updating the block tree */
 
-/** Context-independent validity checks */
-bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSignature = true);
+/** Context-independent validity checks
+ *
+ * If pvChecks is not nullptr, the block signature check is pushed onto it
+ * instead of being performed inline.
+ */
+bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSignature = true, std::vector<CScriptCheck>* pvChecks = nullptr);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(BlockValidationState& state,
@@ -607,6 +622,10 @@ public:
     void LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp = nullptr)
         EXCLUSIVE_LOCKS_REQUIRED(!m_chainstate_mutex);
 
+    /** Import blocks that were already read from their positions in a block file, in file order (used by -reindex) */
+    void LoadExternalBlocks(std::vector<std::pair<std::shared_ptr<CBlock>, FlatFilePos>>& blocks)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_chainstate_mutex);
+
     /**
      * Update the on-disk chain state.
      * The caches and indexes are flushed depending on the mode we're called with
@@ -652,11 +671,16 @@ public:
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    /** Same as above, using undo data that has already been read from disk. blockUndo is consumed. */
+    DisconnectResult DisconnectBlock(const CBlock& block, CBlockUndo& blockUndo, const CBlockIndex* pindex, CCoinsViewCache& view)
+        EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
                       CCoinsViewCache& view, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Apply the effects of a block disconnection on the UTXO set.
     bool DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
+    // Disconnect all blocks above pindexFork, reading their block and undo data in parallel.
+    bool DisconnectTips(BlockValidationState& state, const CBlockIndex* pindexFork, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
 
     // Manual block validity manipulation:
     /** Mark a block as precious and reorganize.
@@ -727,6 +751,10 @@ private:
 
     bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /** Import one block of a block file. Returns false if importing should stop. */
+    bool LoadExternalBlock(const std::shared_ptr<CBlock>& pblock, FlatFilePos* dbp, int& nLoaded)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_chainstate_mutex);
+
     void CheckForkWarningConditions() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void InvalidChainFound(CBlockIndex* pindexNew) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -983,6 +1011,16 @@ public:
     [[nodiscard]] MempoolAcceptResult ProcessTransaction(const CTransactionRef& tx, bool test_accept=false)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Verify the scripts of transactions about to be submitted one by one on the script check
+     * threads, so that ProcessTransaction() finds them in the script execution cache.
+     * Transactions failing the cheap policy checks, or spending each other, are skipped.
+     * Does nothing unless parallel script checks are enabled.
+     *
+     * @param[in]  txns            The transactions to verify the scripts of.
+     */
+    void PreVerifyTransactions(const std::vector<CTransactionRef>& txns) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     //! Load the block tree and coins database from disk, initializing state if we're running with -reindex
     bool LoadBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -1008,6 +1046,10 @@ using FopenFn = std::function<FILE*(const fs::path&, const char*)>;
 /** Dump the mempool to disk. */
 bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function = fsbridge::fopen, bool skip_file_commit = false);
 
+/** Start the thread that dumps the mempool to disk every interval */
+void StartMempoolDumpThread(const CTxMemPool& pool, std::chrono::minutes interval);
+void StopMempoolDumpThread();
+
 /** Load the mempool from disk. */
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function = fsbridge::fopen);
 
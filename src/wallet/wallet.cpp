@@ -3255,16 +3255,10 @@ bool CWallet::CreateCoinStake(ChainstateManager& chainman, const CWallet* pwalle
             header = it->second.first;
             tx = it->second.second;
         } else {
-            try {
-                    // Read block header
-                    CAutoFile file(node::OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> tx;
-                    g_txindex->cachedTxs[pcoin.outpoint.hash]=std::pair(header,tx);
-                } catch (std::exception &e) {
-                    return error("%s() : deserialize or I/O error in CreateCoinStake()", __PRETTY_FUNCTION__);
-                }
+            // Read block header
+            if (!node::ReadTxFromDisk(header, tx, postx, postx.nTxOffset))
+                return error("%s() : deserialize or I/O error in CreateCoinStake()", __PRETTY_FUNCTION__);
+            g_txindex->cachedTxs[pcoin.outpoint.hash]=std::pair(header,tx);
         }
 
         static int nMaxStakeSearchInterval = 60;
@@ -3337,16 +3331,10 @@ bool CWallet::CreateCoinStake(ChainstateManager& chainman, const CWallet* pwalle
             continue;
 
         // Read block header
-        CAutoFile file(node::OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
         CBlockHeader header;
         CTransactionRef tx;
-        try {
-            file >> header;
-            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-            file >> tx;
-        } catch (std::exception &e) {
+        if (!node::ReadTxFromDisk(header, tx, postx, postx.nTxOffset))
             return error("%s() : deserialize or I/O error in CreateCoinStake()", __PRETTY_FUNCTION__);
-        }
 
 
         // Attempt to add more inputs
@@ -7,6 +7,7 @@
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
+- Repeat -reindex with the block files read serially and on several threads.
 """
 
 from test_framework.test_framework import BitcoinTestFramework
@@ -18,11 +19,13 @@ class ReindexTest(BitcoinTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 1
 
-    def reindex(self, justchainstate=False):
+    def reindex(self, justchainstate=False, reindexthreads=None):
         self.generatetoaddress(self.nodes[0], 3, self.nodes[0].get_deterministic_priv_key().address)
         blockcount = self.nodes[0].getblockcount()
         self.stop_nodes()
         extra_args = [["-reindex-chainstate" if justchainstate else "-reindex"]]
+        if reindexthreads is not None:
+            extra_args[0].append(f"-reindexthreads={reindexthreads}")
         self.start_nodes(extra_args)
         assert_equal(self.nodes[0].getblockcount(), blockcount)  # start_node is blocking on reindex
         self.log.info("Success")
@@ -32,6 +35,8 @@ class ReindexTest(BitcoinTestFramework):
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex(False, reindexthreads=1)
+        self.reindex(False, reindexthreads=4)
 
 if __name__ == '__main__':
     ReindexTest().main()